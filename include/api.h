@@ -8,6 +8,12 @@ namespace cycles {
 
 using Id = sf::Uint8; ///< The type of the player's unique identifier
 
+/// Largest player id. Ids start at 1, so a game has at most this many players.
+constexpr Id maxPlayerId = 254;
+
+/// A value no player id takes, for cells without an owner such as the border
+constexpr Id noPlayer = maxPlayerId + 1;
+
 constexpr auto SERVER_IP = "127.0.0.1";
 
 /**
@@ -20,9 +26,6 @@ struct Player {
   Id id; ///< The unique identifier of the player
 };
 
-// Forward declaration for friend declaration in GameState
-class Connection;
-
 /**
  * @brief A representation of the state of the game
  */
@@ -81,9 +84,94 @@ struct GameState {
            position.y < gridHeight;
   }
 
-private:
-  friend Connection;
-  GameState(sf::Packet &packet);
+  /**
+   * @brief Read a frame as the server sends it
+   *
+   * Connection::receiveGameState does it, bots and tests can read a recorded
+   * packet the same way.
+   */
+  explicit GameState(sf::Packet &packet);
+};
+
+/**
+ * @brief A copy of the grid surrounded by a border of occupied cells
+ *
+ * Cells are addressed by an index, a step in any direction is adding
+ * offset(direction) to it. A step from a cell of the grid never leaves the
+ * storage and the border is never free, so checking a move is a single
+ * isFree call and flood fills need no bounds checks.
+ */
+class GridView {
+  std::vector<Id> cells;
+  int width = 0;
+  int height = 0;
+
+public:
+  static constexpr Id wall = noPlayer; ///< The value of the border cells
+
+  GridView() = default;
+
+  /**
+   * @brief Copy the grid of a game state
+   */
+  explicit GridView(const GameState &state);
+
+  int getWidth() const { return width; }   ///< Width of the grid, without border
+  int getHeight() const { return height; } ///< Height of the grid, without border
+
+  /**
+   * @brief Number of cells in the storage, border included. Indices go from
+   * 0 to size() - 1.
+   */
+  int size() const { return static_cast<int>(cells.size()); }
+
+  /**
+   * @brief Index of a position, valid from -1 to width/height
+   */
+  int index(sf::Vector2i position) const {
+    return (position.y + 1) * (width + 2) + position.x + 1;
+  }
+
+  /**
+   * @brief Position of an index
+   */
+  sf::Vector2i position(int index) const {
+    return {index % (width + 2) - 1, index / (width + 2) - 1};
+  }
+
+  /**
+   * @brief Index difference of a step in a direction
+   */
+  int offset(Direction direction) const {
+    const int offsets[] = {-(width + 2), 1, width + 2, -1};
+    return offsets[static_cast<int>(direction)];
+  }
+
+  /**
+   * @brief Value of a cell, wall for the border
+   */
+  Id operator[](int index) const { return cells[index]; }
+
+  /**
+   * @brief Check if a cell is empty, false for the border
+   */
+  bool isFree(int index) const { return cells[index] == 0; }
+
+  /**
+   * @brief Check if a position is empty, false outside of the grid
+   *
+   * @param position A position at most one step outside of the grid
+   */
+  bool isFree(sf::Vector2i position) const { return isFree(index(position)); }
+
+  /**
+   * @brief Number of empty cells around a cell
+   */
+  int freeNeighbours(int index) const {
+    const int stride = width + 2;
+    return isFree(index - stride) + isFree(index + 1) +
+           isFree(index + stride) + isFree(index - 1);
+  }
 };
 
 /**
@@ -95,11 +183,21 @@ class Connection {
   int frameNumber = 0;
   int lastFrameSent = -1;
   std::string playerName;
+  std::string serverHost;
+  unsigned short serverPort = 0;
+  sf::Uint64 sessionToken = 0; ///< Given by the server to reconnect, 0 if none
+
+  // Connect again to the same server with the session token, false when it
+  // does not take the client back in time
+  bool reconnect();
 
 public:
   /**
    * @brief Construct a new Connection object
    *
+   * Connects to 127.0.0.1 on the port in CYCLES_PORT. That can be a broker,
+   * which sends the client on to the server it picked.
+   *
    * @param playerName The name of the player that is trying to connect
    * @return sf::Color The color assigned to the player
    */
@@ -117,11 +215,31 @@ public:
    */
   void sendMove(Direction direction);
 
+  /**
+   * @brief Send the player's planned moves to the server
+   *
+   * The first direction applies to the current frame, the following ones to
+   * the next frames. When the server does not receive a new move in time for
+   * a frame it takes the direction from the plan, so a bot does not need to
+   * answer every frame while its plan lasts. A new plan (or move) replaces
+   * whatever is left of the previous one.
+   * Same restrictions as sendMove apply.
+   *
+   * @param directions The directions for this frame and the following ones
+   */
+  void sendPlan(const std::vector<Direction> &directions);
+
   /**
    * @brief Receive the game state from the server
    *
    * Will block until the game state is received.
    * Can only be called once per frame.
+   * If the client fell behind and several frames are already waiting, the
+   * older ones are dropped and the newest one is returned. Moves are tagged
+   * with the frame they answer, the server ignores moves for past frames.
+   * If the connection drops and the server checkpoints its matches, the
+   * client reconnects to the same server for up to 30 seconds, so a match
+   * the server restores from a checkpoint goes on.
    *
    * @return GameState The game state
    */
@@ -0,0 +1,147 @@
+#pragma once
+#include "api.h"
+#include <array>
+#include <map>
+#include <vector>
+
+namespace cycles {
+
+namespace detail {
+
+// Breadth-first distances from the head of one player over the free cells of
+// a padded grid. A cell holds its detour, (distance - manhattan distance to
+// the head) / 2, which is the same from the old and the new head wherever
+// the shortest paths do not bend around occupied cells: moving the head
+// leaves most of the field as it is.
+struct DistanceField {
+  sf::Vector2i head;
+  int headCell = 0;
+  std::vector<int> detour; // Unreached cells hold the largest int
+};
+
+} // namespace detail
+
+/**
+ * @brief Distance maps and Voronoi territory, kept up to date from frame to
+ * frame
+ *
+ * Holds a copy of the grid and, for each player in the game, the
+ * breadth-first distances over free cells from its head, and the owner of
+ * each free cell: the player whose head is closest (the Voronoi territory).
+ * Between two frames only a few cells change, the new heads and the tail ends
+ * that expired. update() finds them and repairs only the cells whose
+ * distance or owner changes instead of searching the whole grid again for
+ * every player. The maps take 4 bytes per cell and player.
+ *
+ * @code
+ * BoardAnalysis analysis;
+ * while (connection.isActive()) {
+ *   auto state = connection.receiveGameState();
+ *   analysis.update(state);
+ *   int mine = analysis.territory(myId);
+ *   ...
+ * }
+ * @endcode
+ */
+class BoardAnalysis {
+  int width = 0;
+  int height = 0;
+  std::vector<Id> cells;             // Padded like GridView
+  std::vector<int> columns;          // Of each index, -1 to width
+  std::vector<int> rows;             // Of each index, -1 to height
+  std::vector<int> changes;
+  std::map<Id, detail::DistanceField> fields; // The players in the game
+  std::vector<Id> owners;
+  std::array<int, 256> territories{};
+  // Owners only change where a margin runs out: a cell is examined again
+  // once the heads moved enough to close the gap to the second closest
+  int drift = 0;                     // Twice the steps of the heads so far
+  std::vector<int> deadlines;        // Drift at which to examine, -1 for none
+  std::vector<std::vector<int>> schedule; // Cells by deadline, a ring
+  std::vector<int> examined;         // Stamps, reused
+  int examination = 0;
+  int repaired = 0;
+
+  bool sameSize(const GameState &state) const {
+    return state.gridWidth == width && state.gridHeight == height &&
+           !cells.empty();
+  }
+  int index(sf::Vector2i position) const {
+    return (position.y + 1) * (width + 2) + position.x + 1;
+  }
+  int distanceFrom(const detail::DistanceField &field, int cell) const;
+  void apply(const GameState &state);
+  void examine(int cell);
+  void examineAll();
+
+public:
+  static constexpr Id contested = noPlayer; ///< Owner of the cells two players reach at the same time
+  static constexpr int unreachable = -1; ///< Distance of the cells no head reaches
+
+  BoardAnalysis() = default;
+
+  /**
+   * @brief Analyse a game state from scratch
+   */
+  explicit BoardAnalysis(const GameState &state);
+
+  /**
+   * @brief Bring the analysis to a new state of the same game
+   *
+   * Compares the grid with the previous one to find the cells that changed.
+   * States can be skipped, a state of another grid size starts over.
+   */
+  void update(const GameState &state);
+
+  /**
+   * @brief Bring the analysis to a new state, the changed cells being known
+   *
+   * @param state The new state
+   * @param changedCells Indices in state.grid (y * gridWidth + x) of every
+   * cell that changed since the previous state, in any order
+   */
+  void update(const GameState &state, const std::vector<int> &changedCells);
+
+  /**
+   * @brief Analyse a game state from scratch, what update does for the first
+   * state or when most of the grid changed
+   */
+  void rebuild(const GameState &state);
+
+  /**
+   * @brief Steps from the nearest head to a cell over free cells
+   *
+   * @return 0 on a head, unreachable for occupied cells, cells outside the
+   * grid and cells no head can reach
+   */
+  int distance(sf::Vector2i cell) const;
+
+  /**
+   * @brief Steps from the head of a player to a cell over free cells
+   *
+   * @return unreachable as above, and for players that are not in the game
+   */
+  int distance(Id player, sf::Vector2i cell) const;
+
+  /**
+   * @brief The player whose head is closest to a free cell
+   *
+   * @return contested when several heads are as close, 0 for occupied cells,
+   * cells outside the grid and cells no head can reach
+   */
+  Id owner(sf::Vector2i cell) const;
+
+  /**
+   * @brief Number of free cells a player reaches before any other
+   *
+   * territory(contested) is the number of contested cells.
+   */
+  int territory(Id player) const { return territories[player]; }
+
+  /**
+   * @brief Cells the last update recomputed, distances and owners
+   */
+  int repairedCells() const { return repaired; }
+};
+
+} // namespace cycles
@@ -0,0 +1,143 @@
+#pragma once
+#include "api.h"
+#include <cstdint>
+#include <vector>
+
+namespace cycles {
+
+/**
+ * @brief A plane of the features of a game state, one value per cell of the
+ * window around the player's head
+ */
+enum class FeaturePlane {
+  free,          ///< 1 where the cell is empty
+  wall,          ///< 1 outside of the grid
+  own,           ///< 1 on the player's head and trail
+  ownHead,       ///< 1 on the player's head, the centre of the window
+  opponents,     ///< 1 on the heads and trails of the other players
+  opponentHeads, ///< 1 on the heads of the other players
+  wallDistance,  ///< Steps to leave the grid over half its smaller side, 0 outside
+};
+
+/**
+ * @brief What the encoder produces
+ */
+struct FeatureOptions {
+  /**
+   * @brief The window is 2 * radius + 1 cells wide and high, centred on the
+   * player's head
+   */
+  int radius = 7;
+  /**
+   * @brief Turn the window so the player's heading points up, the same
+   * situation always looks the same to the policy
+   */
+  bool rotate = true;
+  /**
+   * @brief The planes, in this order
+   */
+  std::vector<FeaturePlane> planes = {
+      FeaturePlane::free,          FeaturePlane::wall,
+      FeaturePlane::own,           FeaturePlane::ownHead,
+      FeaturePlane::opponents,     FeaturePlane::opponentHeads,
+      FeaturePlane::wallDistance};
+};
+
+/**
+ * @brief The state to encode and whose point of view to encode it from
+ */
+struct FeatureInput {
+  const GameState *state; ///< Not copied, must outlive the call
+  Id player;              ///< The player at the centre of the window
+  Direction heading;      ///< Its last move, up in the window when rotating
+};
+
+/**
+ * @brief Turns game states into the input tensors of a neural network
+ *
+ * The features are written in planes-first order (planes x rows x columns)
+ * into a buffer the caller owns, like a numpy array or a tensor of the
+ * framework, so nothing is copied after the encoding. Binary planes are 0 or
+ * 1 in both the float and uint8 versions, wallDistance is 0 to 1 as float and
+ * 0 to 255 as uint8. An encoder can be shared between threads.
+ */
+class FeatureEncoder {
+  FeatureOptions options;
+
+public:
+  explicit FeatureEncoder(FeatureOptions options = {});
+
+  const FeatureOptions &getOptions() const { return options; }
+
+  /**
+   * @brief Width and height of the window
+   */
+  int side() const { return 2 * options.radius + 1; }
+
+  /**
+   * @brief Number of values of one encoded state
+   */
+  std::size_t size() const {
+    return options.planes.size() * side() * side();
+  }
+
+  /**
+   * @brief Encode a state from the point of view of a player
+   *
+   * @param input The state, the player and its heading
+   * @param out size() values. Left as is when the player is not in the game.
+   * @return false if the player is not in the game
+   */
+  bool encode(const FeatureInput &input, float *out) const;
+
+  /**
+   * @brief Same as the float version with one byte per value
+   */
+  bool encode(const FeatureInput &input, std::uint8_t *out) const;
+
+  /**
+   * @brief Encode several states one after the other into out, which holds
+   * inputs.size() * size() values
+   *
+   * @return The number of inputs whose player was in the game
+   */
+  int encodeBatch(const std::vector<FeatureInput> &inputs, float *out) const;
+
+  /**
+   * @brief Same as the float version with one byte per value
+   */
+  int encodeBatch(const std::vector<FeatureInput> &inputs,
+                  std::uint8_t *out) const;
+};
+
+} // namespace cycles
+
+/**
+ * @brief The encoder with the default planes for other languages, through
+ * the cycles_features shared library. The grid and the output are read and
+ * written in place, with Python for instance from numpy arrays through
+ * ctypes.
+ */
+extern "C" {
+
+/**
+ * @brief Number of floats cycles_encode_features writes for a radius
+ */
+int cycles_feature_size(int radius);
+
+/**
+ * @brief Encode a state from the point of view of a player
+ *
+ * @param grid Row-major grid of width x height player ids, 0 for empty
+ * @param heads x and y of the head of each player, playerCount pairs
+ * @param ids The id of each player, in the same order as heads
+ * @param heading 0 to 3, north, east, south, west
+ * @param rotate Non-zero to turn the heading up
+ * @param out cycles_feature_size(radius) floats
+ * @return 0, or -1 when player is not among ids
+ */
+int cycles_encode_features(const std::uint8_t *grid, int width, int height,
+                           const int *heads, const std::uint8_t *ids,
+                           int playerCount, std::uint8_t player, int heading,
+                           int radius, int rotate, float *out);
+}
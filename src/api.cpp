@@ -1,5 +1,6 @@
 #include "api.h"
 #include <SFML/Network.hpp>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 
 namespace cycles {
@@ -28,26 +29,54 @@ GameState::GameState(sf::Packet &packet) {
   }
 }
 
+GridView::GridView(const GameState &state)
+    : cells((state.gridWidth + 2) * (state.gridHeight + 2), wall),
+      width(state.gridWidth), height(state.gridHeight) {
+  for (int y = 0; y < height; y++) {
+    std::copy_n(state.grid.begin() + y * width, width,
+                cells.begin() + index({0, y}));
+  }
+}
+
 namespace detail {
-std::shared_ptr<sf::TcpSocket> establishLink() {
-  spdlog::debug("Trying to connect");
+// How long a client keeps trying to get its session back
+const sf::Time reconnectTimeout = sf::seconds(30);
+
+// Null if the server can not be reached
+std::shared_ptr<sf::TcpSocket> tryLink(const std::string &host,
+                                       unsigned short port,
+                                       sf::Time timeout = sf::Time::Zero) {
   auto socket = std::make_shared<sf::TcpSocket>();
-  const char *port = std::getenv("CYCLES_PORT");
-  if (port == nullptr) {
-    spdlog::critical("Environment variable CYCLES_PORT not set");
-    exit(1);
+  if (socket->connect(host, port, timeout) != sf::Socket::Done) {
+    return nullptr;
   }
-  const unsigned short SERVER_PORT = std::stoi(port);
-  spdlog::info("Connecting to server at {}:{}", SERVER_IP, SERVER_PORT);
-  if (socket->connect(SERVER_IP, SERVER_PORT) != sf::Socket::Done) {
+  return socket;
+}
+
+std::shared_ptr<sf::TcpSocket> establishLink(const std::string &host,
+                                            unsigned short port) {
+  spdlog::debug("Trying to connect");
+  spdlog::info("Connecting to server at {}:{}", host, port);
+  auto socket = tryLink(host, port);
+  if (socket == nullptr) {
     spdlog::critical("Failed to connect to server");
     exit(1);
   }
   return socket;
 }
 
-void sendPacket(std::shared_ptr<sf::TcpSocket> socket, sf::Packet &packet,
-                bool blocking = true) {
+unsigned short serverPort() {
+  const char *port = std::getenv("CYCLES_PORT");
+  if (port == nullptr) {
+    spdlog::critical("Environment variable CYCLES_PORT not set");
+    exit(1);
+  }
+  return std::stoi(port);
+}
+
+// Send with a few retries while the socket is not ready
+sf::Socket::Status trySendPacket(std::shared_ptr<sf::TcpSocket> socket,
+                                 sf::Packet &packet, bool blocking = true) {
   int attempts = 0;
   bool blockingState = socket->isBlocking();
   socket->setBlocking(blocking);
@@ -59,17 +88,23 @@ void sendPacket(std::shared_ptr<sf::TcpSocket> socket, sf::Packet &packet,
     }
     attempts++;
   }
+  socket->setBlocking(blockingState);
+  return status;
+}
+
+void sendPacket(std::shared_ptr<sf::TcpSocket> socket, sf::Packet &packet,
+                bool blocking = true) {
+  auto status = trySendPacket(socket, packet, blocking);
   if (status != sf::Socket::Done) {
     spdlog::critical("Failed to send packet to server");
     spdlog::critical("Reason: {}", socketErrorToString(status));
     exit(1);
   }
-  socket->setBlocking(blockingState);
 }
 
-sf::Packet receivePacket(std::shared_ptr<sf::TcpSocket> socket,
-                         bool blocking = true) {
-  sf::Packet packet;
+// Receive with a few retries while the socket is not ready
+sf::Socket::Status tryReceivePacket(std::shared_ptr<sf::TcpSocket> socket,
+                                    sf::Packet &packet, bool blocking = true) {
   bool blockingState = socket->isBlocking();
   socket->setBlocking(blocking);
   sf::Socket::Status status = sf::Socket::NotReady;
@@ -81,22 +116,63 @@ sf::Packet receivePacket(std::shared_ptr<sf::TcpSocket> socket,
     }
     attempts++;
   }
+  socket->setBlocking(blockingState);
+  return status;
+}
+
+sf::Packet receivePacket(std::shared_ptr<sf::TcpSocket> socket,
+                         bool blocking = true) {
+  sf::Packet packet;
+  auto status = tryReceivePacket(socket, packet, blocking);
   if (status != sf::Socket::Done) {
     spdlog::critical("Failed to receive packet from server");
     spdlog::critical("Reason: {}", socketErrorToString(status));
     exit(1);
   }
-  socket->setBlocking(blockingState);
   return packet;
 }
 
-std::shared_ptr<sf::TcpSocket> connectToServer(std::string playerName) {
-  auto socket = detail::establishLink();
-  // Send name to server
+// True when the server answers within a second with the color and the same
+// token, a new server or a new match would not know the token
+bool resumed(std::shared_ptr<sf::TcpSocket> socket, sf::Uint64 token) {
+  sf::SocketSelector selector;
+  selector.add(*socket);
+  sf::Packet answer;
+  if (!selector.wait(sf::seconds(1)) ||
+      tryReceivePacket(socket, answer) != sf::Socket::Done) {
+    return false;
+  }
+  sf::Uint8 r, g, b;
+  sf::Uint64 answered = 0;
+  return (answer >> r >> g >> b >> answered) && answered == token;
+}
+
+// Replace packet with the newest packet already queued in the socket, if any
+bool receiveLatestPacket(std::shared_ptr<sf::TcpSocket> socket,
+                         sf::Packet &packet) {
+  bool blockingState = socket->isBlocking();
+  socket->setBlocking(false);
+  bool replaced = false;
+  sf::Packet next;
+  while (socket->receive(next) == sf::Socket::Done) {
+    packet = next;
+    replaced = true;
+  }
+  socket->setBlocking(blockingState);
+  return replaced;
+}
+
+// A redirect starts with the string "redirect", a color with its three bytes
+bool isRedirect(sf::Packet packet) {
+  std::string tag;
+  return static_cast<bool>(packet >> tag) && tag == "redirect";
+}
+
+void sendName(std::shared_ptr<sf::TcpSocket> socket,
+              const std::string &playerName) {
   sf::Packet namePacket;
   namePacket << playerName;
   detail::sendPacket(socket, namePacket);
-  return socket;
 }
 
 }; // namespace detail
@@ -106,41 +182,110 @@ sf::Color Connection::connect(std::string playerName) {
   if (socket != nullptr) {
     spdlog::critical("Connection already established");
   }
-  socket = detail::connectToServer(playerName);
+  serverHost = SERVER_IP;
+  serverPort = detail::serverPort();
+  socket = detail::establishLink(serverHost, serverPort);
+  detail::sendName(socket, playerName);
   sf::Color color;
   sf::Packet colorPacket = detail::receivePacket(socket);
+  // A broker answers with the server to join instead of the color
+  for (int hops = 0; detail::isRedirect(colorPacket) && hops < 4; hops++) {
+    std::string tag, host;
+    int port;
+    if (!(colorPacket >> tag >> host >> port)) {
+      break;
+    }
+    spdlog::info("{}: Redirected to {}:{}", playerName, host, port);
+    serverHost = host;
+    serverPort = port;
+    socket = detail::establishLink(host, port);
+    detail::sendName(socket, playerName);
+    colorPacket = detail::receivePacket(socket);
+  }
   sf::Uint8 r, g, b;
   if (!(colorPacket >> r >> g >> b)) {
     spdlog::critical("Failed to receive color from server");
     exit(1);
   }
   color = sf::Color(r, g, b);
+  // Servers that can resume a match send a session token too
+  if (!(colorPacket >> sessionToken)) {
+    sessionToken = 0;
+  }
   spdlog::info("{}: Assigned color: R={} G={} B={}", playerName,
                static_cast<int>(r), static_cast<int>(g), static_cast<int>(b));
   return color;
 }
 
-void Connection::sendMove(Direction direction) {
+void Connection::sendMove(Direction direction) { sendPlan({direction}); }
+
+void Connection::sendPlan(const std::vector<Direction> &directions) {
   if (frameNumber == lastFrameSent) {
     spdlog::warn("Trying to send move twice in the same frame, call "
                  "receiveGameState first");
     return;
   }
+  if (directions.empty()) {
+    spdlog::warn("Trying to send an empty plan");
+    return;
+  }
   spdlog::debug("Sending move");
   sf::Packet packet;
-  packet << getDirectionValue(direction);
-  detail::sendPacket(socket, packet);
+  packet << frameNumber << static_cast<sf::Uint32>(directions.size());
+  for (auto direction : directions) {
+    packet << getDirectionValue(direction);
+  }
+  // The move is lost with the connection, the next state is for a new frame
+  if (detail::trySendPacket(socket, packet) != sf::Socket::Done &&
+      !reconnect()) {
+    spdlog::critical("Failed to send packet to server");
+    exit(1);
+  }
   lastFrameSent = frameNumber;
 }
 
 GameState Connection::receiveGameState() {
   spdlog::debug("Receiving game state");
-  auto packet = detail::receivePacket(socket);
+  sf::Packet packet;
+  while (detail::tryReceivePacket(socket, packet) != sf::Socket::Done) {
+    if (!reconnect()) {
+      spdlog::critical("Failed to receive packet from server");
+      exit(1);
+    }
+  }
+  if (detail::receiveLatestPacket(socket, packet)) {
+    spdlog::debug("Skipped stale game states");
+  }
   GameState state(packet);
   frameNumber = state.frameNumber;
   return state;
 }
 
+bool Connection::reconnect() {
+  if (sessionToken == 0) {
+    return false;
+  }
+  spdlog::warn("{}: Lost the server, reconnecting to {}:{}", playerName,
+               serverHost, serverPort);
+  sf::Clock clock;
+  while (clock.getElapsedTime() < detail::reconnectTimeout) {
+    auto link = detail::tryLink(serverHost, serverPort, sf::seconds(1));
+    sf::Packet namePacket;
+    namePacket << playerName << sessionToken;
+    if (link != nullptr &&
+        detail::trySendPacket(link, namePacket) == sf::Socket::Done &&
+        detail::resumed(link, sessionToken)) {
+      spdlog::info("{}: Back in the game", playerName);
+      socket = link;
+      // The server resumes from its last checkpoint, frames may repeat
+      lastFrameSent = -1;
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+  return false;
+}
+
 bool Connection::isActive() {
   return socket->getRemoteAddress() != sf::IpAddress::None;
 }
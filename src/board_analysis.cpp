@@ -0,0 +1,511 @@
+#include "board_analysis.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace cycles {
+
+namespace detail {
+
+const int unreached = std::numeric_limits<int>::max();
+// Largest margin an owner is trusted for, in drift
+const int horizon = 128;
+// Drift of one update beyond which every owner is examined again
+const int maxDrift = 128;
+
+// Cells in increasing key order. Keys pushed while popping are never below
+// the key just popped.
+class BucketQueue {
+  std::vector<std::vector<int>> buckets;
+  std::size_t current = 0;
+  std::size_t count = 0;
+
+public:
+  void push(int key, int cell) {
+    if (static_cast<std::size_t>(key) >= buckets.size()) {
+      buckets.resize(key + 1);
+    }
+    buckets[key].push_back(cell);
+    current = std::min<std::size_t>(current, key);
+    count++;
+  }
+
+  bool pop(int &key, int &cell) {
+    if (count == 0) {
+      current = 0;
+      return false;
+    }
+    while (buckets[current].empty()) {
+      current++;
+    }
+    key = current;
+    cell = buckets[current].back();
+    buckets[current].pop_back();
+    count--;
+    return true;
+  }
+};
+
+// Per cell marks, a new pass clears them all at once
+struct Marks {
+  std::vector<std::uint32_t> stamps;
+  std::uint32_t pass = 0;
+
+  void next(std::size_t size) {
+    if (stamps.size() != size || ++pass == 0) {
+      stamps.assign(size, 0);
+      pass = 1;
+    }
+  }
+  bool test(int cell) const { return stamps[cell] == pass; }
+  // False if it was already set
+  bool set(int cell) {
+    if (stamps[cell] == pass) {
+      return false;
+    }
+    stamps[cell] = pass;
+    return true;
+  }
+};
+
+// Reused by the repairs of each thread
+struct Scratch {
+  Marks affected;
+  std::vector<int> affectedCells;
+  std::vector<int> band;
+  std::vector<std::pair<int, int>> search;
+  BucketQueue queue;
+};
+thread_local Scratch scratch;
+
+// The padded grid as the fields see it
+struct Geometry {
+  const std::vector<Id> &cells;
+  const std::vector<int> &columns;
+  const std::vector<int> &rows;
+  int width;
+  int height;
+
+  int stride() const { return width + 2; }
+  std::array<int, 4> offsets() const {
+    return {-stride(), 1, stride(), -1};
+  }
+  int manhattan(int cell, sf::Vector2i head) const {
+    return std::abs(columns[cell] - head.x) + std::abs(rows[cell] - head.y);
+  }
+};
+
+int distanceOf(const DistanceField &field, const Geometry &geometry,
+               int cell) {
+  int detour = field.detour[cell];
+  return detour == unreached
+             ? unreached
+             : 2 * detour + geometry.manhattan(cell, field.head);
+}
+
+// A path and the straight line to the head differ by an even number of steps
+void setDistance(DistanceField &field, const Geometry &geometry, int cell,
+                 int distance) {
+  field.detour[cell] =
+      distance == unreached
+          ? unreached
+          : (distance - geometry.manhattan(cell, field.head)) / 2;
+}
+
+void build(DistanceField &field, const Geometry &geometry, sf::Vector2i head,
+           int headCell) {
+  field.head = head;
+  field.headCell = headCell;
+  field.detour.assign(geometry.cells.size(), unreached);
+  field.detour[headCell] = 0;
+  auto &search = scratch.search;
+  search.clear();
+  search.emplace_back(headCell, 0);
+  for (std::size_t i = 0; i < search.size(); i++) {
+    auto [cell, distance] = search[i];
+    for (int offset : geometry.offsets()) {
+      int next = cell + offset;
+      if (geometry.cells[next] == 0 && field.detour[next] == unreached) {
+        setDistance(field, geometry, next, distance + 1);
+        search.emplace_back(next, distance + 1);
+      }
+    }
+  }
+}
+
+// Move a field to the new head on the new grid, changed being the cells that
+// differ from the grid it was built on. Appends the cells whose distance was
+// searched again to touched.
+//
+// Read from the new head, the detours stay right except along the columns
+// and rows the head moved across, where an edge towards the head costs one
+// detour step more or less, and around the cells that changed. The cells
+// there that no neighbour leads to any more lose their distance, and so on
+// outwards, and are searched again together with the shorter paths from the
+// new head, the freed cells and the moved edges.
+void repair(DistanceField &field, const Geometry &geometry,
+            const std::vector<int> &changed, sf::Vector2i head, int headCell,
+            std::vector<int> &touched) {
+  auto &s = scratch;
+  const auto &cells = geometry.cells;
+  const auto offsets = geometry.offsets();
+  sf::Vector2i oldHead = field.head;
+  int oldCell = field.headCell;
+  field.head = head;
+  field.headCell = headCell;
+  auto isOpen = [&](int cell) { return cells[cell] == 0 || cell == headCell; };
+  auto distance = [&](int cell) { return distanceOf(field, geometry, cell); };
+
+  s.affected.next(cells.size());
+  s.affectedCells.clear();
+  auto invalidate = [&](int cell) {
+    if (s.affected.set(cell)) {
+      s.affectedCells.push_back(cell);
+      int value = distance(cell);
+      if (value != unreached) {
+        s.queue.push(value, cell);
+      }
+    }
+  };
+  // Still as close as before through a neighbour that kept its distance
+  auto supported = [&](int cell, int value) {
+    for (int offset : offsets) {
+      int previous = cell + offset;
+      if (isOpen(previous) && !s.affected.test(previous) &&
+          distance(previous) < value) {
+        return true;
+      }
+    }
+    return false;
+  };
+  auto check = [&](int cell, int above) {
+    if (cells[cell] != 0 || cell == headCell || s.affected.test(cell) ||
+        field.detour[cell] == unreached) {
+      return;
+    }
+    int value = distance(cell);
+    if (value > above && !supported(cell, value)) {
+      invalidate(cell);
+    }
+  };
+
+  // Both ends of the edges that changed cost
+  s.band.clear();
+  if (oldHead.x != head.x) {
+    for (int x = std::min(oldHead.x, head.x);
+         x <= std::max(oldHead.x, head.x); x++) {
+      for (int y = 0; y < geometry.height; y++) {
+        s.band.push_back((y + 1) * geometry.stride() + x + 1);
+      }
+    }
+  }
+  if (oldHead.y != head.y) {
+    for (int y = std::min(oldHead.y, head.y);
+         y <= std::max(oldHead.y, head.y); y++) {
+      for (int x = 0; x < geometry.width; x++) {
+        s.band.push_back((y + 1) * geometry.stride() + x + 1);
+      }
+    }
+  }
+
+  // The cells that lost every shortest path, nearest first
+  if (oldCell != headCell) {
+    invalidate(oldCell);
+  }
+  for (int cell : changed) {
+    if (!isOpen(cell)) {
+      invalidate(cell);
+    }
+  }
+  for (int cell : s.band) {
+    check(cell, -1);
+  }
+  int key, cell;
+  while (s.queue.pop(key, cell)) {
+    for (int offset : offsets) {
+      check(cell + offset, key);
+    }
+  }
+
+  // Their new distances, and the shorter paths
+  for (int cell : s.affectedCells) {
+    touched.push_back(cell);
+    field.detour[cell] = unreached;
+  }
+  auto lower = [&](int cell, int value) {
+    if (value < distance(cell)) {
+      touched.push_back(cell);
+      setDistance(field, geometry, cell, value);
+      s.queue.push(value, cell);
+    }
+  };
+  // From the cells that kept their distance, the others are lowered in turn
+  auto fromNeighbours = [&](int cell) {
+    int best = unreached;
+    for (int offset : offsets) {
+      int previous = cell + offset;
+      if (isOpen(previous) && !s.affected.test(previous) &&
+          field.detour[previous] != unreached) {
+        best = std::min(best, distance(previous) + 1);
+      }
+    }
+    return best;
+  };
+  auto seed = [&](const std::vector<int> &seeds) {
+    for (int cell : seeds) {
+      if (cells[cell] == 0) {
+        lower(cell, fromNeighbours(cell));
+      }
+    }
+  };
+  lower(headCell, 0);
+  seed(s.affectedCells);
+  seed(changed);
+  seed(s.band);
+  while (s.queue.pop(key, cell)) {
+    if (key != distance(cell)) {
+      continue; // Lowered again since
+    }
+    for (int offset : offsets) {
+      int next = cell + offset;
+      if (cells[next] == 0 && key + 1 < distance(next)) {
+        lower(next, key + 1);
+      }
+    }
+  }
+}
+
+} // namespace detail
+
+BoardAnalysis::BoardAnalysis(const GameState &state) { rebuild(state); }
+
+void BoardAnalysis::rebuild(const GameState &state) {
+  width = state.gridWidth;
+  height = state.gridHeight;
+  const int stride = width + 2;
+  const std::size_t size = stride * (height + 2);
+  cells.assign(size, GridView::wall);
+  columns.resize(size);
+  rows.resize(size);
+  for (std::size_t cell = 0; cell < size; cell++) {
+    columns[cell] = static_cast<int>(cell) % stride - 1;
+    rows[cell] = static_cast<int>(cell) / stride - 1;
+  }
+  for (int y = 0; y < height; y++) {
+    std::copy_n(state.grid.begin() + y * width, width,
+                cells.begin() + index({0, y}));
+  }
+  const detail::Geometry geometry{cells, columns, rows, width, height};
+  fields.clear();
+  for (const auto &player : state.players) {
+    if (state.isInsideGrid(player.position)) {
+      detail::build(fields[player.id], geometry, player.position,
+                    index(player.position));
+    }
+  }
+  owners.assign(size, 0);
+  territories.fill(0);
+  territories[0] = std::count(cells.begin(), cells.end(), 0);
+  examineAll();
+  repaired = size * (fields.size() + 1);
+}
+
+void BoardAnalysis::update(const GameState &state) {
+  if (!sameSize(state)) {
+    rebuild(state);
+    return;
+  }
+  // Most rows are the same as before
+  changes.clear();
+  for (int y = 0; y < height; y++) {
+    const Id *row = state.grid.data() + y * width;
+    const Id *before = cells.data() + index({0, y});
+    if (std::memcmp(row, before, width * sizeof(Id)) == 0) {
+      continue;
+    }
+    for (int x = 0; x < width; x++) {
+      if (row[x] != before[x]) {
+        changes.push_back(index({x, y}));
+      }
+    }
+  }
+  apply(state);
+}
+
+void BoardAnalysis::update(const GameState &state,
+                           const std::vector<int> &changedCells) {
+  if (!sameSize(state)) {
+    rebuild(state);
+    return;
+  }
+  changes.clear();
+  for (int cell : changedCells) {
+    changes.push_back(index({cell % width, cell / width}));
+  }
+  apply(state);
+}
+
+void BoardAnalysis::apply(const GameState &state) {
+  // A search from scratch is faster when much of the grid changed
+  if (changes.size() * 8 > static_cast<std::size_t>(width * height)) {
+    rebuild(state);
+    return;
+  }
+  for (int cell : changes) {
+    Id value = state.grid[rows[cell] * width + columns[cell]];
+    // Territories count free cells only
+    if (cells[cell] == 0) {
+      territories[owners[cell]]--;
+    }
+    cells[cell] = value;
+    if (value == 0) {
+      territories[owners[cell]]++;
+    }
+  }
+
+  const detail::Geometry geometry{cells, columns, rows, width, height};
+  std::vector<int> touched(changes);
+  std::map<Id, detail::DistanceField> alive;
+  bool joined = false;
+  int steps = 0;
+  for (const auto &player : state.players) {
+    if (!state.isInsideGrid(player.position)) {
+      continue;
+    }
+    auto &field = alive[player.id];
+    auto previous = fields.extract(player.id);
+    if (previous.empty()) {
+      joined = true;
+      detail::build(field, geometry, player.position, index(player.position));
+      continue;
+    }
+    field = std::move(previous.mapped());
+    sf::Vector2i step = player.position - field.head;
+    steps = std::max(steps, std::abs(step.x) + std::abs(step.y));
+    detail::repair(field, geometry, changes, player.position,
+                   index(player.position), touched);
+  }
+  // Whoever is left in fields is out of the game
+  std::array<bool, 256> gone{};
+  for (const auto &[id, field] : fields) {
+    gone[id] = true;
+  }
+  const bool left = !fields.empty();
+  fields.swap(alive);
+
+  // Every distance moves with its head, a gap by twice the longest step
+  const int before = drift;
+  drift += 2 * steps;
+  if (joined || drift - before > detail::maxDrift) {
+    examineAll();
+    repaired = touched.size() + cells.size();
+    return;
+  }
+  examined.resize(cells.size());
+  examination++;
+  int count = 0;
+  auto visit = [&](int cell) {
+    if (examined[cell] != examination) {
+      examined[cell] = examination;
+      examine(cell);
+      count++;
+    }
+  };
+  for (int cell : touched) {
+    visit(cell);
+  }
+  for (int deadline = before + 1; deadline <= drift; deadline++) {
+    auto &due = schedule[deadline % schedule.size()];
+    // Examining never schedules into a slot being drained
+    for (std::size_t i = 0; i < due.size(); i++) {
+      if (deadlines[due[i]] == deadline) {
+        visit(due[i]);
+      }
+    }
+    due.clear();
+  }
+  // The cells of the players that left go to the next closest
+  for (std::size_t cell = 0; left && cell < cells.size(); cell++) {
+    if (gone[owners[cell]] || owners[cell] == contested) {
+      visit(cell);
+    }
+  }
+  repaired = touched.size() + count;
+}
+
+void BoardAnalysis::examine(int cell) {
+  Id best = 0;
+  int closest = detail::unreached;
+  int second = detail::unreached;
+  if (cells[cell] == 0) {
+    for (const auto &[id, field] : fields) {
+      int value = distanceFrom(field, cell);
+      if (value < closest) {
+        second = closest;
+        closest = value;
+        best = id;
+      } else if (value == closest && value != detail::unreached) {
+        second = value;
+        best = contested;
+      } else if (value < second) {
+        second = value;
+      }
+    }
+    territories[owners[cell]]--;
+    territories[best]++;
+  }
+  owners[cell] = best;
+  // Only a change of distance gives a cell one player reaches to another
+  if (second == detail::unreached) {
+    deadlines[cell] = -1;
+    return;
+  }
+  deadlines[cell] = drift + std::clamp(second - closest, 1, detail::horizon);
+  schedule[deadlines[cell] % schedule.size()].push_back(cell);
+}
+
+void BoardAnalysis::examineAll() {
+  deadlines.assign(cells.size(), -1);
+  schedule.assign(detail::horizon + detail::maxDrift + 1, {});
+  for (std::size_t cell = 0; cell < cells.size(); cell++) {
+    examine(cell);
+  }
+}
+
+int BoardAnalysis::distanceFrom(const detail::DistanceField &field,
+                                int cell) const {
+  const detail::Geometry geometry{cells, columns, rows, width, height};
+  return detail::distanceOf(field, geometry, cell);
+}
+
+int BoardAnalysis::distance(sf::Vector2i cell) const {
+  if (cell.x < 0 || cell.x >= width || cell.y < 0 || cell.y >= height) {
+    return unreachable;
+  }
+  int closest = detail::unreached;
+  for (const auto &[id, field] : fields) {
+    closest = std::min(closest, distanceFrom(field, index(cell)));
+  }
+  return closest == detail::unreached ? unreachable : closest;
+}
+
+int BoardAnalysis::distance(Id player, sf::Vector2i cell) const {
+  auto field = fields.find(player);
+  if (field == fields.end() || cell.x < 0 || cell.x >= width || cell.y < 0 ||
+      cell.y >= height) {
+    return unreachable;
+  }
+  int value = distanceFrom(field->second, index(cell));
+  return value == detail::unreached ? unreachable : value;
+}
+
+Id BoardAnalysis::owner(sf::Vector2i cell) const {
+  if (cell.x < 0 || cell.x >= width || cell.y < 0 || cell.y >= height) {
+    return 0;
+  }
+  return owners[index(cell)];
+}
+
+} // namespace cycles
@@ -6,7 +6,6 @@
 #include <limits>
 #include <cmath>
 #include <queue>
-#include <set>
 #include <spdlog/spdlog.h>
 
 using namespace cycles;
@@ -22,14 +21,6 @@ public:
     }
 };
 
-// Defining a custom comparator for sf::Vector2i
-// given that it is not directly comparable 
-struct Vector2Comparator {
-    bool operator()(const sf::Vector2i &a, const sf::Vector2i &b) const {
-        return (a.x < b.x) || (a.x == b.x && a.y < b.y); // 
-    }
-};
-
 // Terminator bot ta=hat targets the nearest opponent until terminated >:)
 // Only falls back to random moves when in a tight spot
 // Uses a combination of safety, proximity, trapping potential, and available space
@@ -39,6 +30,7 @@ class AggressiveTargetBot {
     Connection connection;
     std::string name;
     GameState state;
+    GridView grid; // Bordered copy of state.grid, probes need no bounds checks
     Player myPlayer;
 
     // Computes Manhattan distance between two positions
@@ -76,7 +68,7 @@ class AggressiveTargetBot {
 
             for (Direction direction : {Direction::north, Direction::east, Direction::south, Direction::west}) {
                 sf::Vector2i newPos = oppPos + getDirectionVector(direction);
-                if (state.isInsideGrid(newPos) && state.isCellEmpty(newPos)) {
+                if (grid.isFree(newPos)) {
                     return newPos;
                 }
             }
@@ -91,22 +83,25 @@ class AggressiveTargetBot {
     int calculateAvailableSpace(sf::Vector2i pos) {
         try {
             int space = 0;
-            std::queue<sf::Vector2i> toVisit;
-            std::set<sf::Vector2i, Vector2Comparator> visited;
+            std::queue<int> toVisit;
+            // Border cells are never free, so neighbors never leave the grid
+            std::vector<char> visited(grid.size(), 0);
+            const int offsets[] = {grid.offset(Direction::north), grid.offset(Direction::east),
+                                   grid.offset(Direction::south), grid.offset(Direction::west)};
 
-            toVisit.push(pos);
-            visited.insert(pos);
+            int start = grid.index(pos);
+            toVisit.push(start);
+            visited[start] = 1;
 
             while (!toVisit.empty() && space < 20) {
-                sf::Vector2i current = toVisit.front();
+                int current = toVisit.front();
                 toVisit.pop();
                 space++;
 
-                for (Direction direction : {Direction::north, Direction::east, Direction::south, Direction::west}) {
-                    sf::Vector2i neighbor = current + getDirectionVector(direction);
-                    if (state.isInsideGrid(neighbor) && state.isCellEmpty(neighbor) &&
-                        visited.find(neighbor) == visited.end()) {
-                        visited.insert(neighbor);
+                for (int offset : offsets) {
+                    int neighbor = current + offset;
+                    if (grid.isFree(neighbor) && !visited[neighbor]) {
+                        visited[neighbor] = 1;
                         toVisit.push(neighbor);
                     }
                 }
@@ -134,7 +129,7 @@ class AggressiveTargetBot {
             for (Direction direction : {Direction::north, Direction::east, Direction::south, Direction::west}) {
                 sf::Vector2i newPos = myPos + getDirectionVector(direction);
 
-                if (state.isInsideGrid(newPos) && state.isCellEmpty(newPos)) {
+                if (grid.isFree(newPos)) {
                     int safetyScore = calculateSafety(newPos);
                     int proximityScore = -calculateDistance(newPos, target); // Negative for closer proximity
                     int trappingScore = calculateTrappingPotential(newPos, predictedOpponentPos);
@@ -166,7 +161,7 @@ class AggressiveTargetBot {
 
         for (Direction direction : {Direction::north, Direction::east, Direction::south, Direction::west}) {
             sf::Vector2i neighbor = pos + getDirectionVector(direction);
-            if (!state.isInsideGrid(neighbor) || !state.isCellEmpty(neighbor)) {
+            if (!grid.isFree(neighbor)) {
                 safetyScore -= 10; // Higher penalty for closer obstacles
             }
         }
@@ -179,7 +174,7 @@ class AggressiveTargetBot {
 
         for (Direction direction : {Direction::north, Direction::east, Direction::south, Direction::west}) {
             sf::Vector2i newPos = predictedOpponentPos + getDirectionVector(direction);
-            if (!state.isInsideGrid(newPos) || !state.isCellEmpty(newPos)) {
+            if (!grid.isFree(newPos)) {
                 trappingPotential += 5; // Reward reducing opponent's escape routes
             }
         }
@@ -191,7 +186,7 @@ class AggressiveTargetBot {
         std::vector<Direction> directions = {Direction::north, Direction::east, Direction::south, Direction::west};
         for (Direction direction : directions) {
             sf::Vector2i newPos = myPlayer.position + getDirectionVector(direction);
-            if (state.isInsideGrid(newPos) && state.isCellEmpty(newPos)) {
+            if (grid.isFree(newPos)) {
                 return direction;
             }
         }
@@ -202,6 +197,7 @@ class AggressiveTargetBot {
     void updateState() {
         try {
             state = connection.receiveGameState();
+            grid = GridView(state);
             for (const auto &player : state.players) {
                 if (player.name == name) {
                     myPlayer = player;
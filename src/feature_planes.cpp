@@ -0,0 +1,289 @@
+#include "feature_planes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cycles {
+
+namespace detail {
+
+constexpr Id outside = noPlayer; // Window cells off the grid
+
+// A grid and the heads of its players, from a GameState or from raw arrays
+struct StateView {
+  const Id *grid;
+  int width;
+  int height;
+  std::vector<std::pair<Id, sf::Vector2i>> heads;
+};
+
+// Turn a vector a quarter clockwise (y points down) quarters times
+sf::Vector2i turn(sf::Vector2i vector, int quarters) {
+  for (int i = 0; i < (quarters & 3); i++) {
+    vector = {-vector.y, vector.x};
+  }
+  return vector;
+}
+
+// The window around the head, outside where it leaves the grid. Each row is
+// a line of the grid in some direction, copied with a fixed stride.
+void fillWindow(const StateView &view, sf::Vector2i head, int radius,
+                int quarters, Id *window) {
+  const int side = 2 * radius + 1;
+  const sf::Vector2i step = turn({1, 0}, quarters);
+  const int stride = step.x + step.y * view.width;
+  for (int row = 0; row < side; row++) {
+    Id *out = window + row * side;
+    sf::Vector2i start = head + turn({-radius, row - radius}, quarters);
+    // Columns [first, last) are on the grid
+    int first = 0, last = side;
+    auto clip = [&](int position, int delta, int size) {
+      if (delta == 0) {
+        if (position < 0 || position >= size) {
+          last = first;
+        }
+      } else if (delta > 0) {
+        first = std::max(first, -position);
+        last = std::min(last, size - position);
+      } else {
+        first = std::max(first, position - size + 1);
+        last = std::min(last, position + 1);
+      }
+    };
+    clip(start.x, step.x, view.width);
+    clip(start.y, step.y, view.height);
+    if (first >= last) {
+      std::fill(out, out + side, outside);
+      continue;
+    }
+    std::fill(out, out + first, outside);
+    std::fill(out + last, out + side, outside);
+    const Id *in = view.grid + (start.y + first * step.y) * view.width +
+                   start.x + first * step.x;
+    if (stride == 1) {
+      std::memcpy(out + first, in, last - first);
+    } else {
+      for (int column = first; column < last; column++, in += stride) {
+        out[column] = *in;
+      }
+    }
+  }
+}
+
+// 1 where the cell is value, or with opponents where it is neither empty,
+// outside nor value
+void binaryPlane(const Id *window, int size, Id value, bool opponents,
+                 std::uint8_t *out) {
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i target = _mm_set1_epi8(static_cast<char>(value));
+  const __m128i empty = _mm_setzero_si128();
+  const __m128i wall = _mm_set1_epi8(static_cast<char>(outside));
+  for (; i + 16 <= size; i += 16) {
+    __m128i cells =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(window + i));
+    __m128i match = _mm_cmpeq_epi8(cells, target);
+    if (opponents) {
+      match = _mm_or_si128(match, _mm_cmpeq_epi8(cells, empty));
+      match = _mm_or_si128(match, _mm_cmpeq_epi8(cells, wall));
+      match = _mm_andnot_si128(match, one);
+    } else {
+      match = _mm_and_si128(match, one);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), match);
+  }
+#endif
+  for (; i < size; i++) {
+    Id cell = window[i];
+    out[i] = opponents ? cell != value && cell != 0 && cell != outside
+                       : cell == value;
+  }
+}
+
+// Bytes to floats, 16 at a time
+void widen(const std::uint8_t *in, int size, float *out) {
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= size; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)));
+    _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)));
+    _mm_storeu_ps(out + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)));
+    _mm_storeu_ps(out + i + 12,
+                  _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)));
+  }
+#endif
+  for (; i < size; i++) {
+    out[i] = in[i];
+  }
+}
+
+void store(const std::uint8_t *plane, int size, std::uint8_t *out) {
+  std::memcpy(out, plane, size);
+}
+
+void store(const std::uint8_t *plane, int size, float *out) {
+  widen(plane, size, out);
+}
+
+std::uint8_t scale(float value, std::uint8_t) {
+  return static_cast<std::uint8_t>(std::lround(value * 255));
+}
+
+float scale(float value, float) { return value; }
+
+template <typename T>
+bool encode(const FeatureOptions &options, const StateView &view, Id player,
+            Direction heading, T *out) {
+  auto own = std::find_if(view.heads.begin(), view.heads.end(),
+                          [player](const auto &head) {
+                            return head.first == player;
+                          });
+  if (own == view.heads.end()) {
+    return false;
+  }
+  const sf::Vector2i head = own->second;
+  const int radius = options.radius;
+  const int side = 2 * radius + 1;
+  const int size = side * side;
+  const int quarters = options.rotate ? static_cast<int>(heading) : 0;
+  // Reused by the calls of each thread
+  thread_local std::vector<Id> window;
+  thread_local std::vector<std::uint8_t> plane;
+  window.resize(size);
+  plane.resize(size);
+  fillWindow(view, head, radius, quarters, window.data());
+  for (auto feature : options.planes) {
+    switch (feature) {
+    case FeaturePlane::free:
+      binaryPlane(window.data(), size, 0, false, plane.data());
+      store(plane.data(), size, out);
+      break;
+    case FeaturePlane::wall:
+      binaryPlane(window.data(), size, outside, false, plane.data());
+      store(plane.data(), size, out);
+      break;
+    case FeaturePlane::own:
+      binaryPlane(window.data(), size, player, false, plane.data());
+      store(plane.data(), size, out);
+      break;
+    case FeaturePlane::opponents:
+      binaryPlane(window.data(), size, player, true, plane.data());
+      store(plane.data(), size, out);
+      break;
+    case FeaturePlane::ownHead:
+      std::fill(out, out + size, T(0));
+      out[radius * side + radius] = 1;
+      break;
+    case FeaturePlane::opponentHeads:
+      std::fill(out, out + size, T(0));
+      for (const auto &[id, position] : view.heads) {
+        // Back from the grid to the window
+        auto local = turn(position - head, 4 - quarters);
+        if (id != player && std::abs(local.x) <= radius &&
+            std::abs(local.y) <= radius) {
+          out[(local.y + radius) * side + local.x + radius] = 1;
+        }
+      }
+      break;
+    case FeaturePlane::wallDistance: {
+      const float half = (std::min(view.width, view.height) + 1) / 2;
+      const sf::Vector2i step = turn({1, 0}, quarters);
+      for (int row = 0; row < side; row++) {
+        auto position = head + turn({-radius, row - radius}, quarters);
+        for (int column = 0; column < side; column++, position += step) {
+          int steps = std::min({position.x + 1, position.y + 1,
+                                view.width - position.x,
+                                view.height - position.y});
+          out[row * side + column] =
+              scale(std::clamp(steps / half, 0.f, 1.f), T());
+        }
+      }
+      break;
+    }
+    }
+    out += size;
+  }
+  return true;
+}
+
+StateView view(const GameState &state) {
+  StateView view{state.grid.data(), state.gridWidth, state.gridHeight, {}};
+  view.heads.reserve(state.players.size());
+  for (const auto &player : state.players) {
+    view.heads.emplace_back(player.id, player.position);
+  }
+  return view;
+}
+
+template <typename T>
+int encodeBatch(const FeatureEncoder &encoder,
+                const std::vector<FeatureInput> &inputs, T *out) {
+  int encoded = 0;
+  for (const auto &input : inputs) {
+    encoded += encoder.encode(input, out);
+    out += encoder.size();
+  }
+  return encoded;
+}
+
+} // namespace detail
+
+FeatureEncoder::FeatureEncoder(FeatureOptions options)
+    : options(std::move(options)) {
+  this->options.radius = std::max(0, this->options.radius);
+}
+
+bool FeatureEncoder::encode(const FeatureInput &input, float *out) const {
+  return detail::encode(options, detail::view(*input.state), input.player,
+                        input.heading, out);
+}
+
+bool FeatureEncoder::encode(const FeatureInput &input,
+                            std::uint8_t *out) const {
+  return detail::encode(options, detail::view(*input.state), input.player,
+                        input.heading, out);
+}
+
+int FeatureEncoder::encodeBatch(const std::vector<FeatureInput> &inputs,
+                                float *out) const {
+  return detail::encodeBatch(*this, inputs, out);
+}
+
+int FeatureEncoder::encodeBatch(const std::vector<FeatureInput> &inputs,
+                                std::uint8_t *out) const {
+  return detail::encodeBatch(*this, inputs, out);
+}
+
+} // namespace cycles
+
+int cycles_feature_size(int radius) {
+  cycles::FeatureOptions options;
+  options.radius = radius;
+  return static_cast<int>(cycles::FeatureEncoder(options).size());
+}
+
+int cycles_encode_features(const std::uint8_t *grid, int width, int height,
+                           const int *heads, const std::uint8_t *ids,
+                           int playerCount, std::uint8_t player, int heading,
+                           int radius, int rotate, float *out) {
+  cycles::detail::StateView view{grid, width, height, {}};
+  for (int i = 0; i < playerCount; i++) {
+    view.heads.emplace_back(ids[i],
+                            sf::Vector2i(heads[2 * i], heads[2 * i + 1]));
+  }
+  cycles::FeatureOptions options;
+  options.radius = std::max(0, radius);
+  options.rotate = rotate != 0;
+  bool encoded = cycles::detail::encode(
+      options, view, player, static_cast<cycles::Direction>(heading & 3), out);
+  return encoded ? 0 : -1;
+}
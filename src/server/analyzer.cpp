@@ -0,0 +1,331 @@
+// Aggregate statistics over many replays, one file per worker at a time.
+// Writes a table with one row per player and match, and optionally one with
+// the territory of each player over time, both as CSV and as a columnar
+// binary file.
+#include "replay_analysis.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+using namespace cycles_server;
+
+// Column oriented table, the layout of the binary output
+struct Column {
+  std::string name;
+  std::variant<std::vector<std::int64_t>, std::vector<double>,
+               std::vector<std::string>>
+      values;
+};
+
+// Columns stay in place as others are added
+struct Table {
+  std::deque<Column> columns;
+  std::size_t rows = 0;
+
+  template <typename T> std::vector<T> &add(const std::string &name) {
+    columns.push_back({name, std::vector<T>()});
+    return std::get<std::vector<T>>(columns.back().values);
+  }
+};
+
+std::string csvField(const std::string &value) {
+  if (value.find_first_of(",\"\n") == std::string::npos) {
+    return value;
+  }
+  std::string quoted = "\"";
+  for (char c : value) {
+    quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+  }
+  return quoted + "\"";
+}
+
+void writeCsv(const Table &table, const std::string &path) {
+  std::ofstream out(path);
+  for (std::size_t c = 0; c < table.columns.size(); c++) {
+    out << (c > 0 ? "," : "") << table.columns[c].name;
+  }
+  out << "\n";
+  for (std::size_t row = 0; row < table.rows; row++) {
+    for (std::size_t c = 0; c < table.columns.size(); c++) {
+      out << (c > 0 ? "," : "");
+      std::visit(
+          [&](const auto &values) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(values)>,
+                                         std::vector<std::string>>) {
+              out << csvField(values[row]);
+            } else {
+              out << values[row];
+            }
+          },
+          table.columns[c].values);
+    }
+    out << "\n";
+  }
+}
+
+// "CYCCOL01", column count (u32), row count (u64), then per column its name
+// (u32 size + bytes), its type (u8: 0 int64, 1 float64, 2 string) and its
+// values back to back, strings as u32 size + bytes. Little endian.
+void writeColumnar(const Table &table, const std::string &path) {
+  std::ofstream out(path, std::ios::binary);
+  auto write = [&out](auto value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+  auto writeString = [&](const std::string &value) {
+    write(static_cast<std::uint32_t>(value.size()));
+    out.write(value.data(), value.size());
+  };
+  out.write("CYCCOL01", 8);
+  write(static_cast<std::uint32_t>(table.columns.size()));
+  write(static_cast<std::uint64_t>(table.rows));
+  for (const auto &column : table.columns) {
+    writeString(column.name);
+    write(static_cast<std::uint8_t>(column.values.index()));
+    std::visit(
+        [&](const auto &values) {
+          using T = typename std::decay_t<decltype(values)>::value_type;
+          if constexpr (std::is_same_v<T, std::string>) {
+            for (const auto &value : values) {
+              writeString(value);
+            }
+          } else {
+            out.write(reinterpret_cast<const char *>(values.data()),
+                      values.size() * sizeof(T));
+          }
+        },
+        column.values);
+  }
+}
+
+std::string causeName(const PlayerStats &player) {
+  if (player.survived) {
+    return "survived";
+  }
+  if (!player.cause) {
+    return "removed";
+  }
+  return deathCauseName(*player.cause);
+}
+
+struct Metrics {
+  bool survival = true;
+  bool deaths = true;
+  bool latency = true;
+  bool territory = false;
+};
+
+Table playerTable(const std::vector<std::string> &replays,
+                  const std::vector<MatchStats> &matches,
+                  const Metrics &metrics) {
+  Table table;
+  auto &match = table.add<std::string>("match");
+  auto &player = table.add<std::int64_t>("player");
+  auto &name = table.add<std::string>("name");
+  for (std::size_t m = 0; m < matches.size(); m++) {
+    for (const auto &[id, stats] : matches[m].players) {
+      match.push_back(replays[m]);
+      player.push_back(id);
+      name.push_back(stats.name);
+    }
+  }
+  table.rows = match.size();
+  // The rest of the columns, in the same row order
+  auto column = [&](auto &values, auto get) {
+    for (const auto &stats : matches) {
+      for (const auto &[id, playerStats] : stats.players) {
+        values.push_back(get(playerStats));
+      }
+    }
+  };
+  if (metrics.survival) {
+    column(table.add<std::int64_t>("first_frame"),
+           [](const PlayerStats &p) { return p.firstFrame; });
+    column(table.add<std::int64_t>("last_frame"),
+           [](const PlayerStats &p) { return p.lastFrame; });
+    column(table.add<std::int64_t>("survival_frames"),
+           [](const PlayerStats &p) { return p.lastFrame - p.firstFrame; });
+    column(table.add<std::int64_t>("territory"),
+           [](const PlayerStats &p) { return p.territory; });
+  }
+  if (metrics.deaths) {
+    column(table.add<std::string>("cause"), causeName);
+    column(table.add<std::int64_t>("killer"),
+           [](const PlayerStats &p) { return p.killer; });
+    column(table.add<std::int64_t>("kills"),
+           [](const PlayerStats &p) { return p.kills; });
+  }
+  if (metrics.latency) {
+    // Sorted once per player for the percentiles
+    std::vector<std::vector<float>> sorted;
+    column(sorted, [](const PlayerStats &p) {
+      auto latencies = p.latencies;
+      std::sort(latencies.begin(), latencies.end());
+      return latencies;
+    });
+    auto summary = [&table, &sorted](const std::string &columnName,
+                                     auto get) {
+      auto &values = table.add<double>(columnName);
+      for (const auto &latencies : sorted) {
+        values.push_back(latencies.empty() ? 0 : get(latencies));
+      }
+    };
+    auto &answered = table.add<std::int64_t>("answered_frames");
+    for (const auto &latencies : sorted) {
+      answered.push_back(latencies.size());
+    }
+    summary("latency_mean_ms", [](const std::vector<float> &l) {
+      return std::accumulate(l.begin(), l.end(), 0.0) / l.size();
+    });
+    summary("latency_p50_ms",
+            [](const std::vector<float> &l) { return l[l.size() / 2]; });
+    summary("latency_p99_ms", [](const std::vector<float> &l) {
+      return l[std::min(l.size() - 1, l.size() * 99 / 100)];
+    });
+    summary("latency_max_ms",
+            [](const std::vector<float> &l) { return l.back(); });
+  }
+  return table;
+}
+
+Table territoryTable(const std::vector<std::string> &replays,
+                     const std::vector<MatchStats> &matches) {
+  Table table;
+  auto &match = table.add<std::string>("match");
+  auto &frame = table.add<std::int64_t>("frame");
+  auto &player = table.add<std::int64_t>("player");
+  auto &cells = table.add<std::int64_t>("cells");
+  for (std::size_t m = 0; m < matches.size(); m++) {
+    for (const auto &sample : matches[m].territory) {
+      match.push_back(replays[m]);
+      frame.push_back(sample.frame);
+      player.push_back(sample.player);
+      cells.push_back(sample.cells);
+    }
+  }
+  table.rows = match.size();
+  return table;
+}
+
+void usage(const char *name) {
+  spdlog::critical("Usage: {} [--threads N] [--metrics survival,deaths,"
+                   "latency,territory] [--territory-interval N] <output> "
+                   "<replay or directory>...",
+                   name);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  Metrics metrics;
+  AnalysisOptions options;
+  int territoryInterval = 100;
+  std::vector<std::string> arguments;
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    if (argument == "--threads" && i + 1 < argc) {
+      threads = std::max(1, std::stoi(argv[++i]));
+    } else if (argument == "--territory-interval" && i + 1 < argc) {
+      territoryInterval = std::max(1, std::stoi(argv[++i]));
+    } else if (argument == "--metrics" && i + 1 < argc) {
+      metrics = {false, false, false, false};
+      std::stringstream list(argv[++i]);
+      std::string metric;
+      while (std::getline(list, metric, ',')) {
+        if (metric == "survival") {
+          metrics.survival = true;
+        } else if (metric == "deaths") {
+          metrics.deaths = true;
+        } else if (metric == "latency") {
+          metrics.latency = true;
+        } else if (metric == "territory") {
+          metrics.territory = true;
+        } else {
+          spdlog::critical("Unknown metric {}", metric);
+          usage(argv[0]);
+        }
+      }
+    } else {
+      arguments.push_back(argument);
+    }
+  }
+  if (arguments.size() < 2) {
+    usage(argv[0]);
+  }
+  options.latency = metrics.latency;
+  options.territoryInterval = metrics.territory ? territoryInterval : 0;
+  const std::string output = arguments[0];
+  std::vector<std::string> replays;
+  for (std::size_t i = 1; i < arguments.size(); i++) {
+    if (std::filesystem::is_directory(arguments[i])) {
+      for (const auto &entry :
+           std::filesystem::directory_iterator(arguments[i])) {
+        if (entry.is_regular_file()) {
+          replays.push_back(entry.path().string());
+        }
+      }
+    } else {
+      replays.push_back(arguments[i]);
+    }
+  }
+  std::sort(replays.begin(), replays.end());
+
+  // Workers take the next replay until none is left, results keep the order
+  // of the inputs
+  std::vector<MatchStats> matches(replays.size());
+  std::vector<char> valid(replays.size(), 0);
+  std::atomic<std::size_t> next = 0;
+  auto worker = [&] {
+    for (auto i = next++; i < replays.size(); i = next++) {
+      ReplayFile file;
+      if (!file.open(replays[i])) {
+        spdlog::error("Can not read {}", replays[i]);
+        continue;
+      }
+      valid[i] = analyzeReplay(file, options, matches[i]);
+      if (!valid[i]) {
+        spdlog::error("{} is not a replay", replays[i]);
+      }
+    }
+  };
+  sf::Clock clock;
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < std::min<std::size_t>(threads, replays.size());
+       i++) {
+    pool.emplace_back(worker);
+  }
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  // Drop the replays that could not be read
+  std::vector<std::string> names;
+  std::vector<MatchStats> results;
+  for (std::size_t i = 0; i < replays.size(); i++) {
+    if (valid[i]) {
+      names.push_back(replays[i]);
+      results.push_back(std::move(matches[i]));
+    }
+  }
+  spdlog::info("Analyzed {} replays in {:.2f} s with {} threads",
+               results.size(), clock.getElapsedTime().asSeconds(),
+               pool.size());
+
+  auto players = playerTable(names, results, metrics);
+  writeCsv(players, output + ".csv");
+  writeColumnar(players, output + ".col");
+  if (metrics.territory) {
+    auto territory = territoryTable(names, results);
+    writeCsv(territory, output + "_territory.csv");
+    writeColumnar(territory, output + "_territory.col");
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "server.h"
+#include <array>
+#include <vector>
+
+namespace cycles_server {
+
+// Occupancy grid surrounded by a one cell border of walls. Moves are one
+// step, so a probe from any cell of the board lands inside the storage and
+// "is this cell free" is a single load without bounds checks.
+class PaddedGrid {
+  int width;
+  int height;
+  std::vector<Id> cells;
+
+public:
+  // Value of the border cells, anything but 0 is occupied
+  static constexpr Id wall = cycles::noPlayer;
+
+  PaddedGrid(int width, int height)
+      : width(width), height(height), cells((width + 2) * (height + 2), 0) {
+    for (int x = -1; x <= width; x++) {
+      cells[index(x, -1)] = wall;
+      cells[index(x, height)] = wall;
+    }
+    for (int y = 0; y < height; y++) {
+      cells[index(-1, y)] = wall;
+      cells[index(width, y)] = wall;
+    }
+  }
+
+  int getWidth() const { return width; }
+
+  int getHeight() const { return height; }
+
+  int stride() const { return width + 2; }
+
+  // Valid from -1 to width/height, the border included
+  int index(int x, int y) const { return (y + 1) * stride() + x + 1; }
+
+  int index(sf::Vector2i position) const {
+    return index(position.x, position.y);
+  }
+
+  Id &operator[](int i) { return cells[i]; }
+
+  Id operator[](int i) const { return cells[i]; }
+
+  Id &at(sf::Vector2i position) { return cells[index(position)]; }
+
+  Id at(sf::Vector2i position) const { return cells[index(position)]; }
+
+  bool isInside(sf::Vector2i position) const {
+    return position.x >= 0 && position.x < width && position.y >= 0 &&
+           position.y < height;
+  }
+
+  // Index offset of a step in each direction, in Direction order
+  std::array<int, 4> neighbourOffsets() const {
+    return {-stride(), 1, stride(), -1};
+  }
+
+  // Free cells around a cell of the board
+  int freeNeighbours(int i) const {
+    return (cells[i - stride()] == 0) + (cells[i + 1] == 0) +
+           (cells[i + stride()] == 0) + (cells[i - 1] == 0);
+  }
+
+  // Call f(row, width) for each row of the board, without the border
+  template <typename F> void forEachRow(F &&f) const {
+    for (int y = 0; y < height; y++) {
+      f(&cells[index(0, y)], width);
+    }
+  }
+
+  // Row-major copy without the border, the layout sent to the clients
+  std::vector<Id> unpadded() const {
+    std::vector<Id> result;
+    result.reserve(width * height);
+    forEachRow([&result](const Id *row, int width) {
+      result.insert(result.end(), row, row + width);
+    });
+    return result;
+  }
+};
+
+} // namespace cycles_server
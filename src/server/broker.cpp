@@ -0,0 +1,159 @@
+#include "broker.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace cycles_server {
+
+void write(sf::Packet &packet, const LoadReport &report) {
+  packet << report.host << report.port << report.players << report.maxClients
+         << report.accepting << report.playing << report.tickP99
+         << report.tickPeriod << report.cpu;
+}
+
+bool read(sf::Packet &packet, LoadReport &report) {
+  return static_cast<bool>(packet >> report.host >> report.port >>
+                           report.players >> report.maxClients >>
+                           report.accepting >> report.playing >>
+                           report.tickP99 >> report.tickPeriod >> report.cpu);
+}
+
+void writeRedirect(sf::Packet &packet, const std::string &host, int port) {
+  packet << std::string("redirect") << host << port;
+}
+
+float CpuMeter::sample() {
+#ifdef __linux__
+  std::ifstream stat("/proc/stat");
+  std::string cpu;
+  unsigned long long user, nice, system, idle, iowait, irq, softirq;
+  if (stat >> cpu >> user >> nice >> system >> idle >> iowait >> irq >>
+      softirq) {
+    unsigned long long busy = user + nice + system + irq + softirq;
+    unsigned long long total = busy + idle + iowait;
+    float load = total > lastTotal ? static_cast<float>(busy - lastBusy) /
+                                         (total - lastTotal)
+                                   : 0;
+    lastBusy = busy;
+    lastTotal = total;
+    return load;
+  }
+  return 0;
+#elif defined(_WIN32)
+  return 0;
+#else
+  double average = 0;
+  if (getloadavg(&average, 1) != 1) {
+    return 0;
+  }
+  return std::min(1.f, static_cast<float>(average) /
+                           std::max(1u, std::thread::hardware_concurrency()));
+#endif
+}
+
+void Broker::report(const LoadReport &report, sf::Time now) {
+  auto &instance = instances[{report.host, report.port}];
+  // The clients that joined since the last report are in this one
+  int joined = report.players - instance.report.players;
+  instance.assigned = report.accepting ? std::max(0, instance.assigned - joined)
+                                       : 0;
+  instance.report = report;
+  instance.seen = now;
+}
+
+float Broker::hostLoad(const std::string &host, sf::Time now) const {
+  float matches = 0;
+  float cpu = 0;
+  float tick = 0;
+  for (const auto &[key, instance] : instances) {
+    if (key.first != host || now - instance.seen > staleAfter) {
+      continue;
+    }
+    const auto &report = instance.report;
+    cpu = std::max(cpu, report.cpu);
+    if (report.playing) {
+      matches++;
+      if (report.tickPeriod > 0) {
+        tick = std::max(tick, report.tickP99 / report.tickPeriod);
+      }
+    }
+  }
+  return matches + cpu + tick;
+}
+
+std::optional<std::pair<std::string, int>> Broker::assign(sf::Time now) {
+  Instance *best = nullptr;
+  std::tuple<float, int> bestRank;
+  for (auto &[key, instance] : instances) {
+    const auto &report = instance.report;
+    int players = report.players + instance.assigned;
+    if (now - instance.seen > staleAfter || !report.accepting ||
+        players >= report.maxClients) {
+      continue;
+    }
+    // Least loaded host first, then the fullest lobby
+    std::tuple<float, int> rank{hostLoad(report.host, now), -players};
+    if (!best || rank < bestRank) {
+      best = &instance;
+      bestRank = rank;
+    }
+  }
+  if (!best) {
+    return std::nullopt;
+  }
+  best->assigned++;
+  return std::make_pair(best->report.host, best->report.port);
+}
+
+LoadReporter::LoadReporter(const std::string &broker,
+                           std::function<LoadReport()> collect,
+                           sf::Time interval)
+    : collect(std::move(collect)), interval(interval) {
+  auto colon = broker.rfind(':');
+  brokerHost = broker.substr(0, colon);
+  brokerPort = colon == std::string::npos
+                   ? 0
+                   : std::atoi(broker.substr(colon + 1).c_str());
+  thread = std::thread(&LoadReporter::run, this);
+}
+
+LoadReporter::~LoadReporter() {
+  running = false;
+  thread.join();
+}
+
+void LoadReporter::run() {
+  sf::TcpSocket socket;
+  bool connected = false;
+  while (running) {
+    if (!connected) {
+      connected = socket.connect(brokerHost, brokerPort, sf::seconds(1)) ==
+                  sf::Socket::Done;
+      if (connected) {
+        spdlog::info("Reporting the load to the broker at {}:{}", brokerHost,
+                     brokerPort);
+      }
+    }
+    if (connected) {
+      sf::Packet packet;
+      write(packet, collect());
+      if (socket.send(packet) != sf::Socket::Done) {
+        spdlog::warn("Lost the broker at {}:{}", brokerHost, brokerPort);
+        socket.disconnect();
+        connected = false;
+      }
+    }
+    // Short sleeps so the destructor does not wait for a whole interval
+    sf::Clock clock;
+    while (running && clock.getElapsedTime() < interval) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+}
+
+} // namespace cycles_server
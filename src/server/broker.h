@@ -0,0 +1,91 @@
+#pragma once
+#include "server.h"
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace cycles_server {
+
+// What a server tells the broker every report interval
+struct LoadReport {
+  std::string host; // Address the clients use to reach the server
+  int port = 0;     // Its client port
+  int players = 0;  // Joined so far
+  int maxClients = 0;
+  bool accepting = false; // The lobby is open
+  bool playing = false;   // A match is running
+  float tickP99 = 0;      // Tick duration p99 of the match (ms)
+  float tickPeriod = 0;   // ms
+  float cpu = 0;          // Busy fraction of the host's cores, 0 to 1
+};
+
+void write(sf::Packet &packet, const LoadReport &report);
+bool read(sf::Packet &packet, LoadReport &report);
+
+// The redirect a client gets instead of its color, it starts with the string
+// "redirect"
+void writeRedirect(sf::Packet &packet, const std::string &host, int port);
+
+// Busy fraction of the cores since the previous sample, from /proc/stat on
+// Linux and the load average elsewhere
+class CpuMeter {
+  unsigned long long lastBusy = 0;
+  unsigned long long lastTotal = 0;
+
+public:
+  float sample();
+};
+
+// Assigns joining clients to the servers that report to it. Servers are
+// grouped by host, and a host's load is its running matches, plus its cpu,
+// plus how much of the tick period its slowest match uses (p99). Clients go
+// to an open lobby on the least loaded host, the fullest lobby there first
+// so matches start.
+class Broker {
+  struct Instance {
+    LoadReport report;
+    sf::Time seen;
+    int assigned = 0; // Sent there and not in a report yet
+  };
+  std::map<std::pair<std::string, int>, Instance> instances;
+  sf::Time staleAfter;
+
+public:
+  explicit Broker(sf::Time staleAfter = sf::seconds(3))
+      : staleAfter(staleAfter) {}
+
+  void report(const LoadReport &report, sf::Time now);
+
+  // Load of a host from its fresh reports
+  float hostLoad(const std::string &host, sf::Time now) const;
+
+  // Server for the next client, nullopt when no open lobby has room
+  std::optional<std::pair<std::string, int>> assign(sf::Time now);
+};
+
+// Sends a report to the broker every interval from its own thread,
+// reconnecting when the broker goes away
+class LoadReporter {
+  std::string brokerHost;
+  int brokerPort;
+  std::function<LoadReport()> collect;
+  sf::Time interval;
+  std::atomic<bool> running = true;
+  std::thread thread;
+
+  void run();
+
+public:
+  // broker is host:port
+  LoadReporter(const std::string &broker, std::function<LoadReport()> collect,
+               sf::Time interval = sf::milliseconds(500));
+
+  ~LoadReporter();
+};
+
+} // namespace cycles_server
@@ -0,0 +1,144 @@
+// Sends the clients to the least loaded of the servers that report to it:
+//   broker <config_file>
+// Clients connect on CYCLES_PORT as they would to a server, servers started
+// with broker: <host>:<brokerReportPort> report their load every half second.
+// A client waits at the broker until a lobby has room for it.
+#include "broker.h"
+#include <SFML/Network.hpp>
+#include <deque>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+using namespace cycles_server;
+
+// Clients that do not send their name in time are dropped, so a stuck
+// connection does not hold a place in the queue
+const sf::Time joinDeadline = sf::seconds(10);
+
+struct WaitingClient {
+  std::unique_ptr<sf::TcpSocket> socket;
+  sf::Time connectedAt;
+  sf::Packet join; // Its name, forwarded by the client itself after the redirect
+  bool joined = false;
+  sf::Packet redirect; // Sent without blocking, a partial send goes on later
+  bool redirecting = false;
+};
+
+// Done once the whole redirect went out, NotReady while some is left
+sf::Socket::Status sendRedirect(WaitingClient &client) {
+  auto status = client.socket->send(client.redirect);
+  return status == sf::Socket::Partial ? sf::Socket::NotReady : status;
+}
+
+int main(int argc, char *argv[]) {
+  const Configuration conf(argc > 1 ? argv[1] : "config.yaml");
+  const char *portenv = std::getenv("CYCLES_PORT");
+  if (portenv == nullptr) {
+    spdlog::critical("Please set the CYCLES_PORT environment variable");
+    return 1;
+  }
+  sf::TcpListener clientListener;
+  sf::TcpListener reportListener;
+  if (clientListener.listen(std::stoi(portenv)) != sf::Socket::Done ||
+      reportListener.listen(conf.brokerReportPort) != sf::Socket::Done) {
+    spdlog::critical("Failed to bind to ports {} and {}", portenv,
+                     conf.brokerReportPort);
+    return 1;
+  }
+  spdlog::info("Clients on port {}, server reports on port {}", portenv,
+               conf.brokerReportPort);
+  sf::SocketSelector selector;
+  selector.add(clientListener);
+  selector.add(reportListener);
+  Broker broker;
+  sf::Clock clock;
+  std::vector<std::unique_ptr<sf::TcpSocket>> servers;
+  std::deque<WaitingClient> waiting;
+  while (true) {
+    selector.wait(sf::milliseconds(100));
+    auto now = clock.getElapsedTime();
+    if (selector.isReady(clientListener)) {
+      auto socket = std::make_unique<sf::TcpSocket>();
+      if (clientListener.accept(*socket) == sf::Socket::Done) {
+        socket->setBlocking(false);
+        selector.add(*socket);
+        WaitingClient client;
+        client.socket = std::move(socket);
+        client.connectedAt = now;
+        waiting.push_back(std::move(client));
+      }
+    }
+    if (selector.isReady(reportListener)) {
+      auto socket = std::make_unique<sf::TcpSocket>();
+      if (reportListener.accept(*socket) == sf::Socket::Done) {
+        socket->setBlocking(false);
+        selector.add(*socket);
+        servers.push_back(std::move(socket));
+      }
+    }
+    std::erase_if(servers, [&](auto &server) {
+      sf::Packet packet;
+      sf::Socket::Status status = sf::Socket::NotReady;
+      while (selector.isReady(*server) &&
+             (status = server->receive(packet)) == sf::Socket::Done) {
+        LoadReport report;
+        if (read(packet, report)) {
+          broker.report(report, now);
+        }
+      }
+      if (status == sf::Socket::Disconnected) {
+        selector.remove(*server);
+        return true;
+      }
+      return false;
+    });
+    // Clients that left while waiting or never joined are dropped before
+    // they get a server
+    std::erase_if(waiting, [&](auto &client) {
+      auto status = sf::Socket::NotReady;
+      if (selector.isReady(*client.socket)) {
+        sf::Packet packet;
+        status = client.socket->receive(packet);
+        if (status == sf::Socket::Done && !client.joined) {
+          client.join = packet;
+          client.joined = true;
+        }
+      }
+      if (status == sf::Socket::Disconnected || status == sf::Socket::Error ||
+          (!client.joined && now - client.connectedAt > joinDeadline)) {
+        selector.remove(*client.socket);
+        return true;
+      }
+      return false;
+    });
+    // First come, first served among the clients that joined
+    for (auto &client : waiting) {
+      if (!client.joined || client.redirecting) {
+        continue;
+      }
+      auto server = broker.assign(now);
+      if (!server) {
+        break;
+      }
+      std::string name;
+      client.join >> name;
+      spdlog::info("Sending {} to {}:{}", name, server->first,
+                   server->second);
+      writeRedirect(client.redirect, server->first, server->second);
+      client.redirecting = true;
+    }
+    // The redirects go out as the sockets take them
+    std::erase_if(waiting, [&](auto &client) {
+      if (!client.redirecting) {
+        return false;
+      }
+      auto status = sendRedirect(client);
+      if (status == sf::Socket::NotReady) {
+        return false;
+      }
+      selector.remove(*client.socket);
+      return true;
+    });
+  }
+}
@@ -0,0 +1,265 @@
+#include "checkpoint.h"
+#include "thread_placement.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <spdlog/spdlog.h>
+
+namespace cycles_server {
+
+namespace detail {
+
+constexpr sf::Uint32 checkpointMagic = 0x43594350; // "CYCP"
+constexpr sf::Uint32 checkpointVersion = 1;
+
+// Tail cells are one step from the previous one (the head for the first),
+// anything else is written in full after absoluteStep
+const sf::Vector2i tailSteps[] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+constexpr sf::Uint8 absoluteStep = 4;
+
+void writeGrid(sf::Packet &packet, const std::vector<sf::Uint8> &grid) {
+  packet << static_cast<sf::Uint32>(grid.size());
+  for (std::size_t i = 0; i < grid.size();) {
+    std::size_t run = 1;
+    while (i + run < grid.size() && grid[i + run] == grid[i] && run < 65535) {
+      run++;
+    }
+    packet << grid[i] << static_cast<sf::Uint16>(run);
+    i += run;
+  }
+}
+
+bool readGrid(sf::Packet &packet, std::vector<sf::Uint8> &grid) {
+  sf::Uint32 size = 0;
+  if (!(packet >> size)) {
+    return false;
+  }
+  grid.clear();
+  grid.reserve(size);
+  while (grid.size() < size) {
+    sf::Uint8 value;
+    sf::Uint16 run;
+    if (!(packet >> value >> run) || run == 0 || grid.size() + run > size) {
+      return false;
+    }
+    grid.insert(grid.end(), run, value);
+  }
+  return true;
+}
+
+// The generator state is a few hundred numbers, as words instead of text
+void writeRng(sf::Packet &packet, const std::string &rng) {
+  std::istringstream text(rng);
+  std::vector<sf::Uint32> words{std::istream_iterator<sf::Uint32>(text),
+                                std::istream_iterator<sf::Uint32>()};
+  packet << static_cast<sf::Uint32>(words.size());
+  for (auto word : words) {
+    packet << word;
+  }
+}
+
+bool readRng(sf::Packet &packet, std::string &rng) {
+  sf::Uint32 count = 0;
+  if (!(packet >> count)) {
+    return false;
+  }
+  std::ostringstream text;
+  for (sf::Uint32 i = 0; i < count; i++) {
+    sf::Uint32 word;
+    if (!(packet >> word)) {
+      return false;
+    }
+    text << (i > 0 ? " " : "") << word;
+  }
+  rng = text.str();
+  return true;
+}
+
+void writePlayer(sf::Packet &packet, const Player &player) {
+  packet << player.id << player.name << player.color.r << player.color.g
+         << player.color.b << player.position.x << player.position.y
+         << static_cast<sf::Uint32>(player.tail.size());
+  sf::Vector2i previous = player.position;
+  for (auto cell : player.tail) {
+    auto step = std::find(std::begin(tailSteps), std::end(tailSteps),
+                          cell - previous);
+    if (step != std::end(tailSteps)) {
+      packet << static_cast<sf::Uint8>(step - std::begin(tailSteps));
+    } else {
+      packet << absoluteStep << cell.x << cell.y;
+    }
+    previous = cell;
+  }
+}
+
+bool readPlayer(sf::Packet &packet, Player &player) {
+  sf::Uint32 tailSize = 0;
+  if (!(packet >> player.id >> player.name >> player.color.r >>
+        player.color.g >> player.color.b >> player.position.x >>
+        player.position.y >> tailSize)) {
+    return false;
+  }
+  player.tail.clear();
+  sf::Vector2i cell = player.position;
+  for (sf::Uint32 i = 0; i < tailSize; i++) {
+    sf::Uint8 step;
+    if (!(packet >> step) || step > absoluteStep) {
+      return false;
+    }
+    if (step == absoluteStep) {
+      packet >> cell.x >> cell.y;
+    } else {
+      cell += tailSteps[step];
+    }
+    player.tail.push_back(cell);
+  }
+  return static_cast<bool>(packet);
+}
+
+} // namespace detail
+
+void write(sf::Packet &packet, const Checkpoint &checkpoint) {
+  const auto &game = checkpoint.game;
+  packet << detail::checkpointMagic << detail::checkpointVersion << game.frame
+         << game.idCounter << game.gameStarted;
+  detail::writeRng(packet, game.rng);
+  packet << static_cast<sf::Uint32>(game.players.size());
+  for (const auto &[id, player] : game.players) {
+    detail::writePlayer(packet, player);
+  }
+  detail::writeGrid(packet, game.grid);
+  packet << static_cast<sf::Uint32>(checkpoint.sessions.size());
+  for (const auto &session : checkpoint.sessions) {
+    packet << session.id << session.name << session.token
+           << static_cast<sf::Int8>(session.lastDirection)
+           << session.missedFrames;
+  }
+  packet << static_cast<sf::Uint32>(checkpoint.standings.size());
+  for (const auto &[result, out] : checkpoint.standings) {
+    packet << result.id << result.name << result.place << result.lastFrame
+           << result.outcome << out;
+  }
+}
+
+bool read(sf::Packet &packet, Checkpoint &checkpoint) {
+  sf::Uint32 magic = 0, version = 0, count = 0;
+  auto &game = checkpoint.game;
+  if (!(packet >> magic >> version) || magic != detail::checkpointMagic ||
+      version != detail::checkpointVersion) {
+    return false;
+  }
+  if (!(packet >> game.frame >> game.idCounter >> game.gameStarted) ||
+      !detail::readRng(packet, game.rng) || !(packet >> count)) {
+    return false;
+  }
+  game.players.clear();
+  for (sf::Uint32 i = 0; i < count; i++) {
+    Player player;
+    if (!detail::readPlayer(packet, player)) {
+      return false;
+    }
+    game.players[player.id] = std::move(player);
+  }
+  if (!detail::readGrid(packet, game.grid) || !(packet >> count)) {
+    return false;
+  }
+  checkpoint.sessions.resize(count);
+  for (auto &session : checkpoint.sessions) {
+    sf::Int8 lastDirection = -1;
+    packet >> session.id >> session.name >> session.token >> lastDirection >>
+        session.missedFrames;
+    session.lastDirection = lastDirection;
+  }
+  if (!(packet >> count)) {
+    return false;
+  }
+  checkpoint.standings.resize(count);
+  for (auto &[result, out] : checkpoint.standings) {
+    packet >> result.id >> result.name >> result.place >> result.lastFrame >>
+        result.outcome >> out;
+  }
+  return static_cast<bool>(packet) && packet.endOfPacket();
+}
+
+bool writeCheckpoint(const std::string &path, const Checkpoint &checkpoint) {
+  sf::Packet packet;
+  write(packet, checkpoint);
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(static_cast<const char *>(packet.getData()),
+               packet.getDataSize());
+    if (!file.flush()) {
+      spdlog::error("Failed to write the checkpoint to {}", temporary);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    spdlog::error("Failed to move the checkpoint to {}: {}", path,
+                  error.message());
+    return false;
+  }
+  return true;
+}
+
+std::optional<Checkpoint> readCheckpoint(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    spdlog::error("Failed to open the checkpoint {}", path);
+    return std::nullopt;
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+  sf::Packet packet;
+  packet.append(data.data(), data.size());
+  Checkpoint checkpoint;
+  if (!read(packet, checkpoint)) {
+    spdlog::error("{} is not a checkpoint of this version", path);
+    return std::nullopt;
+  }
+  return checkpoint;
+}
+
+CheckpointWriter::CheckpointWriter(const Configuration &conf)
+    : conf(conf), thread(&CheckpointWriter::run, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::scoped_lock lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+void CheckpointWriter::submit(Checkpoint checkpoint) {
+  {
+    std::scoped_lock lock(mutex);
+    pending = std::move(checkpoint);
+  }
+  wake.notify_one();
+}
+
+void CheckpointWriter::run() {
+  placeThread("checkpoint", conf.backgroundCpus);
+  std::unique_lock lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return stopping || pending; });
+    if (!pending) {
+      return;
+    }
+    auto checkpoint = std::move(*pending);
+    pending.reset();
+    lock.unlock();
+    if (writeCheckpoint(conf.checkpointFile, checkpoint)) {
+      spdlog::debug("Checkpoint of frame {} written", checkpoint.game.frame);
+    }
+    lock.lock();
+  }
+}
+
+} // namespace cycles_server
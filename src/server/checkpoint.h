@@ -0,0 +1,62 @@
+#pragma once
+#include "game_logic.h"
+#include "match_result.h"
+#include <SFML/Network.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cycles_server {
+
+// What the server knows about a client beyond the game
+struct SessionCheckpoint {
+  Id id = 0;
+  std::string name;
+  sf::Uint64 token = 0;   // The client proves who it is with it on reconnect
+  int lastDirection = -1; // -1 before its first move
+  int missedFrames = 0;
+};
+
+// A running match as of the end of a frame
+struct Checkpoint {
+  GameCheckpoint game;
+  std::vector<SessionCheckpoint> sessions;
+  std::vector<MatchRecorder::Entry> standings;
+};
+
+// The grid is run-length encoded and the tails are steps from the head, a
+// checkpoint of a large board is mostly its empty cells in a few bytes
+void write(sf::Packet &packet, const Checkpoint &checkpoint);
+bool read(sf::Packet &packet, Checkpoint &checkpoint);
+
+// The file is written next to path and renamed over it, a crash while writing
+// leaves the previous checkpoint
+bool writeCheckpoint(const std::string &path, const Checkpoint &checkpoint);
+std::optional<Checkpoint> readCheckpoint(const std::string &path);
+
+// Writes the checkpoints from its own thread so the game loop only pays for
+// the copy. When the disk is slower than the checkpoints come, the newest
+// replaces the one still waiting.
+class CheckpointWriter {
+  const Configuration conf;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::optional<Checkpoint> pending;
+  bool stopping = false;
+  std::thread thread;
+
+  void run();
+
+public:
+  explicit CheckpointWriter(const Configuration &conf);
+
+  // Writes the pending checkpoint first
+  ~CheckpointWriter();
+
+  void submit(Checkpoint checkpoint);
+};
+
+} // namespace cycles_server
@@ -0,0 +1,55 @@
+#include "client_session.h"
+#include <algorithm>
+#include <random>
+
+namespace cycles_server {
+
+PlanStatus readPlan(sf::Packet &packet, int frame, int maxPlanLength,
+                    MovePlan &plan) {
+  MovePlan read;
+  sf::Uint32 count = 0;
+  if (!(packet >> read.firstFrame >> count) || count == 0) {
+    return PlanStatus::malformed;
+  }
+  count = std::min<sf::Uint32>(count, std::max(maxPlanLength, 1));
+  for (sf::Uint32 i = 0; i < count; i++) {
+    int direction;
+    if (!(packet >> direction) || direction < 0 || direction > 3) {
+      return PlanStatus::malformed;
+    }
+    read.directions.push_back(static_cast<Direction>(direction));
+  }
+  if (!read.covers(frame)) {
+    return PlanStatus::outdated;
+  }
+  // Drop the directions for frames that already passed
+  while (read.firstFrame < frame) {
+    read.directions.pop_front();
+    read.firstFrame++;
+  }
+  plan = std::move(read);
+  return PlanStatus::accepted;
+}
+
+sf::Uint64 newSessionToken() {
+  std::random_device device;
+  sf::Uint64 token = 0;
+  // 0 means no token
+  while (token == 0) {
+    token = (static_cast<sf::Uint64>(device()) << 32) | device();
+  }
+  return token;
+}
+
+void writeGameState(sf::Packet &packet, int width, int height,
+                    const std::map<Id, Player> &players, int frame) {
+  packet.clear();
+  packet << width << height;
+  packet << static_cast<sf::Uint32>(players.size());
+  for (const auto &[id, player] : players) {
+    packet << player.position.x << player.position.y << player.color.r
+           << player.color.g << player.color.b << player.name << id << frame;
+  }
+}
+
+} // namespace cycles_server
@@ -0,0 +1,66 @@
+#pragma once
+#include "server.h"
+#include <SFML/Network.hpp>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace cycles_server {
+
+// Directions submitted by a client, the first one applies to firstFrame and
+// the following ones to the next frames
+struct MovePlan {
+  int firstFrame = 0;
+  std::deque<Direction> directions;
+
+  bool covers(int frame) const {
+    return frame >= firstFrame &&
+           frame < firstFrame + static_cast<int>(directions.size());
+  }
+
+  Direction at(int frame) const { return directions[frame - firstFrame]; }
+};
+
+// What became of a submission read from a client
+enum class PlanStatus {
+  accepted,  // Covers the frame, the directions before it are dropped
+  malformed, // Not a plan, or a direction out of range
+  outdated   // Only for frames that passed, or starts after the frame
+};
+
+// Read a submission: the first frame, the count and the directions as ints.
+// Only the first maxPlanLength directions are kept.
+PlanStatus readPlan(sf::Packet &packet, int frame, int maxPlanLength,
+                    MovePlan &plan);
+
+// Where a client is within the current frame
+enum class SessionState {
+  pendingSend,  // The frame has not been sent yet
+  awaitingMove, // Waiting for the client's move
+  planned,      // Its plan covers the frame, not waited for
+  done          // Move received
+};
+
+// Everything the game loop needs to know about a connected client
+struct ClientSession {
+  Id id;
+  std::string name;
+  SessionState state = SessionState::pendingSend;
+  sf::Time sentAt;  // When this frame was sent
+  sf::Time latency; // Response time for the last answered frame
+  std::optional<Direction> lastDirection;
+  int missedFrames = 0;
+  MovePlan plan;
+  bool disconnected = false;
+  sf::Uint64 token = 0; // Lets the client take its session back after a restore
+};
+
+sf::Uint64 newSessionToken();
+
+// The frame as the clients read it (cycles::GameState), up to the grid: the
+// caller appends the cells, one byte each, row after row
+void writeGameState(sf::Packet &packet, int width, int height,
+                    const std::map<Id, Player> &players, int frame);
+
+} // namespace cycles_server
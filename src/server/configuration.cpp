@@ -1,6 +1,8 @@
 #include"server.h"
+#include <algorithm>
 #include <filesystem>
 #include <set>
+#include <utility>
 #include <spdlog/spdlog.h>
 #include <yaml-cpp/yaml.h>
 namespace cycles_server{
@@ -34,11 +36,133 @@ namespace cycles_server{
     if (config["enablePostProcessing"]) {
       enablePostProcessing = config["enablePostProcessing"].as<bool>();
     }
+    if (config["tickPeriod"]) {
+      tickPeriod = config["tickPeriod"].as<float>();
+    }
+    if (config["maxClientCommunicationTime"]) {
+      maxClientCommunicationTime = config["maxClientCommunicationTime"].as<int>();
+    }
+    if (config["adaptiveTickRate"]) {
+      adaptiveTickRate = config["adaptiveTickRate"].as<bool>();
+    }
+    if (config["minTickPeriod"]) {
+      minTickPeriod = config["minTickPeriod"].as<float>();
+    }
+    if (config["maxTickPeriod"]) {
+      maxTickPeriod = config["maxTickPeriod"].as<float>();
+    }
+    if (config["tickLatencyHeadroom"]) {
+      tickLatencyHeadroom = config["tickLatencyHeadroom"].as<float>();
+    }
+    if (config["maxMissedFrames"]) {
+      maxMissedFrames = config["maxMissedFrames"].as<int>();
+    }
+    if (config["maxPlanLength"]) {
+      maxPlanLength = config["maxPlanLength"].as<int>();
+    }
+    if (config["pipelineThreads"]) {
+      pipelineThreads = config["pipelineThreads"].as<int>();
+    }
+    if (config["logQueueSize"]) {
+      logQueueSize = config["logQueueSize"].as<int>();
+    }
+    if (config["ioUring"]) {
+      ioUring = config["ioUring"].as<bool>();
+    }
+    if (config["spectatorPort"]) {
+      spectatorPort = config["spectatorPort"].as<int>();
+    }
+    if (config["spectatorKeyframeInterval"]) {
+      spectatorKeyframeInterval = config["spectatorKeyframeInterval"].as<int>();
+    }
+    if (config["replayFile"]) {
+      replayFile = config["replayFile"].as<std::string>();
+    }
+    if (config["headless"]) {
+      headless = config["headless"].as<bool>();
+    }
+    if (config["joinTimeout"]) {
+      joinTimeout = config["joinTimeout"].as<float>();
+    }
+    if (config["resultFile"]) {
+      resultFile = config["resultFile"].as<std::string>();
+    }
+    if (config["latencyLog"]) {
+      latencyLog = config["latencyLog"].as<std::string>();
+    }
+    if (config["gameLoopCpus"]) {
+      gameLoopCpus = config["gameLoopCpus"].as<std::vector<int>>();
+    }
+    if (config["pipelineCpus"]) {
+      pipelineCpus = config["pipelineCpus"].as<std::vector<int>>();
+    }
+    if (config["rendererCpus"]) {
+      rendererCpus = config["rendererCpus"].as<std::vector<int>>();
+    }
+    if (config["backgroundCpus"]) {
+      backgroundCpus = config["backgroundCpus"].as<std::vector<int>>();
+    }
+    if (config["realtimePriority"]) {
+      realtimePriority = config["realtimePriority"].as<int>();
+    }
+    if (config["seed"]) {
+      seed = config["seed"].as<unsigned>();
+    }
+    if (config["moveThreads"]) {
+      moveThreads = config["moveThreads"].as<int>();
+    }
+    if (config["shards"]) {
+      shards = config["shards"].as<int>();
+    }
+    if (config["shardVertical"]) {
+      shardVertical = config["shardVertical"].as<bool>();
+    }
+    if (config["shardBasePort"]) {
+      shardBasePort = config["shardBasePort"].as<int>();
+    }
+    if (config["shardHost"]) {
+      shardHost = config["shardHost"].as<std::string>();
+    }
+    if (config["broker"]) {
+      broker = config["broker"].as<std::string>();
+    }
+    if (config["publicHost"]) {
+      publicHost = config["publicHost"].as<std::string>();
+    }
+    if (config["brokerReportPort"]) {
+      brokerReportPort = config["brokerReportPort"].as<int>();
+    }
+    if (config["checkpointFile"]) {
+      checkpointFile = config["checkpointFile"].as<std::string>();
+    }
+    if (config["checkpointInterval"]) {
+      checkpointInterval = std::max(1, config["checkpointInterval"].as<int>());
+    }
+    if (config["reconnectGrace"]) {
+      reconnectGrace = config["reconnectGrace"].as<float>();
+    }
 
     std::set<std::string> knownParameters = {"maxClients", "gridWidth",
                                              "gridHeight", "gameWidth",
                                              "gameHeight", "gameBannerHeight",
-					     "enablePostProcessing"};
+					     "enablePostProcessing", "tickPeriod",
+					     "maxClientCommunicationTime",
+					     "adaptiveTickRate", "minTickPeriod",
+					     "maxTickPeriod", "tickLatencyHeadroom",
+					     "maxMissedFrames", "maxPlanLength",
+					     "pipelineThreads", "logQueueSize",
+					     "ioUring", "spectatorPort",
+					     "spectatorKeyframeInterval", "replayFile",
+					     "headless", "joinTimeout",
+					     "resultFile", "latencyLog",
+					     "gameLoopCpus", "pipelineCpus",
+					     "rendererCpus", "backgroundCpus",
+					     "realtimePriority", "seed",
+					     "moveThreads", "shards",
+					     "shardVertical", "shardBasePort",
+					     "shardHost", "broker", "publicHost",
+					     "brokerReportPort", "checkpointFile",
+					     "checkpointInterval", "reconnectGrace"};
     // Warn if there are unknown parameters
     for (const auto &it : config) {
       if (knownParameters.find(it.first.as<std::string>()) ==
@@ -47,7 +171,18 @@ namespace cycles_server{
                      it.first.as<std::string>());
       }
     }
+    // Ids are handed out from 1 and never reused within a game
+    if (maxClients > cycles::maxPlayerId) {
+      spdlog::warn("maxClients is larger than {}, the largest player id, "
+                   "capping it",
+                   cycles::maxPlayerId);
+      maxClients = cycles::maxPlayerId;
+    }
     cellSize = gameWidth / float(gridWidth);
+    if (minTickPeriod > maxTickPeriod) {
+      spdlog::warn("minTickPeriod is larger than maxTickPeriod, swapping them");
+      std::swap(minTickPeriod, maxTickPeriod);
+    }
   }
 
 
@@ -0,0 +1,112 @@
+#pragma once
+#include "server.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace cycles_server {
+
+enum class DeathCause : sf::Uint8 {
+  wall,  // Moved out of the grid
+  trail, // Moved into an occupied cell
+  headOn // Moved to the same cell as another player
+};
+
+inline const char *deathCauseName(DeathCause cause) {
+  switch (cause) {
+  case DeathCause::wall:
+    return "wall";
+  case DeathCause::trail:
+    return "trail";
+  case DeathCause::headOn:
+    return "headOn";
+  }
+  return "unknown";
+}
+
+struct GameEvent {
+  enum class Type : sf::Uint8 {
+    playerDied,   // Killed by a move, followed by playerRemoved
+    playerRemoved // No longer in the game
+  };
+  Type type;
+  Id player;
+  DeathCause cause = DeathCause::wall; // Only for playerDied
+  Id other = 0; // Owner of the cell hit or the other player in a head-on
+  int frame;
+};
+
+// Lock free ring buffer for one producer and one consumer thread
+template <typename T, std::size_t Capacity> class SpscQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+  std::array<T, Capacity> buffer;
+  alignas(64) std::atomic<std::size_t> head = 0; // Next to pop
+  alignas(64) std::atomic<std::size_t> tail = 0; // Next to push
+
+public:
+  // Returns false if the queue is full
+  bool push(const T &value) {
+    auto t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    buffer[t % Capacity] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty
+  bool pop(T &value) {
+    auto h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = buffer[h % Capacity];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+// Events from the game to one consumer thread. Nothing is dropped: when the
+// ring is full the events go to a locked list, and keep going there until the
+// consumer has emptied it, so they are popped in order.
+class EventQueue {
+  SpscQueue<GameEvent, 1024> ring;
+  std::mutex overflowMutex;
+  std::deque<GameEvent> overflow;
+  std::atomic<bool> overflowing = false;
+
+public:
+  void push(const GameEvent &event) {
+    if (overflowing.load(std::memory_order_acquire) || !ring.push(event)) {
+      std::scoped_lock lock(overflowMutex);
+      overflow.push_back(event);
+      overflowing.store(true, std::memory_order_release);
+    }
+  }
+
+  // Returns false if the queue is empty
+  bool pop(GameEvent &event) {
+    if (ring.pop(event)) {
+      return true;
+    }
+    if (!overflowing.load(std::memory_order_acquire)) {
+      return false;
+    }
+    std::scoped_lock lock(overflowMutex);
+    if (overflow.empty()) {
+      return false;
+    }
+    event = overflow.front();
+    overflow.pop_front();
+    if (overflow.empty()) {
+      overflowing.store(false, std::memory_order_release);
+    }
+    return true;
+  }
+};
+
+} // namespace cycles_server
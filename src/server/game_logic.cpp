@@ -1,7 +1,9 @@
 #include "game_logic.h"
+#include "logging.h"
+#include <algorithm>
 #include <map>
 #include <random>
-#include <set>
+#include <sstream>
 #include <spdlog/spdlog.h>
 
 namespace cycles_server {
@@ -11,11 +13,9 @@ namespace detail {
 template <typename T>
 std::map<Id, T> removeNonExistentPlayers(std::map<Id, T> directions,
                                          const std::map<Id, Player> &players) {
-  for (auto [id, direction] : directions) {
-    if (players.find(id) == players.end()) {
-      directions.erase(id);
-    }
-  }
+  std::erase_if(directions, [&players](const auto &entry) {
+    return players.find(entry.first) == players.end();
+  });
   return directions;
 }
   std::tuple<int, int, int> hslToRgb(float h, float s, float l) {
@@ -71,19 +71,23 @@ sf::Color getRandomColor(auto rng) {
 
 } // namespace detail
 
-Id Game::addPlayer(const std::string &name) {
+sf::Color playerColor(Id id) {
   static std::vector<uint32_t> palette = detail::generateColorPalette(300);
+  return sf::Color(palette[id]);
+}
+
+Id Game::addPlayer(const std::string &name) {
   gameStarted = true;
   Player newPlayer;
   newPlayer.name = name;
-  newPlayer.color = sf::Color(palette[idCounter]);
+  newPlayer.color = playerColor(idCounter);
   newPlayer.id = idCounter;
   std::uniform_real_distribution<float> dist(0, 1.0);
   do {
     newPlayer.position.x = conf.gridWidth * dist(rng);
     newPlayer.position.y = conf.gridHeight * dist(rng);
   } while (getCell(newPlayer.position.x, newPlayer.position.y));
-  getCell(newPlayer.position.x, newPlayer.position.y) = newPlayer.id;
+  setCell(newPlayer.position, newPlayer.id);
   players[idCounter] = newPlayer;
   idCounter++;
   return idCounter - 1;
@@ -95,20 +99,78 @@ void Game::removePlayer(Id id) {
     return;
   }
   auto &player = player_it->second;
-  getCell(player.position.x, player.position.y) = 0;
+  setCell(player.position, 0);
   for (auto tail : player.tail) {
-    getCell(tail.x, tail.y) = 0;
+    setCell(tail, 0);
   }
   players.erase(id);
+  emit({.type = GameEvent::Type::playerRemoved, .player = id, .frame = frame});
+}
+
+GameCheckpoint Game::save() {
+  std::scoped_lock lock(gameMutex);
+  std::ostringstream rngState;
+  rngState << rng;
+  return {frame, idCounter, gameStarted, rngState.str(), players, getGrid()};
+}
+
+bool Game::restore(const GameCheckpoint &checkpoint) {
+  if (checkpoint.grid.size() !=
+      static_cast<std::size_t>(conf.gridWidth * conf.gridHeight)) {
+    return false;
+  }
+  std::istringstream rngState(checkpoint.rng);
+  rngState >> rng;
+  std::scoped_lock lock(gameMutex);
+  frame = checkpoint.frame;
+  idCounter = checkpoint.idCounter;
+  gameStarted = checkpoint.gameStarted;
+  players = checkpoint.players;
+  max_tail_length = 55 + frame / 100;
+  // Not a change of the game, so not in the journal
+  for (int y = 0; y < board.getHeight(); y++) {
+    for (int x = 0; x < board.getWidth(); x++) {
+      board.at({x, y}) = checkpoint.grid[y * board.getWidth() + x];
+    }
+  }
+  journal.clear();
+  journalComplete = false;
+  return true;
+}
+
+std::shared_ptr<EventQueue> Game::subscribe() {
+  eventQueues.push_back(std::make_shared<EventQueue>());
+  return eventQueues.back();
+}
+
+void Game::emit(const GameEvent &event) {
+  for (auto &queue : eventQueues) {
+    queue->push(event);
+  }
 }
 
 void Game::movePlayers(std::map<Id, Direction> directions) {
+  // A tick without moves still ends the journal
+  if (journalComplete) {
+    journal.clear();
+  }
+  journalComplete = false;
   if (directions.size() == 0) {
+    journalComplete = true;
     return;
   }
   max_tail_length = 55 + frame / 100;
   // Sanitize directions
   directions = detail::removeNonExistentPlayers(directions, players);
+  if (moveWorkers) {
+    parallelMovePlayers(directions);
+  } else {
+    serialMovePlayers(directions);
+  }
+  journalComplete = true;
+}
+
+void Game::serialMovePlayers(const std::map<Id, Direction> &directions) {
   std::map<Id, sf::Vector2i> newPositions;
   // Transform directions to positions
   for (const auto &[id, direction] : directions) {
@@ -118,7 +180,7 @@ void Game::movePlayers(std::map<Id, Direction> directions) {
     }
     const auto &player = it->second;
     const sf::Vector2i newPos = player.position + getDirectionVector(direction);
-    spdlog::debug(
+    CYCLES_HOT_DEBUG(
         "Game: Player {} trying to move to ({},{}) from ({},{}) in frame {}",
         player.name, newPos.x, newPos.y, player.position.x, player.position.y,
         frame);
@@ -126,7 +188,8 @@ void Game::movePlayers(std::map<Id, Direction> directions) {
   }
   // Check for collisions
   auto colliding = checkCollisions(newPositions);
-  for (auto id : colliding) {
+  for (const auto &[id, death] : colliding) {
+    emit(death);
     removePlayer(id);
     newPositions.erase(id);
   }
@@ -137,9 +200,9 @@ void Game::movePlayers(std::map<Id, Direction> directions) {
       continue;
     }
     auto &player = it->second;
-    getCell(newPos.x, newPos.y) = player.id;
+    setCell(newPos, player.id);
     if (player.tail.size() > max_tail_length) {
-      getCell(player.tail.back().x, player.tail.back().y) = 0;
+      setCell(player.tail.back(), 0);
       player.tail.pop_back();
     }
     player.tail.push_front(player.position);
@@ -147,44 +210,166 @@ void Game::movePlayers(std::map<Id, Direction> directions) {
   }
 }
 
-bool Game::legalMove(sf::Vector2i newPos) {
-  if (newPos.x < 0 || newPos.x >= conf.gridWidth || newPos.y < 0 ||
-      newPos.y >= conf.gridHeight) {
-    spdlog::debug("Game: Moved out of bounds");
-    return false;
+namespace detail {
+
+constexpr std::uint32_t noClaim = 0xFFFFFFFF;
+
+// Keep the two lowest ids of a claim, in the low and high 16 bits
+std::uint32_t addClaim(std::uint32_t claim, Id id) {
+  std::uint32_t first = claim & 0xFFFF;
+  std::uint32_t second = claim >> 16;
+  if (id < first) {
+    second = first;
+    first = id;
+  } else if (id < second) {
+    second = id;
   }
-  if (getCell(newPos.x, newPos.y) != 0) {
-    spdlog::debug("Game: Moved where player {} is",
-                  int(getCell(newPos.x, newPos.y)));
+  return second << 16 | first;
+}
+
+} // namespace detail
+
+void Game::parallelMovePlayers(const std::map<Id, Direction> &directions) {
+  moves.clear();
+  for (const auto &[id, direction] : directions) {
+    auto &player = players.at(id);
+    moves.push_back({id, &player, player.position + getDirectionVector(direction),
+                     0, std::nullopt});
+  }
+  if (moves.empty()) {
+    return;
+  }
+  std::size_t cells = (board.getWidth() + 2) * (board.getHeight() + 2);
+  if (claimCells != cells) {
+    claims = std::make_unique<std::atomic<std::uint32_t>[]>(cells);
+    for (std::size_t i = 0; i < cells; i++) {
+      claims[i].store(detail::noClaim, std::memory_order_relaxed);
+    }
+    claimCells = cells;
+  }
+  // Contiguous slices of moves, in id order, a few per thread to even out
+  const int parts =
+      std::min<int>(moveWorkers->size() * 4, static_cast<int>(moves.size()));
+  auto forEachMove = [&](auto &&f) {
+    moveWorkers->run(parts, [&](int part) {
+      std::size_t end = moves.size() * (part + 1) / parts;
+      for (std::size_t i = moves.size() * part / parts; i < end; i++) {
+        f(part, moves[i]);
+      }
+    });
+  };
+  // Claim the targets, a cell claimed twice is a head-on collision
+  forEachMove([&](int, Move &move) {
+    move.cell = board.index(move.target);
+    auto &claim = claims[move.cell];
+    std::uint32_t current = claim.load(std::memory_order_relaxed);
+    while (!claim.compare_exchange_weak(current,
+                                        detail::addClaim(current, move.id),
+                                        std::memory_order_relaxed)) {
+    }
+  });
+  // Head-on first, against the lowest other id, like checkCollisions
+  forEachMove([&](int, Move &move) {
+    std::uint32_t claim = claims[move.cell].load(std::memory_order_relaxed);
+    Id first = claim & 0xFFFF;
+    Id second = (claim >> 16) & 0xFFFF;
+    auto die = [&](DeathCause cause, Id other) {
+      move.death = GameEvent{.type = GameEvent::Type::playerDied,
+                             .player = move.id,
+                             .cause = cause,
+                             .other = other,
+                             .frame = frame};
+    };
+    if ((claim >> 16) != 0xFFFF) {
+      die(DeathCause::headOn, first == move.id ? second : first);
+    } else if (board[move.cell] != 0) {
+      if (board.isInside(move.target)) {
+        die(DeathCause::trail, board[move.cell]);
+      } else {
+        die(DeathCause::wall, 0);
+      }
+    }
+  });
+  // Deaths are rare, applied in id order they match the serial events
+  for (const auto &move : moves) {
+    if (move.death) {
+      emit(*move.death);
+      removePlayer(move.id);
+    }
+  }
+  // Survivors write their own target and tail cells only. The changes of
+  // each slice are concatenated in order afterwards.
+  partJournals.resize(parts);
+  forEachMove([&](int part, Move &move) {
+    claims[move.cell].store(detail::noClaim, std::memory_order_relaxed);
+    if (move.death) {
+      return;
+    }
+    auto &changes = partJournals[part];
+    auto unpadded = [this](sf::Vector2i position) {
+      return position.y * board.getWidth() + position.x;
+    };
+    auto &player = *move.player;
+    changes.push_back({unpadded(move.target), board[move.cell], move.id});
+    board[move.cell] = move.id;
+    if (player.tail.size() > max_tail_length) {
+      auto &end = board.at(player.tail.back());
+      changes.push_back({unpadded(player.tail.back()), end, 0});
+      end = 0;
+      player.tail.pop_back();
+    }
+    player.tail.push_front(player.position);
+    player.position = move.target;
+  });
+  for (int part = 0; part < parts; part++) {
+    journal.insert(journal.end(), partJournals[part].begin(),
+                   partJournals[part].end());
+    partJournals[part].clear();
+  }
+}
+
+// The border is occupied, so leaving the board is just another occupied cell
+bool Game::legalMove(sf::Vector2i newPos) const {
+  if (board.at(newPos) != 0) {
+    CYCLES_HOT_DEBUG("Game: Moved to occupied cell ({},{})", newPos.x,
+                     newPos.y);
     return false;
   }
   return true;
 }
 
-std::set<Id> Game::checkCollisions(std::map<Id, sf::Vector2i> newPositions) {
-  std::set<Id> colliding;
+std::map<Id, GameEvent>
+Game::checkCollisions(const std::map<Id, sf::Vector2i> &newPositions) {
+  std::map<Id, GameEvent> colliding;
+  // The first cause found for a player is kept
+  auto collide = [&](Id id, DeathCause cause, Id other) {
+    colliding.try_emplace(id, GameEvent{.type = GameEvent::Type::playerDied,
+                                        .player = id,
+                                        .cause = cause,
+                                        .other = other,
+                                        .frame = frame});
+  };
   // If two players are trying to go to the same position, remove both
   for (const auto &[id1, pos1] : newPositions) {
     for (const auto &[id2, pos2] : newPositions) {
       if (id1 < id2 && pos1 == pos2) {
-        spdlog::debug("Game: Players {} and {} collided", id1, id2);
-        colliding.insert(id1);
-        colliding.insert(id2);
+        CYCLES_HOT_DEBUG("Game: Players {} and {} collided", id1, id2);
+        collide(id1, DeathCause::headOn, id2);
+        collide(id2, DeathCause::headOn, id1);
       }
     }
   }
   // If a player is trying to go to a position where another player is, remove
   // the player
   for (const auto &[id, newPos] : newPositions) {
-    auto player = players[id];
-    spdlog::debug(
-        "Game: Player {} trying to move to ({},{}) from ({},{}) in frame {}",
-        player.name, newPos.x, newPos.y, player.position.x, player.position.y,
-        frame);
     if (!legalMove(newPos)) {
-      spdlog::debug("Game: Player {} tried to move to an illegal position",
-                    player.name);
-      colliding.insert(id);
+      CYCLES_HOT_DEBUG("Game: Player {} tried to move to an illegal position",
+                       players.at(id).name);
+      if (board.isInside(newPos)) {
+        collide(id, DeathCause::trail, board.at(newPos));
+      } else {
+        collide(id, DeathCause::wall, 0);
+      }
     }
   }
   return colliding;
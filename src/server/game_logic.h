@@ -1,13 +1,51 @@
 #pragma once
+#include "board.h"
+#include "game_events.h"
 #include "server.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <random>
-#include <set>
+#include <string>
 #include <vector>
 
 namespace cycles_server {
 
+// Copy of the game state at the end of a frame
+struct GameSnapshot {
+  int frame = 0;
+  std::map<Id, Player> players;
+  std::vector<sf::Uint8> grid;
+  bool gameOver = false;
+  // Response time of the players that answered the previous frame, filled
+  // by the server
+  std::map<Id, sf::Time> latencies;
+};
+
+// Everything a Game needs to resume where it was, see Game::save
+struct GameCheckpoint {
+  int frame = 0;
+  Id idCounter = 1;
+  bool gameStarted = false;
+  std::string rng; // State of the spawn generator, as written by operator<<
+  std::map<Id, Player> players;
+  std::vector<sf::Uint8> grid;
+};
+
+// A cell of the grid that changed, cell is its index in getGrid()
+struct CellChange {
+  int cell;
+  Id before;
+  Id after;
+};
+
+// Color of the player with this id
+sf::Color playerColor(Id id);
+
 // Game Logic
 class Game {
   const Configuration conf;
@@ -16,14 +54,35 @@ class Game {
   int frame = 0;
   bool gameStarted = false;
   std::map<Id, Player> players;
-  std::vector<sf::Uint8> grid;
+  PaddedGrid board;
   std::mt19937 rng;
   std::mutex gameMutex;
+  std::vector<std::shared_ptr<EventQueue>> eventQueues;
+  std::vector<CellChange> journal;
+  bool journalComplete = false; // The next change starts a new tick
+
+  // State of the parallel movePlayers, kept between ticks
+  struct Move {
+    Id id;
+    Player *player;
+    sf::Vector2i target;
+    int cell; // Index of target in the padded grid
+    std::optional<GameEvent> death;
+  };
+  std::unique_ptr<WorkerPool> moveWorkers;
+  std::vector<Move> moves;
+  // The two lowest ids moving to each padded cell this tick, 16 bits each
+  std::unique_ptr<std::atomic<std::uint32_t>[]> claims;
+  std::size_t claimCells = 0;
+  std::vector<std::vector<CellChange>> partJournals;
 
 public:
   Game(Configuration conf)
-      : conf(conf), grid(conf.gridWidth * conf.gridHeight, 0),
-        rng(std::random_device()()) {}
+      : conf(conf), board(conf.gridWidth, conf.gridHeight),
+        rng(conf.seed != 0 ? conf.seed : std::random_device()()),
+        moveWorkers(conf.moveThreads > 0
+                        ? std::make_unique<WorkerPool>(conf.moveThreads)
+                        : nullptr) {}
 
   Id addPlayer(const std::string &name);
 
@@ -31,26 +90,82 @@ public:
 
   void movePlayers(std::map<Id, Direction> directions);
 
-  const auto &getGrid() { return grid; }
+  // Row-major grid, gridWidth x gridHeight
+  std::vector<sf::Uint8> getGrid() const {
+    return board.unpadded();
+  }
+
+  // Cells changed by the last tick, in the order they changed: from the end
+  // of the previous movePlayers to the end of the last one, so players added
+  // or removed in between are included. A cell can appear more than once.
+  // Applying the changes to the previous grid gives the current one. Like
+  // the grid, read it before the game changes again.
+  const std::vector<CellChange> &getJournal() const { return journal; }
+
+  // Call f(row, width) for each row of the grid, without copying it
+  template <typename F> void forEachGridRow(F &&f) const {
+    board.forEachRow(f);
+  }
 
   auto getPlayers() {
     std::scoped_lock lock(gameMutex);
     return players;
   }
 
+  GameSnapshot getSnapshot() {
+    std::scoped_lock lock(gameMutex);
+    return {frame, players, getGrid(), isGameOver(), {}};
+  }
+
+  // Copy of the state, cheap enough to take between two ticks
+  GameCheckpoint save();
+
+  // Replace the state with a saved one. False, leaving the game as it was,
+  // when the grid size differs from the configuration.
+  bool restore(const GameCheckpoint &checkpoint);
+
   void setFrame(int frame) { this->frame = frame; }
 
   int getFrame() { return frame; }
 
   bool isGameOver() { return gameStarted && players.size() <= 1; }
 
+  // Get a queue that receives every event from now on. Each queue must have
+  // a single consumer. Subscribe before the game loop starts.
+  std::shared_ptr<EventQueue> subscribe();
+
 private:
 
-  Id &getCell(int x, int y) { return grid[y * conf.gridWidth + x]; }
+  Id getCell(int x, int y) const {
+    return board.at({x, y});
+  }
+
+  // Every write to the grid goes through here to keep the journal
+  void setCell(sf::Vector2i position, Id id) {
+    if (journalComplete) {
+      journal.clear();
+      journalComplete = false;
+    }
+    auto &cell = board.at(position);
+    journal.push_back({position.y * board.getWidth() + position.x, cell, id});
+    cell = id;
+  }
+
+  void serialMovePlayers(const std::map<Id, Direction> &directions);
+
+  // Same rules as movePlayers, split between moveWorkers: targets and
+  // head-on claims, then collisions, then the moves and tail trims. Deaths
+  // are applied in between on the calling thread, so the grid, the events
+  // and the journal come out identical to the serial path.
+  void parallelMovePlayers(const std::map<Id, Direction> &directions);
+
+  bool legalMove(sf::Vector2i newPos) const;
 
-  bool legalMove(sf::Vector2i newPos);
+  // The playerDied events of the players that would crash
+  std::map<Id, GameEvent>
+  checkCollisions(const std::map<Id, sf::Vector2i> &newPositions);
 
-  std::set<Id> checkCollisions(std::map<Id, sf::Vector2i> newPositions);
+  void emit(const GameEvent &event);
 
 };
 
@@ -0,0 +1,28 @@
+#include "logging.h"
+#include "thread_placement.h"
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+namespace cycles_server {
+
+void setupAsyncLogging(const Configuration &conf) {
+  // The logger is not ready yet, the log thread is pinned without a message
+  spdlog::init_thread_pool(conf.logQueueSize, 1, [cpus = conf.backgroundCpus] {
+    if (!cpus.empty()) {
+      pinThread(cpus);
+    }
+  });
+  auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+  auto logger = std::make_shared<spdlog::async_logger>(
+      "cycles", sink, spdlog::thread_pool(),
+      spdlog::async_overflow_policy::overrun_oldest);
+  logger->set_level(spdlog::get_level());
+  spdlog::set_default_logger(logger);
+}
+
+std::size_t getDroppedLogMessages() {
+  auto pool = spdlog::thread_pool();
+  return pool ? pool->overrun_counter() : 0;
+}
+
+} // namespace cycles_server
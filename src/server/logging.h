@@ -0,0 +1,37 @@
+#pragma once
+#include "server.h"
+#include <spdlog/spdlog.h>
+
+// Logging on the tick hot path (per player, per frame).
+//
+// These macros are compiled out unless the build defines
+// CYCLES_HOT_PATH_LOGGING (cmake -DCYCLES_HOT_PATH_LOGGING=ON), so their
+// arguments are never evaluated in normal builds, Debug included. When
+// compiled in, the arguments are only evaluated if the level is enabled.
+#ifdef CYCLES_HOT_PATH_LOGGING
+#define CYCLES_HOT_LOG(level, ...)                                             \
+  do {                                                                         \
+    if (spdlog::should_log(level)) {                                           \
+      spdlog::log(level, __VA_ARGS__);                                         \
+    }                                                                          \
+  } while (0)
+#else
+#define CYCLES_HOT_LOG(level, ...)                                             \
+  do {                                                                         \
+  } while (0)
+#endif
+
+#define CYCLES_HOT_TRACE(...) CYCLES_HOT_LOG(spdlog::level::trace, __VA_ARGS__)
+#define CYCLES_HOT_DEBUG(...) CYCLES_HOT_LOG(spdlog::level::debug, __VA_ARGS__)
+
+namespace cycles_server {
+
+// Route the default logger through a background thread with a bounded queue.
+// When the queue is full the oldest message is dropped, logging never waits
+// for the sink.
+void setupAsyncLogging(const Configuration &conf);
+
+// Messages dropped because the queue was full
+std::size_t getDroppedLogMessages();
+
+} // namespace cycles_server
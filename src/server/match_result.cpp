@@ -0,0 +1,121 @@
+#include "match_result.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <ranges>
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+namespace cycles_server {
+
+void MatchRecorder::addPlayers(const std::map<Id, Player> &gamePlayers) {
+  for (const auto &[id, player] : gamePlayers) {
+    players[id] = {id, player.name, 0, 0, ""};
+    out[id] = false;
+  }
+}
+
+void MatchRecorder::record(const GameEvent &event) {
+  auto it = players.find(event.player);
+  if (it == players.end() || out[event.player]) {
+    return;
+  }
+  auto &player = it->second;
+  player.lastFrame = event.frame;
+  if (event.type == GameEvent::Type::playerDied) {
+    player.outcome = deathCauseName(event.cause);
+  } else {
+    if (player.outcome.empty()) {
+      player.outcome = "removed";
+    }
+    out[event.player] = true;
+  }
+}
+
+std::vector<MatchRecorder::Entry> MatchRecorder::save() const {
+  std::vector<Entry> entries;
+  for (const auto &[id, player] : players) {
+    entries.push_back({player, out.at(id)});
+  }
+  return entries;
+}
+
+void MatchRecorder::restore(const std::vector<Entry> &entries) {
+  players.clear();
+  out.clear();
+  for (const auto &entry : entries) {
+    players[entry.result.id] = entry.result;
+    out[entry.result.id] = entry.out;
+  }
+}
+
+MatchResult MatchRecorder::finish(int frames) const {
+  MatchResult result;
+  result.frames = frames;
+  for (auto player : players | std::views::values) {
+    if (!out.at(player.id)) {
+      player.outcome = "survived";
+      player.lastFrame = frames;
+    }
+    result.players.push_back(player);
+  }
+  // The longer a player lasted the better, survivors last the longest
+  auto lasted = [](const PlayerResult &player) {
+    return player.outcome == "survived" ? std::numeric_limits<int>::max()
+                                        : player.lastFrame;
+  };
+  std::stable_sort(result.players.begin(), result.players.end(),
+                   [&lasted](const auto &a, const auto &b) {
+                     return lasted(a) > lasted(b);
+                   });
+  for (std::size_t i = 0; i < result.players.size(); i++) {
+    bool tied = i > 0 && lasted(result.players[i]) ==
+                             lasted(result.players[i - 1]);
+    result.players[i].place =
+        tied ? result.players[i - 1].place : static_cast<int>(i) + 1;
+  }
+  return result;
+}
+
+bool writeMatchResult(const std::string &path, const MatchResult &result) {
+  YAML::Emitter out;
+  out << YAML::BeginMap << YAML::Key << "frames" << YAML::Value
+      << result.frames << YAML::Key << "players" << YAML::Value
+      << YAML::BeginSeq;
+  for (const auto &player : result.players) {
+    out << YAML::BeginMap << YAML::Key << "name" << YAML::Value << player.name
+        << YAML::Key << "id" << YAML::Value << static_cast<int>(player.id)
+        << YAML::Key << "place" << YAML::Value << player.place << YAML::Key
+        << "lastFrame" << YAML::Value << player.lastFrame << YAML::Key
+        << "outcome" << YAML::Value << player.outcome << YAML::EndMap;
+  }
+  out << YAML::EndSeq << YAML::EndMap;
+  std::ofstream file(path);
+  file << out.c_str() << "\n";
+  if (!file) {
+    spdlog::error("Failed to write the match result to {}", path);
+    return false;
+  }
+  return true;
+}
+
+bool readMatchResult(const std::string &path, MatchResult &result) {
+  try {
+    YAML::Node node = YAML::LoadFile(path);
+    result.frames = node["frames"].as<int>();
+    result.players.clear();
+    for (const auto &player : node["players"]) {
+      result.players.push_back({static_cast<Id>(player["id"].as<int>()),
+                                player["name"].as<std::string>(),
+                                player["place"].as<int>(),
+                                player["lastFrame"].as<int>(),
+                                player["outcome"].as<std::string>()});
+    }
+  } catch (const YAML::Exception &e) {
+    spdlog::error("Failed to read the match result {}: {}", path, e.what());
+    return false;
+  }
+  return true;
+}
+
+} // namespace cycles_server
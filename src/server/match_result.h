@@ -0,0 +1,50 @@
+#pragma once
+#include "game_events.h"
+#include "server.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// Final standing of a player in a match
+struct PlayerResult {
+  Id id = 0;
+  std::string name;
+  int place = 0;       // 1 for the winner, players out on the same frame tie
+  int lastFrame = 0;   // Last frame it was in the game
+  std::string outcome; // survived, removed or the cause of its death
+};
+
+struct MatchResult {
+  int frames = 0;
+  std::vector<PlayerResult> players; // Best place first
+};
+
+// Builds the result of a match from the events of the game
+class MatchRecorder {
+  std::map<Id, PlayerResult> players;
+  std::map<Id, bool> out;
+
+public:
+  void addPlayers(const std::map<Id, Player> &gamePlayers);
+
+  void record(const GameEvent &event);
+
+  // Standings so far, for checkpoints
+  struct Entry {
+    PlayerResult result;
+    bool out = false;
+  };
+  std::vector<Entry> save() const;
+  void restore(const std::vector<Entry> &entries);
+
+  // Players still in the game after the last frame survived
+  MatchResult finish(int frames) const;
+};
+
+// The result is a small YAML file so scripts can read it too
+bool writeMatchResult(const std::string &path, const MatchResult &result);
+bool readMatchResult(const std::string &path, MatchResult &result);
+
+} // namespace cycles_server
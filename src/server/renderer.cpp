@@ -76,7 +76,7 @@ GameRenderer::GameRenderer(Configuration conf)
   }
 }
 
-void GameRenderer::render(std::shared_ptr<Game> game) {
+void GameRenderer::render(const GameSnapshot &game) {
   window.clear(sf::Color::Black);
   // // Draw grid
   // sf::RectangleShape cell(sf::Vector2f(conf.cellSize - 1, conf.cellSize -
@@ -87,8 +87,9 @@ void GameRenderer::render(std::shared_ptr<Game> game) {
   // 	window.draw(cell);
   //   }
   // }
+  readEvents(game);
   renderPlayers(game);
-  if (game->isGameOver()) {
+  if (game.gameOver) {
     renderGameOver(game);
   }
   renderBanner(game);
@@ -112,7 +113,45 @@ void GameRenderer::handleEvents(
   }
 }
 
-void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
+void GameRenderer::readEvents(const GameSnapshot &game) {
+  for (const auto &[id, player] : game.players) {
+    names[id] = player.name;
+  }
+  if (!events) {
+    return;
+  }
+  GameEvent event;
+  while (events->pop(event)) {
+    if (event.type != GameEvent::Type::playerDied) {
+      continue;
+    }
+    const auto &name = names[event.player];
+    switch (event.cause) {
+    case DeathCause::wall:
+      killFeed.push_back(name + " hit the wall");
+      break;
+    case DeathCause::trail:
+      if (event.other == event.player) {
+        killFeed.push_back(name + " crashed into its own trail");
+      } else {
+        kills[event.other]++;
+        killFeed.push_back(name + " crashed into " + names[event.other]);
+      }
+      break;
+    case DeathCause::headOn:
+      // Both players get an event, report the collision once
+      if (event.player < event.other) {
+        killFeed.push_back(name + " and " + names[event.other] + " collided");
+      }
+      break;
+    }
+  }
+  while (killFeed.size() > 3) {
+    killFeed.pop_front();
+  }
+}
+
+void GameRenderer::renderPlayers(const GameSnapshot &game) {
   const int offset_y = conf.gameBannerHeight + 0;
   const int offset_x = 0;
   auto cellSize = conf.cellSize;
@@ -122,7 +161,7 @@ void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
   bkg.setFillColor(sf::Color::Black);
   renderTexture.draw(bkg);
 
-  for (const auto &[id, player] : game->getPlayers()) {
+  for (const auto &[id, player] : game.players) {
     sf::CircleShape playerShape(cellSize);
     // Make the head of the player darker
     auto darkerColor = player.color;
@@ -157,8 +196,12 @@ void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
     postProcess->apply(window, renderTexture);
   else
     window.draw(sf::Sprite(renderTexture.getTexture()));
-  for (const auto &[id, player] : game->getPlayers()) {
-    sf::Text nameText(player.name, font, 30);
+  for (const auto &[id, player] : game.players) {
+    auto label = player.name;
+    if (kills[id] > 0) {
+      label += " (" + std::to_string(kills[id]) + ")";
+    }
+    sf::Text nameText(label, font, 30);
     nameText.setFillColor(sf::Color::White);
     nameText.setOutlineThickness(2);
     nameText.setOutlineColor(sf::Color::Black);
@@ -168,14 +211,14 @@ void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
   }
 }
 
-void GameRenderer::renderGameOver(std::shared_ptr<Game> game) {
+void GameRenderer::renderGameOver(const GameSnapshot &game) {
   sf::Text gameOverText("Game Over", font, 60);
   gameOverText.setOutlineThickness(3);
   gameOverText.setOutlineColor(sf::Color::White);
   gameOverText.setFillColor(sf::Color::Black);
   gameOverText.setPosition(conf.gameWidth / 2 - 150, conf.gameHeight / 2 - 30);
-  if (game->getPlayers().size() > 0) {
-    auto winner = game->getPlayers().begin()->second.name;
+  if (game.players.size() > 0) {
+    auto winner = game.players.begin()->second.name;
     sf::Text winnerText("Winner: " + winner, font, 40);
     winnerText.setFillColor(sf::Color::Black);
     winnerText.setOutlineThickness(3);
@@ -186,7 +229,7 @@ void GameRenderer::renderGameOver(std::shared_ptr<Game> game) {
   window.draw(gameOverText);
 }
 
-void GameRenderer::renderBanner(std::shared_ptr<Game> game) {
+void GameRenderer::renderBanner(const GameSnapshot &game) {
   // Draw a banner at the top
   sf::RectangleShape banner(
       sf::Vector2f(conf.gameWidth, conf.gameBannerHeight - 20));
@@ -194,19 +237,26 @@ void GameRenderer::renderBanner(std::shared_ptr<Game> game) {
   banner.setPosition(0, 0);
   window.draw(banner);
   // Draw the frame number
-  sf::Text frameText("Frame: " + std::to_string(game->getFrame()), font, 22);
+  sf::Text frameText("Frame: " + std::to_string(game.frame), font, 22);
   frameText.setPosition(10, 10);
   frameText.setFillColor(sf::Color::White);
   window.draw(frameText);
   // Draw the number of players
-  sf::Text playersText("Players: " + std::to_string(game->getPlayers().size()),
+  sf::Text playersText("Players: " + std::to_string(game.players.size()),
                        font, 22);
   playersText.setPosition(10, 40);
   playersText.setFillColor(sf::Color::White);
   window.draw(playersText);
+  // Draw the latest deaths
+  for (std::size_t i = 0; i < killFeed.size(); ++i) {
+    sf::Text deathText(killFeed[i], font, 16);
+    deathText.setPosition(conf.gameWidth / 2, 10 + 22 * i);
+    deathText.setFillColor(sf::Color::White);
+    window.draw(deathText);
+  }
 }
 
-void GameRenderer::renderSplashScreen(std::shared_ptr<Game> game) {
+void GameRenderer::renderSplashScreen(const GameSnapshot &game) {
   window.clear(sf::Color::Black);
   renderPlayers(game);
   renderBanner(game);
@@ -2,7 +2,9 @@
 #include"server.h"
 #include "game_logic.h"
 #include <SFML/Graphics.hpp>
+#include <deque>
 #include <functional>
+#include <map>
 
 
 namespace cycles_server{
@@ -24,23 +26,32 @@ class GameRenderer {
   sf::RenderTexture renderTexture;
   const Configuration conf;
   std::unique_ptr<PostProcess> postProcess;
+  std::shared_ptr<EventQueue> events;
+  std::map<Id, std::string> names; // Also of the players that already died
+  std::map<Id, int> kills;
+  std::deque<std::string> killFeed;
 
 public:
   GameRenderer(Configuration conf);
 
-  void render(std::shared_ptr<Game> game);
+  void render(const GameSnapshot &game);
 
   bool isOpen() const { return window.isOpen(); }
 
+  // Show the deaths reported in this queue
+  void setEventQueue(std::shared_ptr<EventQueue> queue) { events = queue; }
+
   void handleEvents(std::vector<std::function<void(sf::Event &)>> extraEventHandlers = {});
 
-  void renderSplashScreen(std::shared_ptr<Game> game);
+  void renderSplashScreen(const GameSnapshot &game);
 
 private:
-  void renderPlayers(std::shared_ptr<Game> game);
+  void readEvents(const GameSnapshot &game);
+
+  void renderPlayers(const GameSnapshot &game);
 
-  void renderGameOver(std::shared_ptr<Game> game);
+  void renderGameOver(const GameSnapshot &game);
 
-  void renderBanner(std::shared_ptr<Game> game);
+  void renderBanner(const GameSnapshot &game);
 };
 }
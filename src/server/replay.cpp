@@ -0,0 +1,182 @@
+#include "replay.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cycles_server {
+
+namespace detail {
+
+std::uint32_t readBigEndian(const char *bytes) {
+  auto byte = [bytes](int i) {
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[i]));
+  };
+  return (byte(0) << 24) | (byte(1) << 16) | (byte(2) << 8) | byte(3);
+}
+
+} // namespace detail
+
+ReplayFile::~ReplayFile() {
+#ifndef _WIN32
+  if (mapping != nullptr) {
+    munmap(mapping, length);
+  }
+#endif
+}
+
+bool ReplayFile::open(const std::string &path) {
+#ifndef _WIN32
+  // A file opened before is unmapped first
+  if (mapping != nullptr) {
+    munmap(mapping, length);
+    mapping = nullptr;
+  }
+#endif
+  entries.clear();
+  data = nullptr;
+  length = 0;
+#ifdef _WIN32
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  buffer.assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  data = buffer.data();
+  length = buffer.size();
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return false;
+  }
+  length = info.st_size;
+  if (length > 0) {
+    mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    return false;
+  }
+  data = static_cast<const char *>(mapping);
+  // Played mostly front to back
+  if (mapping != nullptr) {
+    madvise(mapping, length, MADV_SEQUENTIAL);
+  }
+#endif
+  int version = length >= replayHeaderSize ? readReplayVersion(data) : -1;
+  if (version != replayVersion) {
+    if (version < 0) {
+      spdlog::error("{} is not a replay", path);
+    } else {
+      spdlog::error("{} is a version {} replay, only version {} can be read",
+                    path, version, replayVersion);
+    }
+    return false;
+  }
+  index();
+  return true;
+}
+
+void ReplayFile::index() {
+  // Every message starts with its size, its kind and its frame
+  constexpr std::size_t header = 4;
+  constexpr std::size_t messageHeader = 1 + 4;
+  std::size_t offset = replayHeaderSize;
+  while (offset + header <= length) {
+    std::size_t size = detail::readBigEndian(data + offset);
+    if (offset + header + size > length || size < messageHeader) {
+      spdlog::warn("Replay truncated after {} messages", entries.size());
+      break;
+    }
+    const char *message = data + offset + header;
+    Entry entry;
+    entry.offset = offset + header;
+    entry.size = size;
+    entry.keyframe =
+        message[0] == static_cast<char>(StreamMessage::keyframe);
+    entry.frame = static_cast<int>(detail::readBigEndian(message + 1));
+    entries.push_back(entry);
+    offset += header + size;
+  }
+}
+
+int ReplayFile::keyframeBefore(int message) const {
+  for (int i = std::min(message, size() - 1); i >= 0; i--) {
+    if (entries[i].keyframe) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int ReplayFile::messageAt(int frame) const {
+  // Frames only go up along the replay
+  auto it = std::upper_bound(
+      entries.begin(), entries.end(), frame,
+      [](int value, const Entry &entry) { return value < entry.frame; });
+  return static_cast<int>(it - entries.begin()) - 1;
+}
+
+void ReplayFile::read(int message, sf::Packet &packet) const {
+  const auto &entry = entries[message];
+  packet.clear();
+  packet.append(data + entry.offset, entry.size);
+}
+
+void ReplayPlayer::seek(int message) {
+  if (file.size() == 0) {
+    return;
+  }
+  message = std::clamp(message, 0, file.size() - 1);
+  if (message == position) {
+    return;
+  }
+  int start = position + 1;
+  bool forward = message > position;
+  int keyframe = file.keyframeBefore(message);
+  // Nothing can be shown before the first keyframe
+  if (keyframe < 0) {
+    return;
+  }
+  // Going back, or a keyframe is closer than the current position
+  if (!forward || keyframe > position) {
+    start = keyframe;
+  }
+  sf::Packet packet;
+  std::vector<GameEvent> skipped;
+  for (int i = start; i <= message; i++) {
+    file.read(i, packet);
+    // Jumps only show the state, the events are for playback
+    decoder.apply(packet, start == position + 1 ? events : skipped);
+  }
+  position = message;
+}
+
+void ReplayPlayer::stepFrames(int frames) {
+  if (frames == 0) {
+    return;
+  }
+  int message = file.messageAt(getFrame() + frames);
+  if (frames > 0) {
+    message = std::max(message, position + 1);
+  } else {
+    message = std::min(message, position - 1);
+  }
+  seek(message);
+}
+
+} // namespace cycles_server
@@ -0,0 +1,93 @@
+#pragma once
+#include "spectator_stream.h"
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// A recorded spectator stream mapped in memory and indexed once when opened
+class ReplayFile {
+  struct Entry {
+    std::size_t offset; // Of the message data, after the size
+    std::size_t size;
+    int frame;
+    bool keyframe;
+  };
+
+  const char *data = nullptr;
+  std::size_t length = 0;
+#ifdef _WIN32
+  std::vector<char> buffer;
+#else
+  void *mapping = nullptr;
+#endif
+  std::vector<Entry> entries;
+
+  void index();
+
+public:
+  ReplayFile() = default;
+  ReplayFile(const ReplayFile &) = delete;
+  ReplayFile &operator=(const ReplayFile &) = delete;
+  ~ReplayFile();
+
+  // False if the file can not be read or is not a replay of this version
+  bool open(const std::string &path);
+
+  // Number of messages
+  int size() const { return static_cast<int>(entries.size()); }
+
+  int getFrame(int message) const { return entries[message].frame; }
+
+  // Index of the last message at or before a frame, -1 if there is none.
+  // Frames the broadcaster dropped have no message of their own.
+  int messageAt(int frame) const;
+
+  // Index of the last keyframe at or before a message, -1 if there is none
+  int keyframeBefore(int message) const;
+
+  void read(int message, sf::Packet &packet) const;
+};
+
+// Moves through a replay in any direction. Going forward applies the deltas,
+// going back restarts from the closest keyframe.
+class ReplayPlayer {
+  const ReplayFile &file;
+  StreamDecoder decoder;
+  int position = -1; // Last message applied
+  std::vector<GameEvent> events;
+
+public:
+  explicit ReplayPlayer(const ReplayFile &file) : file(file) {}
+
+  // Show the game as of a message, clamped to the replay. Messages before
+  // the first keyframe are ignored.
+  void seek(int message);
+
+  void step(int messages) { seek(position + messages); }
+
+  // Show the game as of a frame, the last message at or before it
+  void seekFrame(int frame) { seek(file.messageAt(frame)); }
+
+  // Move by a number of frames. A step that is not 0 always moves at least
+  // one message, so stepping crosses the frames missing from the replay.
+  void stepFrames(int frames);
+
+  int getPosition() const { return position; }
+
+  // Frame shown, -1 before the first message
+  int getFrame() const {
+    return position >= 0 ? file.getFrame(position) : -1;
+  }
+
+  bool atEnd() const { return position >= file.size() - 1; }
+
+  const GameSnapshot &getSnapshot() const { return decoder.getSnapshot(); }
+
+  const StreamDecoder &getDecoder() const { return decoder; }
+
+  // Events of the messages played forward since the last call
+  std::vector<GameEvent> takeEvents() { return std::move(events); }
+};
+
+} // namespace cycles_server
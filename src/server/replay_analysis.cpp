@@ -0,0 +1,69 @@
+#include "replay_analysis.h"
+
+namespace cycles_server {
+
+bool analyzeReplay(const ReplayFile &file, const AnalysisOptions &options,
+                   MatchStats &stats) {
+  StreamDecoder decoder;
+  std::vector<GameEvent> events;
+  auto statsOf = [&stats](Id id) -> PlayerStats & {
+    auto &playerStats = stats.players[id];
+    playerStats.id = id;
+    return playerStats;
+  };
+  sf::Packet packet;
+  for (int i = 0; i < file.size(); i++) {
+    file.read(i, packet);
+    events.clear();
+    if (!decoder.apply(packet, events)) {
+      continue;
+    }
+    const auto &game = decoder.getSnapshot();
+    stats.frames++;
+    bool sample = options.territoryInterval > 0 &&
+                  game.frame % options.territoryInterval == 0;
+    for (const auto &[id, player] : game.players) {
+      auto [it, added] = stats.players.try_emplace(id);
+      auto &playerStats = it->second;
+      if (added) {
+        playerStats.id = id;
+        playerStats.name = player.name;
+        playerStats.firstFrame = game.frame;
+      }
+      playerStats.lastFrame = game.frame;
+      // Every cell of a player is its head or its tail
+      playerStats.territory = static_cast<int>(player.tail.size()) + 1;
+      if (sample) {
+        stats.territory.push_back({game.frame, id, playerStats.territory});
+      }
+    }
+    if (options.latency) {
+      for (const auto &[id, latency] : game.latencies) {
+        auto it = stats.players.find(id);
+        if (it != stats.players.end()) {
+          it->second.latencies.push_back(latency.asMicroseconds() / 1000.f);
+        }
+      }
+    }
+    for (const auto &event : events) {
+      if (event.type != GameEvent::Type::playerDied) {
+        continue;
+      }
+      auto &victim = statsOf(event.player);
+      victim.cause = event.cause;
+      if (event.cause == DeathCause::trail && event.other != event.player) {
+        victim.killer = event.other;
+        statsOf(event.other).kills++;
+      }
+    }
+  }
+  if (!decoder.hasKeyframe()) {
+    return false;
+  }
+  for (const auto &[id, player] : decoder.getSnapshot().players) {
+    statsOf(id).survived = true;
+  }
+  return true;
+}
+
+} // namespace cycles_server
@@ -0,0 +1,47 @@
+#pragma once
+#include "replay.h"
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// What happened to a player during a match
+struct PlayerStats {
+  Id id = 0;
+  std::string name;
+  int firstFrame = 0; // First and last frames it was seen in the game
+  int lastFrame = 0;
+  std::optional<DeathCause> cause; // Empty if it was not killed by a move
+  bool survived = false;           // Still in the game when the replay ends
+  Id killer = 0;                   // Owner of the trail it crashed into
+  int kills = 0;                   // Players that crashed into its trail
+  std::vector<float> latencies;    // Response times (ms) of the frames it answered
+  int territory = 0;               // Cells it held the last frame it was seen
+};
+
+// Cells held by a player at a frame
+struct TerritorySample {
+  int frame;
+  Id player;
+  int cells;
+};
+
+struct MatchStats {
+  int frames = 0; // Frames in the replay
+  std::map<Id, PlayerStats> players;
+  std::vector<TerritorySample> territory;
+};
+
+struct AnalysisOptions {
+  bool latency = true;        // Collect the response times
+  int territoryInterval = 0;  // Frames between territory samples, 0 for none
+};
+
+// Decode a replay front to back and gather its statistics. Returns false if
+// the replay has no keyframe.
+bool analyzeReplay(const ReplayFile &file, const AnalysisOptions &options,
+                   MatchStats &stats);
+
+} // namespace cycles_server
@@ -0,0 +1,396 @@
+#include "self_play.h"
+#include "game_logic.h"
+#include "match_result.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <spdlog/spdlog.h>
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cycles_server {
+
+namespace detail {
+
+const char sampleMagic[8] = {'C', 'Y', 'C', 'S', 'E', 'L', 'F', '1'};
+const std::size_t maxHeaderPlanes = 8;
+// Cells the space policy looks at behind each move
+const int spaceLimit = 400;
+// Bytes kept in memory before a write
+const std::size_t writeBuffer = 4 << 20;
+
+void putLittleEndian(std::uint8_t *out, std::uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+  }
+}
+
+std::uint64_t readLittleEndian(const std::uint8_t *bytes, int count) {
+  std::uint64_t value = 0;
+  for (int i = count - 1; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+// Free cells reachable from start, at most limit
+int room(const PaddedGrid &grid, int start, int limit) {
+  // Stamps instead of a cleared visited array, one per search
+  thread_local std::vector<std::uint32_t> seen;
+  thread_local std::vector<int> queue;
+  thread_local std::uint32_t stamp = 0;
+  std::size_t cells = grid.stride() * (grid.getHeight() + 2);
+  if (seen.size() != cells || ++stamp == 0) {
+    seen.assign(cells, 0);
+    stamp = 1;
+  }
+  auto offsets = grid.neighbourOffsets();
+  queue.clear();
+  queue.push_back(start);
+  seen[start] = stamp;
+  std::size_t cap = limit;
+  for (std::size_t i = 0; i < queue.size() && queue.size() < cap; i++) {
+    for (int offset : offsets) {
+      int next = queue[i] + offset;
+      if (grid[next] == 0 && seen[next] != stamp) {
+        seen[next] = stamp;
+        queue.push_back(next);
+      }
+    }
+  }
+  return std::min<int>(queue.size(), limit);
+}
+
+// One bit per value, the first value in the lowest bit
+void pack(const std::uint8_t *values, std::size_t count, std::uint8_t *out) {
+  std::fill(out, out + (count + 7) / 8, 0);
+  for (std::size_t i = 0; i < count; i++) {
+    out[i >> 3] |= (values[i] != 0) << (i & 7);
+  }
+}
+
+} // namespace detail
+
+std::optional<Policy> parsePolicy(const std::string &name) {
+  if (name == "random") {
+    return Policy::random;
+  }
+  if (name == "safe") {
+    return Policy::safe;
+  }
+  if (name == "space") {
+    return Policy::space;
+  }
+  return std::nullopt;
+}
+
+Direction choose(Policy policy, const PaddedGrid &grid,
+                 sf::Vector2i head, Direction heading, std::mt19937 &rng) {
+  int back = (static_cast<int>(heading) + 2) % 4;
+  if (policy == Policy::random) {
+    return static_cast<Direction>((back + 1 + rng() % 3) % 4);
+  }
+  auto offsets = grid.neighbourOffsets();
+  int cell = grid.index(head);
+  std::array<int, 4> free;
+  int count = 0;
+  for (int d = 0; d < 4; d++) {
+    if (grid[cell + offsets[d]] == 0) {
+      free[count++] = d;
+    }
+  }
+  if (count == 0) {
+    return heading; // Every move crashes
+  }
+  if (policy == Policy::safe) {
+    return static_cast<Direction>(free[rng() % count]);
+  }
+  // Ties are broken at random so the bots do not all play the same game
+  std::array<int, 4> best;
+  int bestCount = 0;
+  int bestRoom = -1;
+  for (int i = 0; i < count; i++) {
+    int room = detail::room(grid, cell + offsets[free[i]], detail::spaceLimit);
+    if (room > bestRoom) {
+      bestRoom = room;
+      bestCount = 0;
+    }
+    if (room == bestRoom) {
+      best[bestCount++] = free[i];
+    }
+  }
+  return static_cast<Direction>(best[rng() % bestCount]);
+}
+
+cycles::FeatureOptions SelfPlayOptions::defaultFeatures() {
+  using cycles::FeaturePlane;
+  cycles::FeatureOptions features;
+  features.planes = {FeaturePlane::free, FeaturePlane::wall, FeaturePlane::own,
+                     FeaturePlane::opponents, FeaturePlane::opponentHeads};
+  return features;
+}
+
+std::vector<Sample> playMatch(const Configuration &conf,
+                              const SelfPlayOptions &options,
+                              std::uint32_t match) {
+  if (!SampleLayout{0, true, options.features.planes}.binary()) {
+    spdlog::error("Self-play samples only hold binary planes");
+    return {};
+  }
+  Configuration matchConf = conf;
+  matchConf.seed = options.seed + match;
+  if (matchConf.seed == 0) {
+    matchConf.seed = 1; // 0 would pick a random seed
+  }
+  matchConf.moveThreads = 0; // The cores play other matches
+  Game game(matchConf);
+  auto events = game.subscribe();
+  std::mt19937 rng(matchConf.seed);
+
+  std::map<Id, Policy> policies;
+  std::map<Id, Direction> headings;
+  for (int i = 0; i < options.players; i++) {
+    Id id = game.addPlayer("selfplay" + std::to_string(i));
+    policies[id] = options.policies[i % options.policies.size()];
+    headings[id] = static_cast<Direction>(rng() % 4);
+  }
+  MatchRecorder recorder;
+  recorder.addPlayers(game.getPlayers());
+
+  PaddedGrid grid(conf.gridWidth, conf.gridHeight);
+  cycles::GameState state;
+  state.gridWidth = conf.gridWidth;
+  state.gridHeight = conf.gridHeight;
+  state.grid.resize(conf.gridWidth * conf.gridHeight);
+  cycles::FeatureEncoder encoder(options.features);
+  std::vector<std::uint8_t> values(encoder.size());
+  std::size_t planeBytes = (encoder.size() + 7) / 8;
+
+  std::vector<Sample> samples;
+  int frame = 0;
+  int maxFrames = std::min(options.maxFrames, 65535);
+  for (; frame < maxFrames && !game.isGameOver(); frame++) {
+    game.setFrame(frame);
+    auto players = game.getPlayers();
+    if (players.empty()) {
+      break;
+    }
+    state.frameNumber = frame;
+    game.forEachGridRow([&, y = 0](const Id *row, int width) mutable {
+      std::copy(row, row + width, &grid[grid.index(0, y)]);
+      std::copy(row, row + width, state.grid.begin() + y++ * width);
+    });
+    state.players.clear();
+    for (const auto &[id, player] : players) {
+      state.players.push_back({player.name, player.color, player.position, id});
+    }
+
+    std::map<Id, Direction> directions;
+    for (const auto &[id, player] : players) {
+      Direction heading = headings[id];
+      Direction move = choose(policies[id], grid, player.position, heading, rng);
+      directions[id] = move;
+      Sample sample;
+      sample.match = match;
+      sample.frame = frame;
+      sample.player = id;
+      sample.heading = static_cast<std::uint8_t>(heading);
+      sample.move = static_cast<std::uint8_t>(move);
+      sample.planes.resize(planeBytes);
+      encoder.encode({&state, id, heading}, values.data());
+      detail::pack(values.data(), values.size(), sample.planes.data());
+      samples.push_back(std::move(sample));
+      headings[id] = move;
+    }
+    game.movePlayers(directions);
+    GameEvent event;
+    while (events->pop(event)) {
+      recorder.record(event);
+    }
+  }
+
+  auto result = recorder.finish(frame);
+  std::map<Id, const PlayerResult *> results;
+  for (const auto &player : result.players) {
+    results[player.id] = &player;
+  }
+  for (auto &sample : samples) {
+    const auto &player = *results.at(sample.player);
+    sample.place = player.place;
+    sample.players = result.players.size();
+    sample.remaining = std::max(player.lastFrame - sample.frame, 0);
+  }
+  return samples;
+}
+
+SampleWriter::SampleWriter(const std::string &path, SampleLayout layout)
+    : file(path, std::ios::binary | std::ios::trunc), layout(layout) {
+  if (!file || layout.planes.size() > detail::maxHeaderPlanes ||
+      !layout.binary()) {
+    file.close();
+    return;
+  }
+  std::uint8_t header[sampleHeaderSize] = {};
+  std::memcpy(header, detail::sampleMagic, sizeof(detail::sampleMagic));
+  detail::putLittleEndian(header + 8, layout.recordSize(), 4);
+  detail::putLittleEndian(header + 12, layout.radius, 4);
+  detail::putLittleEndian(header + 16, layout.planes.size(), 4);
+  std::fill(header + 20, header + 20 + detail::maxHeaderPlanes, 255);
+  for (std::size_t i = 0; i < layout.planes.size(); i++) {
+    header[20 + i] = static_cast<std::uint8_t>(layout.planes[i]);
+  }
+  detail::putLittleEndian(header + 28, layout.rotate, 4);
+  file.write(reinterpret_cast<const char *>(header), sampleHeaderSize);
+  buffer.reserve(detail::writeBuffer + layout.recordSize());
+}
+
+SampleWriter::~SampleWriter() {
+  if (!isOpen()) {
+    return;
+  }
+  flush();
+  std::uint8_t count[8];
+  detail::putLittleEndian(count, records, 8);
+  file.seekp(32);
+  file.write(reinterpret_cast<const char *>(count), sizeof(count));
+}
+
+void SampleWriter::flush() {
+  file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+  buffer.clear();
+}
+
+void SampleWriter::write(const Sample &sample) {
+  if (!isOpen()) {
+    return;
+  }
+  std::size_t offset = buffer.size();
+  buffer.resize(offset + layout.recordSize());
+  std::uint8_t *out = buffer.data() + offset;
+  detail::putLittleEndian(out, sample.match, 4);
+  detail::putLittleEndian(out + 4, sample.frame, 2);
+  out[6] = sample.player;
+  out[7] = sample.heading;
+  out[8] = sample.move;
+  out[9] = sample.place;
+  out[10] = sample.players;
+  detail::putLittleEndian(out + 11, sample.remaining, 2);
+  std::size_t planeBytes = std::min(sample.planes.size(), layout.planeBytes());
+  std::copy_n(sample.planes.begin(), planeBytes, out + 13);
+  std::fill(out + 13 + planeBytes, out + layout.recordSize(), 0);
+  records++;
+  if (buffer.size() >= detail::writeBuffer) {
+    flush();
+  }
+}
+
+SampleFile::~SampleFile() {
+#ifndef _WIN32
+  if (mapping != nullptr) {
+    munmap(mapping, length);
+  }
+#endif
+}
+
+bool SampleFile::open(const std::string &path) {
+  records = 0;
+#ifdef _WIN32
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  buffer.assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  data = buffer.data();
+  length = buffer.size();
+#else
+  // A file opened before is unmapped first
+  if (mapping != nullptr) {
+    munmap(mapping, length);
+    mapping = nullptr;
+    data = nullptr;
+  }
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return false;
+  }
+  length = info.st_size;
+  if (length > 0) {
+    mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    return false;
+  }
+  data = static_cast<const std::uint8_t *>(mapping);
+#endif
+  if (length < sampleHeaderSize ||
+      std::memcmp(data, detail::sampleMagic, sizeof(detail::sampleMagic)) != 0) {
+    return false;
+  }
+  std::size_t recordSize = detail::readLittleEndian(data + 8, 4);
+  layout.radius = detail::readLittleEndian(data + 12, 4);
+  std::size_t planeCount = detail::readLittleEndian(data + 16, 4);
+  if (planeCount > detail::maxHeaderPlanes || layout.radius < 0) {
+    return false;
+  }
+  layout.planes.clear();
+  for (std::size_t i = 0; i < planeCount; i++) {
+    layout.planes.push_back(static_cast<cycles::FeaturePlane>(data[20 + i]));
+  }
+  layout.rotate = detail::readLittleEndian(data + 28, 4) != 0;
+  if (recordSize != layout.recordSize()) {
+    return false;
+  }
+  // A writer that did not finish leaves the count at 0, its complete records
+  // are still good
+  records = (length - sampleHeaderSize) / recordSize;
+  std::uint64_t count = detail::readLittleEndian(data + 32, 8);
+  if (count != 0) {
+    records = std::min(records, count);
+  }
+#ifndef _WIN32
+  // Training reads the records in a random order
+  if (mapping != nullptr) {
+    madvise(mapping, length, MADV_RANDOM);
+  }
+#endif
+  return true;
+}
+
+Sample SampleFile::read(std::uint64_t i) const {
+  const std::uint8_t *in = record(i);
+  Sample sample;
+  sample.match = detail::readLittleEndian(in, 4);
+  sample.frame = detail::readLittleEndian(in + 4, 2);
+  sample.player = in[6];
+  sample.heading = in[7];
+  sample.move = in[8];
+  sample.place = in[9];
+  sample.players = in[10];
+  sample.remaining = detail::readLittleEndian(in + 11, 2);
+  sample.planes.assign(in + 13, in + layout.recordSize());
+  return sample;
+}
+
+void SampleFile::unpack(std::uint64_t i, std::uint8_t *out) const {
+  const std::uint8_t *planes = record(i) + 13;
+  std::size_t count = layout.planes.size() * layout.side() * layout.side();
+  for (std::size_t j = 0; j < count; j++) {
+    out[j] = (planes[j >> 3] >> (j & 7)) & 1;
+  }
+}
+
+} // namespace cycles_server
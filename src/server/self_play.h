@@ -0,0 +1,149 @@
+#pragma once
+#include "board.h"
+#include "feature_planes.h"
+#include "server.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// Self-play: matches between bots that run in the process, played with the
+// rules of Game, turned into training samples. Each sample is a player's
+// view of a frame (the bit-packed binary feature planes around its head,
+// turned to its heading), the move it made and how its match ended.
+
+// How the bots of a match choose their moves
+enum class Policy {
+  random, // Any move but back into its own trail
+  safe,   // A random move to a free cell
+  space   // The free cell with the most room behind it
+};
+
+std::optional<Policy> parsePolicy(const std::string &name);
+
+// Move of the player whose head is at head, heading is its last move
+Direction choose(Policy policy, const PaddedGrid &grid,
+                 sf::Vector2i head, Direction heading, std::mt19937 &rng);
+
+struct SelfPlayOptions {
+  int players = 4;        // In each match
+  int maxFrames = 2000;   // Matches still running then end in a draw
+  std::vector<Policy> policies = {Policy::space}; // Dealt to the players in turn
+  unsigned seed = 1;      // Match i plays with seed + i
+  cycles::FeatureOptions features = defaultFeatures();
+
+  // The binary planes, ownHead is always the centre and wallDistance follows
+  // from the others
+  static cycles::FeatureOptions defaultFeatures();
+};
+
+struct Sample {
+  std::uint32_t match = 0;
+  std::uint16_t frame = 0;
+  Id player = 0;
+  std::uint8_t heading = 0; // Direction of its last move, up in the planes
+  std::uint8_t move = 0;    // Direction it moved, (move - heading) & 3 is
+                            // straight, right, back or left
+  std::uint8_t place = 0;   // 1 for the winner, ties share a place
+  std::uint8_t players = 0; // In the match
+  std::uint16_t remaining = 0; // Frames the player lasted after this one
+  std::vector<std::uint8_t> planes; // One bit per value, plane after plane
+};
+
+// Play a match to the end and return a sample for each player and frame,
+// none when a plane of the options is not binary
+std::vector<Sample> playMatch(const Configuration &conf,
+                              const SelfPlayOptions &options,
+                              std::uint32_t match);
+
+// Sample files: a 64 byte header then fixed size records, all little endian.
+//   header: "CYCSELF1", record size (u32), radius (u32), plane count (u32),
+//   planes (8 x u8, FeaturePlane values, 255 unused), rotate (u32), record
+//   count (u64), the rest zero
+//   record: match (u32), frame (u16), player, heading, move, place, players
+//   (u8 each), remaining (u16), planes (side * side * plane count bits,
+//   rounded up to bytes)
+// Record i is at 64 + i * record size, so a mapped file is read in place.
+struct SampleLayout {
+  int radius = 0;
+  bool rotate = true;
+  std::vector<cycles::FeaturePlane> planes;
+
+  int side() const { return 2 * radius + 1; }
+  // Every plane packs to one bit per value, wallDistance does not
+  bool binary() const {
+    return std::find(planes.begin(), planes.end(),
+                     cycles::FeaturePlane::wallDistance) == planes.end();
+  }
+  std::size_t planeBytes() const {
+    return (planes.size() * side() * side() + 7) / 8;
+  }
+  std::size_t recordSize() const { return 13 + planeBytes(); }
+};
+
+constexpr std::size_t sampleHeaderSize = 64;
+
+// Appends the samples to a file through a large buffer
+class SampleWriter {
+  std::ofstream file;
+  SampleLayout layout;
+  std::vector<std::uint8_t> buffer;
+  std::uint64_t records = 0;
+
+  void flush();
+
+public:
+  SampleWriter(const std::string &path, SampleLayout layout);
+  SampleWriter(const SampleWriter &) = delete;
+  SampleWriter &operator=(const SampleWriter &) = delete;
+  ~SampleWriter(); // Writes the record count
+
+  bool isOpen() const { return file.is_open(); }
+
+  void write(const Sample &sample);
+
+  std::uint64_t size() const { return records; }
+};
+
+// A sample file mapped in memory
+class SampleFile {
+  const std::uint8_t *data = nullptr;
+  std::size_t length = 0;
+#ifdef _WIN32
+  std::vector<std::uint8_t> buffer;
+#else
+  void *mapping = nullptr;
+#endif
+  SampleLayout layout;
+  std::uint64_t records = 0;
+
+public:
+  SampleFile() = default;
+  SampleFile(const SampleFile &) = delete;
+  SampleFile &operator=(const SampleFile &) = delete;
+  ~SampleFile();
+
+  // False if the file can not be read or is not a sample file
+  bool open(const std::string &path);
+
+  const SampleLayout &getLayout() const { return layout; }
+
+  std::uint64_t size() const { return records; }
+
+  // The record as written, recordSize() bytes
+  const std::uint8_t *record(std::uint64_t i) const {
+    return data + sampleHeaderSize + i * layout.recordSize();
+  }
+
+  Sample read(std::uint64_t i) const;
+
+  // The planes of a record as one byte per value, 0 or 1
+  void unpack(std::uint64_t i, std::uint8_t *out) const;
+};
+
+} // namespace cycles_server
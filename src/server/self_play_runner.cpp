@@ -0,0 +1,108 @@
+// Generate training data from matches between in-process bots, one match per
+// worker at a time. Each worker appends to its own sample file in the output
+// directory, so nothing is shared but the match counter.
+#include "self_play.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cycles_server;
+
+void usage(const char *name) {
+  spdlog::critical("Usage: {} [--matches N] [--threads N] [--players N] "
+                   "[--policies space,safe,random] [--radius R] [--seed S] "
+                   "[--max-frames N] <config> <output directory>",
+                   name);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::uint32_t matches = 100;
+  SelfPlayOptions options;
+  std::vector<std::string> arguments;
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    if (argument == "--threads" && i + 1 < argc) {
+      threads = std::max(1, std::stoi(argv[++i]));
+    } else if (argument == "--matches" && i + 1 < argc) {
+      matches = std::max(1, std::stoi(argv[++i]));
+    } else if (argument == "--players" && i + 1 < argc) {
+      options.players = std::clamp(std::stoi(argv[++i]), 2,
+                                   static_cast<int>(cycles::maxPlayerId));
+    } else if (argument == "--radius" && i + 1 < argc) {
+      options.features.radius = std::max(0, std::stoi(argv[++i]));
+    } else if (argument == "--seed" && i + 1 < argc) {
+      options.seed = std::stoul(argv[++i]);
+    } else if (argument == "--max-frames" && i + 1 < argc) {
+      options.maxFrames = std::max(1, std::stoi(argv[++i]));
+    } else if (argument == "--policies" && i + 1 < argc) {
+      options.policies.clear();
+      std::stringstream list(argv[++i]);
+      std::string name;
+      while (std::getline(list, name, ',')) {
+        auto policy = parsePolicy(name);
+        if (!policy) {
+          spdlog::critical("Unknown policy {}", name);
+          usage(argv[0]);
+        }
+        options.policies.push_back(*policy);
+      }
+      if (options.policies.empty()) {
+        usage(argv[0]);
+      }
+    } else {
+      arguments.push_back(argument);
+    }
+  }
+  if (arguments.size() != 2) {
+    usage(argv[0]);
+  }
+  const Configuration conf(arguments[0]);
+  const std::filesystem::path output = arguments[1];
+  std::filesystem::create_directories(output);
+  const SampleLayout layout{options.features.radius, options.features.rotate,
+                            options.features.planes};
+  threads = std::min(threads, matches);
+
+  std::atomic<std::uint32_t> next = 0;
+  std::atomic<std::uint64_t> samples = 0;
+  std::atomic<bool> failed = false;
+  auto worker = [&](unsigned index) {
+    auto path = output / ("samples-" + std::to_string(index) + ".cysp");
+    SampleWriter writer(path.string(), layout);
+    if (!writer.isOpen()) {
+      spdlog::critical("Can not write {}", path.string());
+      failed = true;
+      return;
+    }
+    for (auto match = next++; match < matches && !failed; match = next++) {
+      for (const auto &sample : playMatch(conf, options, match)) {
+        writer.write(sample);
+      }
+    }
+    samples += writer.size();
+  };
+  sf::Clock clock;
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; i++) {
+    pool.emplace_back(worker, i);
+  }
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (failed) {
+    return 1;
+  }
+  float seconds = clock.getElapsedTime().asSeconds();
+  spdlog::info("Played {} matches, {} samples of {} bytes in {:.2f} s with {} "
+               "threads ({:.0f} samples/s)",
+               matches, samples.load(), layout.recordSize(), seconds,
+               pool.size(), samples / std::max(seconds, 0.001f));
+  return 0;
+}
@@ -1,11 +1,29 @@
 #include "server.h"
+#include "broker.h"
+#include "checkpoint.h"
+#include "client_session.h"
 #include "game_logic.h"
+#include "logging.h"
+#include "match_result.h"
 #include "renderer.h"
+#include "spectator.h"
+#include "tick_pipeline.h"
+#include "thread_placement.h"
+#include "tick_rate.h"
+#include "transport.h"
 #include <SFML/Network.hpp>
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <mutex>
-#include <set>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <thread>
 #include <vector>
@@ -15,15 +33,34 @@ using namespace cycles_server;
 // Server Logic
 class GameServer {
   sf::TcpListener listener;
-  std::map<Id, std::shared_ptr<sf::TcpSocket>> clientSockets;
+  std::vector<ClientSession> sessions;
   std::mutex serverMutex;
   std::shared_ptr<Game> game;
+  std::shared_ptr<EventQueue> events;
   const Configuration conf;
+  TickRateController tickRate;
+  TickStats tickStats;
+  // Moves collected -> applied on the last tick, the send of the next frame
+  // completes the critical path
+  std::optional<sf::Time> movesApplied;
+  TickPipeline pipeline;
+  std::unique_ptr<Transport> transport;
+  std::unique_ptr<SpectatorBroadcaster> spectators;
+  MatchRecorder recorder;
+  std::unique_ptr<CheckpointWriter> checkpoints;
+  bool restored = false;
   bool running;
 
 public:
   GameServer(std::shared_ptr<Game> game, Configuration conf)
-      : game(game), conf(conf), running(false) {
+      : game(game), events(game->subscribe()), conf(conf), tickRate(conf),
+        pipeline(conf.pipelineThreads,
+                 [this] {
+                   placeThread("pipeline", this->conf.pipelineCpus,
+                               this->conf.realtimePriority);
+                 }),
+        transport(makeTransport(conf)),
+        running(false) {
     const char *portenv = std::getenv("CYCLES_PORT");
     if (portenv == nullptr) {
       spdlog::critical("Please set the CYCLES_PORT environment variable");
@@ -37,23 +74,76 @@ public:
       spdlog::critical("Failed to bind to port {}", PORT);
       exit(1);
     }
+    sessions.reserve(conf.maxClients);
+    if (conf.spectatorPort != 0 || !conf.replayFile.empty()) {
+      spectators =
+          std::make_unique<SpectatorBroadcaster>(conf, game->subscribe());
+    }
+    if (!conf.checkpointFile.empty()) {
+      checkpoints = std::make_unique<CheckpointWriter>(conf);
+    }
+    if (!conf.latencyLog.empty()) {
+      latencyLog.open(conf.latencyLog);
+      latencyLog << "frame,time_ms,player,name,status,latency_ms\n";
+    }
+    if (!conf.broker.empty()) {
+      tickPeriod = tickRate.getPeriod().asMicroseconds() / 1000.f;
+      loadReporter = std::make_unique<LoadReporter>(
+          conf.broker, [this, cpu = CpuMeter()]() mutable {
+            LoadReport report;
+            report.host = this->conf.publicHost;
+            report.port = listener.getLocalPort();
+            report.players = joinedPlayers;
+            report.maxClients = this->conf.maxClients;
+            report.accepting =
+                acceptingClients && joinedPlayers < this->conf.maxClients;
+            report.playing = playing;
+            report.tickP99 = tickP99;
+            report.tickPeriod = tickPeriod;
+            report.cpu = cpu.sample();
+            return report;
+          });
+    }
   }
 
   void run() {
     running = true;
+    if (!restored) {
+      recorder.addPlayers(game->getPlayers());
+    }
+    for (const auto &[id, player] : game->getPlayers()) {
+      playerNames[id] = player.name;
+    }
     std::thread gameLoopThread(&GameServer::gameLoop, this);
     gameLoopThread.join();
+    // Sends the end of the game to the spectators before returning
+    spectators.reset();
+    if (!conf.resultFile.empty()) {
+      writeMatchResult(conf.resultFile, recorder.finish(frame));
+    }
+    // A finished match is not resumed
+    checkpoints.reset();
+    if (!conf.checkpointFile.empty() && game->isGameOver()) {
+      std::filesystem::remove(conf.checkpointFile);
+    }
   }
 
   void stop() { running = false; }
 
   int getFrame() const { return frame; }
 
+  // Latest published state, null until the game loop starts
+  std::shared_ptr<const GameSnapshot> getSnapshot() {
+    std::scoped_lock lock(snapshotMutex);
+    return snapshot;
+  }
+
   void setAcceptingClients(bool accepting) { acceptingClients = accepting; }
 
   void acceptClients() {
+    placeThread("accept", conf.backgroundCpus);
     while (acceptingClients &&
-           static_cast<int>(clientSockets.size()) < conf.maxClients) {
+           static_cast<int>(sessions.size()) < conf.maxClients) {
       auto clientSocket = std::make_shared<sf::TcpSocket>();
       if (listener.accept(*clientSocket) == sf::Socket::Done) {
         clientSocket->setBlocking(
@@ -64,194 +154,554 @@ public:
           std::string playerName;
           namePacket >> playerName;
           auto id = game->addPlayer(playerName);
-          // Send color to the client
+          // Send color to the client, with the token to reconnect when the
+          // match can be resumed
+          ClientSession session;
           sf::Packet colorPacket;
-          const auto &player = game->getPlayers().at(id);
-          colorPacket << player.color.r << player.color.g << player.color.b;
+          auto color = game->getPlayers().at(id).color;
+          colorPacket << color.r << color.g << color.b;
+          if (!conf.checkpointFile.empty()) {
+            session.token = newSessionToken();
+            colorPacket << session.token;
+          }
           if (clientSocket->send(colorPacket) != sf::Socket::Done) {
             spdlog::critical("Failed to send color to client: {}", playerName);
           } else {
             spdlog::info("Color sent to client: {}", playerName);
           }
-          clientSocket->setBlocking(
-              false); // Set back to non-blocking for game loop
-          clientSockets[id] = clientSocket;
+          session.id = id;
+          session.name = playerName;
+          std::scoped_lock lock(serverMutex);
+          transport->addClient(id, clientSocket);
+          sessions.push_back(std::move(session));
+          joinedPlayers++;
           spdlog::info("New client connected: {} with id {}", playerName, id);
         }
       }
     }
   }
 
+  // Take over a match from a checkpoint, the game must be restored already.
+  // Waits up to reconnectGrace seconds for the clients to come back with
+  // their token, the players of the others are removed.
+  void resume(const Checkpoint &checkpoint) {
+    restored = true;
+    acceptingClients = false;
+    // The checkpoint is taken after the moves of its frame
+    frame = checkpoint.game.frame + 1;
+    recorder.restore(checkpoint.standings);
+    for (const auto &saved : checkpoint.sessions) {
+      ClientSession session;
+      session.id = saved.id;
+      session.name = saved.name;
+      session.token = saved.token;
+      if (saved.lastDirection >= 0) {
+        session.lastDirection = static_cast<Direction>(saved.lastDirection);
+      }
+      session.missedFrames = saved.missedFrames;
+      session.disconnected = true;
+      sessions.push_back(std::move(session));
+      joinedPlayers++;
+    }
+    spdlog::info("Resuming at frame {}, waiting for {} clients", frame,
+                 sessions.size());
+    sf::Clock clock;
+    auto missing = sessions.size();
+    while (missing > 0 &&
+           clock.getElapsedTime().asSeconds() < conf.reconnectGrace) {
+      auto socket = std::make_shared<sf::TcpSocket>();
+      if (listener.accept(*socket) != sf::Socket::Done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        continue;
+      }
+      socket->setBlocking(true);
+      sf::Packet namePacket;
+      std::string name;
+      sf::Uint64 token = 0;
+      if (socket->receive(namePacket) != sf::Socket::Done ||
+          !(namePacket >> name >> token)) {
+        spdlog::warn("A client without a session tried to join");
+        continue;
+      }
+      auto session = std::find_if(
+          sessions.begin(), sessions.end(), [token](const auto &session) {
+            return session.disconnected && session.token == token;
+          });
+      if (session == sessions.end()) {
+        spdlog::warn("{} has no session to resume", name);
+        continue;
+      }
+      sf::Packet colorPacket;
+      auto color = playerColor(session->id);
+      colorPacket << color.r << color.g << color.b << token;
+      if (socket->send(colorPacket) != sf::Socket::Done) {
+        continue;
+      }
+      transport->addClient(session->id, socket);
+      session->disconnected = false;
+      missing--;
+      spdlog::info("{} is back as player {}", name, session->id);
+    }
+    for (const auto &session : sessions) {
+      if (session.disconnected) {
+        spdlog::info("Player {} did not come back", session.id);
+        game->removePlayer(session.id);
+      }
+    }
+  }
+
 private:
   int frame = 0;
-  const int max_client_communication_time = 50; // ms
+  // Serialized game state, built ahead of time by the pipeline
+  sf::Packet framePacket;
+  int framePacketFrame = -1;
+  std::shared_ptr<const GameSnapshot> snapshot;
+  std::mutex snapshotMutex;
+  // Response times of this frame, and of the previous one for the pipeline
+  std::map<Id, sf::Time> answerLatencies;
+  std::map<Id, sf::Time> publishedLatencies;
+  // How each client answered the last frame, written to the latency log by
+  // the pipeline
+  struct LatencyRecord {
+    Id id;
+    const char *status; // answered, planned or late
+    sf::Time latency;
+  };
+  std::ofstream latencyLog;
+  std::vector<LatencyRecord> latencyRecords;
+  std::int64_t latencyTime = 0; // Wall clock (ms) when the moves were applied
+  std::map<Id, std::string> playerNames;
+  // Reused by every send
+  std::vector<Id> sendIds;
+  std::vector<sf::Socket::Status> sendStatuses;
+
+  std::atomic<bool> acceptingClients = true;
+  // Read by the load reporter
+  std::atomic<int> joinedPlayers = 0;
+  std::atomic<bool> playing = false;
+  std::atomic<float> tickP99 = 0;
+  std::atomic<float> tickPeriod = 0;
+  // Last, it reads the members above from its thread
+  std::unique_ptr<LoadReporter> loadReporter;
 
-  bool acceptingClients = true;
+  std::vector<SessionCheckpoint> saveSessions() const {
+    std::vector<SessionCheckpoint> saved;
+    for (const auto &session : sessions) {
+      saved.push_back({session.id, session.name, session.token,
+                       session.lastDirection
+                           ? static_cast<int>(*session.lastDirection)
+                           : -1,
+                       session.missedFrames});
+    }
+    return saved;
+  }
 
+  // Remove the sessions of the players that left the game
   void checkPlayers() {
-    // Remove sockets from players that have died or disconnected
-    spdlog::debug("Server ({}): Checking players", frame);
-    auto players = game->getPlayers();
-    for (const auto &[id, socket] : clientSockets) {
-      bool remove = false;
-      if (players.find(id) == players.end()) {
-        spdlog::info("Player {} has died", id);
-        remove = true;
+    std::bitset<std::numeric_limits<Id>::max() + 1> removed;
+    GameEvent event;
+    while (events->pop(event)) {
+      recorder.record(event);
+      if (event.type == GameEvent::Type::playerDied) {
+        spdlog::info("Player {} has died", event.player);
+      } else {
+        removed.set(event.player);
       }
-      if (socket->getRemoteAddress() == sf::IpAddress::None) {
-        spdlog::info("Player {} has disconnected", id);
-        remove = true;
+    }
+    if (removed.any()) {
+      for (std::size_t id = 0; id < removed.size(); id++) {
+        if (removed.test(id)) {
+          transport->removeClient(static_cast<Id>(id));
+        }
       }
-      if (remove) {
-        game->removePlayer(id);
-        clientSockets.erase(id);
+      std::erase_if(sessions, [&removed](const auto &session) {
+        return removed.test(session.id);
+      });
+    }
+  }
+
+  // Read the queued submissions of a client. Several may be queued, the
+  // newest one that covers this frame replaces the plan.
+  bool receiveClientInput(ClientSession &session) {
+    bool received = false;
+    sf::Packet packet;
+    sf::Socket::Status status;
+    while ((status = transport->receive(session.id, packet)) ==
+           sf::Socket::Done) {
+      switch (readPlan(packet, frame, conf.maxPlanLength, session.plan)) {
+      case PlanStatus::accepted:
+        CYCLES_HOT_DEBUG("Received {} directions from player {} ({})",
+                         session.plan.directions.size(), session.id,
+                         session.name);
+        received = true;
+        break;
+      case PlanStatus::malformed:
+        spdlog::warn("Server ({}): Malformed move from player {} ({})", frame,
+                     session.id, session.name);
+        break;
+      case PlanStatus::outdated:
+        CYCLES_HOT_DEBUG("Server ({}): Discarding a move from player {} ({})",
+                         frame, session.id, session.name);
+        break;
       }
     }
+    if (status == sf::Socket::Disconnected) {
+      session.disconnected = true;
+    }
+    return received;
   }
 
-  auto receiveClientInput(auto clientSockets) {
-    spdlog::debug("Server ({}): Receiving client input from {} clients", frame,
-                  clientSockets.size());
-    if (clientSockets.size() == 0) {
-      return std::map<Id, Direction>();
-    }
-    std::map<Id, Direction> successful;
-    for (const auto &[id, clientSocket] : clientSockets) {
-      auto name = game->getPlayers().at(id).name;
-      spdlog::debug("Server ({}): Receiving input from player {} ({})", frame,
-                    id, name);
-      sf::Packet packet;
-      auto status = clientSocket->receive(packet);
-      if (status == sf::Socket::Done) {
-        int direction;
-        packet >> direction;
-        spdlog::debug("Received direction {} from player {} ({})", direction,
-                      id, name);
-        successful[id] = static_cast<Direction>(direction);
+  void serializeGameState() {
+    writeGameState(framePacket, conf.gridWidth, conf.gridHeight,
+                   game->getPlayers(), frame);
+    // Cells are single bytes, same as writing them one by one
+    static_assert(sizeof(Id) == 1);
+    game->forEachGridRow([this](const Id *row, int width) {
+      framePacket.append(row, width);
+    });
+    framePacketFrame = frame;
+  }
+
+  void recordLatencies() {
+    latencyRecords.clear();
+    latencyTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    for (const auto &session : sessions) {
+      auto it = publishedLatencies.find(session.id);
+      if (it != publishedLatencies.end()) {
+        latencyRecords.push_back({session.id, "answered", it->second});
+      } else {
+        latencyRecords.push_back(
+            {session.id, session.plan.covers(frame) ? "planned" : "late",
+             sf::Time::Zero});
       }
     }
-    return successful;
   }
 
-  auto sendGameState(auto clientSockets) {
-    spdlog::debug("Server ({}): Sending game state to {} clients", frame,
-                  clientSockets.size());
-    if (clientSockets.size() == 0) {
-      return std::vector<Id>();
+  void writeLatencies(int loggedFrame) {
+    for (const auto &record : latencyRecords) {
+      latencyLog << loggedFrame << "," << latencyTime << ","
+                 << static_cast<int>(record.id) << ","
+                 << playerNames[record.id] << "," << record.status << ","
+                 << record.latency.asMicroseconds() / 1000.f << "\n";
     }
-    sf::Packet packet;
-    packet << conf.gridWidth << conf.gridHeight;
-    const auto &grid = game->getGrid();
-    auto players = game->getPlayers();
-    packet << static_cast<sf::Uint32>(players.size());
-    for (const auto &[id, player] : players) {
-      packet << player.position.x << player.position.y << player.color.r
-             << player.color.g << player.color.b << player.name << id << frame;
-    }
-    for (auto &cell : grid) {
-      packet << cell;
-    }
-    std::vector<Id> successful;
-    for (const auto &[id, clientSocket] : clientSockets) {
-      if (clientSocket->send(packet) != sf::Socket::Done) {
-        spdlog::debug("Server ({}): Failed to send game state to player {}",
-                      frame, id);
-      } else {
-        successful.push_back(id);
-        spdlog::debug("Server ({}): Game state sent to player {}", frame, id);
+  }
+
+  void publishSnapshot() {
+    auto newSnapshot = std::make_shared<GameSnapshot>(game->getSnapshot());
+    newSnapshot->latencies = publishedLatencies;
+    if (spectators) {
+      spectators->publish(newSnapshot);
+    }
+    std::scoped_lock lock(snapshotMutex);
+    snapshot = newSnapshot;
+  }
+
+  // Send the frame to every session still waiting for it in one batch,
+  // returns whether any send went through
+  bool sendGameState(sf::Time now) {
+    if (framePacketFrame != frame) {
+      serializeGameState();
+    }
+    sendIds.clear();
+    for (const auto &session : sessions) {
+      if (session.state == SessionState::pendingSend) {
+        sendIds.push_back(session.id);
       }
     }
-    return successful;
+    if (sendIds.empty()) {
+      return false;
+    }
+    transport->send(framePacket, frame, sendIds, sendStatuses);
+    bool sent = false;
+    std::size_t i = 0;
+    for (auto &session : sessions) {
+      if (session.state != SessionState::pendingSend) {
+        continue;
+      }
+      auto status = sendStatuses[i++];
+      if (status != sf::Socket::Done) {
+        CYCLES_HOT_DEBUG("Server ({}): Failed to send game state to player {}",
+                         frame, session.id);
+        session.disconnected = status == sf::Socket::Disconnected;
+        continue;
+      }
+      CYCLES_HOT_DEBUG("Server ({}): Game state sent to player {}", frame,
+                       session.id);
+      session.sentAt = now;
+      session.state = SessionState::awaitingMove;
+      sent = true;
+    }
+    return sent;
   }
 
+  // Send the frame and collect the moves until every session is done or the
+  // communication window closes
+  void communicate() {
+    sf::Clock clientCommunicationClock;
+    bool firstSend = true;
+    int pending = static_cast<int>(sessions.size());
+    answerLatencies.clear();
+    for (auto &session : sessions) {
+      session.state = SessionState::pendingSend;
+    }
+    while (pending > 0) {
+      if (sendGameState(clientCommunicationClock.getElapsedTime()) &&
+          firstSend) {
+        firstSend = false;
+        if (movesApplied) {
+          tickStats.criticalPath.add(
+              *movesApplied + clientCommunicationClock.getElapsedTime());
+          movesApplied.reset();
+        }
+        // The game does not change while waiting for the clients
+        pipeline.submit([this] { publishSnapshot(); });
+      }
+      transport->poll();
+      for (auto &session : sessions) {
+        if (session.state == SessionState::awaitingMove &&
+            session.plan.covers(frame)) {
+          session.state = SessionState::planned;
+          pending--;
+        }
+        if (session.state == SessionState::awaitingMove &&
+            receiveClientInput(session)) {
+          session.state = SessionState::done;
+          session.latency =
+              clientCommunicationClock.getElapsedTime() - session.sentAt;
+          tickRate.addLatency(session.latency);
+          answerLatencies[session.id] = session.latency;
+          pending--;
+        }
+        // Nothing more to wait for from a closed connection
+        if (session.disconnected &&
+            (session.state == SessionState::pendingSend ||
+             session.state == SessionState::awaitingMove)) {
+          session.state = SessionState::done;
+          pending--;
+        }
+      }
+      if (clientCommunicationClock.getElapsedTime().asMilliseconds() >
+          conf.maxClientCommunicationTime) {
+        break;
+      }
+    }
+    // Timeouts count as the whole window, or the p99 would only see the
+    // clients fast enough to answer
+    for (const auto &session : sessions) {
+      if (session.state == SessionState::awaitingMove) {
+        tickRate.addTimeout();
+      }
+    }
+    CYCLES_HOT_DEBUG("Server ({}): {} clients did not answer in time", frame,
+                     pending);
+  }
+
+  // A tick runs as:
+  //   send frame -> wait for moves -> apply moves -> (idle until next tick)
+  // The pipeline publishes the snapshot while the clients think and
+  // serializes the next frame while the loop idles, so the critical path from
+  // the moves collected to the next frame sent is movePlayers plus the send,
+  // the idle time is not part of it.
   void gameLoop() {
+    placeThread("game loop", conf.gameLoopCpus, conf.realtimePriority);
+    // Spun before each tick instead of slept, sleeps can overshoot
+    const sf::Time tickSpin = sf::microseconds(500);
     sf::Clock clock;
-    sf::Clock clientCommunicationClock;
+    std::map<Id, Direction> newDirs;
+    playing = true;
     while (running && !game->isGameOver()) {
-      if (clock.getElapsedTime().asMilliseconds() >= 33) { // ~30 fps
-        clock.restart();
+      auto untilTick = tickRate.getPeriod() - clock.getElapsedTime();
+      if (untilTick > tickSpin) {
+        // Sleep through most of the wait, spinning it all would starve the
+        // core at real-time priority
+        sf::sleep(untilTick - tickSpin);
+      } else if (untilTick <= sf::Time::Zero) {
+        // How late the tick starts, the loop spins the last moments so this
+        // is the time the thread did not get to run
+        auto late = clock.restart() - tickRate.getPeriod();
         std::scoped_lock lock(serverMutex);
+        // The pipeline reports the stats
+        pipeline.wait();
+        tickStats.tickJitter.add(late);
         game->setFrame(frame);
         checkPlayers();
-        auto clientsUnsent = clientSockets;
-        decltype(clientSockets) toRecieve;
-        std::map<Id, Direction> newDirs;
-        std::set<Id> timedOutPlayers;
-        clientCommunicationClock.restart();
-        while (clientsUnsent.size() > 0 || toRecieve.size() > 0) {
-          auto successful = sendGameState(clientsUnsent);
-          for (auto s : successful) {
-            clientsUnsent.erase(s);
-            toRecieve[s] = clientSockets[s];
+        communicate();
+        sf::Clock criticalPathClock;
+        // The pipeline may still be reading the game
+        pipeline.wait();
+        std::swap(answerLatencies, publishedLatencies);
+        newDirs.clear();
+        transport->poll();
+        for (auto &session : sessions) {
+          if (session.disconnected) {
+            spdlog::info("Player {} has disconnected", session.id);
+            game->removePlayer(session.id);
+            continue;
           }
-          auto succesfulrec = receiveClientInput(toRecieve);
-          for (auto s : succesfulrec) {
-            toRecieve.erase(s.first);
-            newDirs[s.first] = s.second;
+          // A new submission replaces what is left of the previous plan
+          if (session.state == SessionState::planned) {
+            receiveClientInput(session);
+            session.state = SessionState::done;
           }
-          spdlog::debug("Server ({}): Clients unsent: {}", frame,
-                        clientsUnsent.size());
-          spdlog::debug("Server ({}): Clients to recieve: {}", frame,
-                        toRecieve.size());
-          // Check for clients that have not sent input for a long time
-          if (clientCommunicationClock.getElapsedTime().asMilliseconds() >
-              max_client_communication_time) {
-            // Mark all remaining clients for removal
-            for (auto [id, socket] : clientsUnsent) {
-              timedOutPlayers.insert(id);
-            }
-            for (auto [id, socket] : toRecieve) {
-              timedOutPlayers.insert(id);
+          if (session.state == SessionState::done &&
+              session.plan.covers(frame)) {
+            newDirs[session.id] = session.plan.at(frame);
+            session.lastDirection = newDirs[session.id];
+            session.missedFrames = 0;
+            continue;
+          }
+          // Late players keep their last direction for up to maxMissedFrames
+          // consecutive frames, after that they are removed
+          if (++session.missedFrames <= conf.maxMissedFrames) {
+            CYCLES_HOT_DEBUG("Server ({}): Client {} is late ({} frames)",
+                             frame, session.id, session.missedFrames);
+            if (session.lastDirection) {
+              newDirs[session.id] = *session.lastDirection;
             }
-            break;
+            continue;
           }
-        }
-        for (auto id : timedOutPlayers) {
           spdlog::info(
               "Server ({}): Client {} has not sent input for a long time",
-              frame, id);
-          game->removePlayer(id);
-          clientSockets.erase(id);
-          newDirs.erase(id);
+              frame, session.id);
+          game->removePlayer(session.id);
+        }
+        if (latencyLog.is_open()) {
+          recordLatencies();
         }
         game->movePlayers(newDirs);
+        movesApplied = criticalPathClock.getElapsedTime();
         frame++;
+        tickStats.tickDuration.add(clock.getElapsedTime());
+        // The period is only read and changed on this thread
+        tickRate.endFrame();
+        if (loadReporter && frame % 30 == 0) {
+          tickPeriod = tickRate.getPeriod().asMicroseconds() / 1000.f;
+        }
+        // The sessions and standings are copied here, the game by the
+        // pipeline while the loop idles, and the writer thread does the rest
+        std::optional<Checkpoint> checkpoint;
+        if (checkpoints && frame % conf.checkpointInterval == 0) {
+          // Record this tick's deaths first
+          checkPlayers();
+          checkpoint.emplace();
+          checkpoint->sessions = saveSessions();
+          checkpoint->standings = recorder.save();
+        }
+        pipeline.submit([this, checkpoint = std::move(checkpoint)]() mutable {
+          serializeGameState();
+          if (latencyLog.is_open()) {
+            writeLatencies(frame - 1);
+          }
+          tickStats.report(frame);
+          if (loadReporter && frame % 30 == 0) {
+            tickP99 = tickStats.tickDuration.percentile(99).asMicroseconds() /
+                      1000.f;
+          }
+          if (checkpoint) {
+            checkpoint->game = game->save();
+            checkpoints->submit(std::move(*checkpoint));
+          }
+        });
       }
     }
+    pipeline.wait();
+    playing = false;
+    publishSnapshot();
+    // The players out on the last frame
+    checkPlayers();
   }
 };
 
+// Without a window the game starts when the server is full or joinTimeout
+// seconds after the first player joined
+void runHeadless(GameServer &server, Game &game, const Configuration &conf) {
+  std::thread acceptThread(&GameServer::acceptClients, &server);
+  sf::Clock joinClock;
+  bool anyPlayer = false;
+  while (true) {
+    auto players = static_cast<int>(game.getPlayers().size());
+    if (players > 0 && !anyPlayer) {
+      anyPlayer = true;
+      joinClock.restart();
+    }
+    if (players >= conf.maxClients ||
+        (anyPlayer && joinClock.getElapsedTime().asSeconds() >=
+                          conf.joinTimeout)) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  spdlog::info("Starting the game with {} players", game.getPlayers().size());
+  server.setAcceptingClients(false);
+  acceptThread.join();
+  server.run();
+}
+
 int main(int argc, char *argv[]) {
 #if SPDLOG_ACTIVE_LEVEL == SPDLOG_LEVEL_TRACE
   spdlog::set_level(spdlog::level::debug);
 #endif
   std::srand(static_cast<unsigned int>(std::time(nullptr)));
   const std::string config_path = argc > 1 ? argv[1] : "config.yaml";
+  // server <config> restore resumes the match saved in checkpointFile
+  const bool restore = argc > 2 && std::string(argv[2]) == "restore";
   const Configuration conf(config_path);
+  setupAsyncLogging(conf);
   auto game = std::make_shared<Game>(conf);
   GameServer server(game, conf);
+  if (restore) {
+    auto checkpoint = conf.checkpointFile.empty()
+                          ? std::nullopt
+                          : readCheckpoint(conf.checkpointFile);
+    if (!checkpoint || !game->restore(checkpoint->game)) {
+      spdlog::critical("Can not restore the match from '{}'",
+                       conf.checkpointFile);
+      spdlog::shutdown();
+      return 1;
+    }
+    server.resume(*checkpoint);
+  }
+  if (conf.headless) {
+    if (restore) {
+      server.run();
+    } else {
+      runHeadless(server, *game, conf);
+    }
+    spdlog::shutdown();
+    return 0;
+  }
+  placeThread("renderer", conf.rendererCpus);
   GameRenderer renderer(conf);
-  std::thread acceptThread(&GameServer::acceptClients, &server);
-  bool acceptingClients = true;
-  auto spaceEvent = [&acceptingClients](auto &event) {
-    if (event.type == sf::Event::KeyPressed &&
-        event.key.code == sf::Keyboard::Space) {
-      spdlog::info("Space pressed, stopping client acceptance");
-      acceptingClients = false;
+  renderer.setEventQueue(game->subscribe());
+  if (!restore) {
+    std::thread acceptThread(&GameServer::acceptClients, &server);
+    bool acceptingClients = true;
+    auto spaceEvent = [&acceptingClients](auto &event) {
+      if (event.type == sf::Event::KeyPressed &&
+          event.key.code == sf::Keyboard::Space) {
+        spdlog::info("Space pressed, stopping client acceptance");
+        acceptingClients = false;
+      }
+    };
+    while (acceptingClients && renderer.isOpen()) {
+      renderer.handleEvents({spaceEvent});
+      renderer.renderSplashScreen(game->getSnapshot());
     }
-  };
-  while (acceptingClients && renderer.isOpen()) {
-    renderer.handleEvents({spaceEvent});
-    renderer.renderSplashScreen(game);
+    server.setAcceptingClients(false);
+    acceptThread.join();
   }
-  server.setAcceptingClients(false);
-  acceptThread.join();
+  // Shown until the server publishes, Game is not read while it moves
+  const auto lobby = game->getSnapshot();
   std::thread serverThread(&GameServer::run, &server);
   while (renderer.isOpen()) {
     renderer.handleEvents();
-    renderer.render(game);
+    auto snapshot = server.getSnapshot();
+    renderer.render(snapshot ? *snapshot : lobby);
   }
   server.stop();
   serverThread.join();
+  spdlog::shutdown();
   return 0;
 }
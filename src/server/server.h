@@ -2,6 +2,7 @@
 #include "api.h"
 #include <SFML/Main.hpp>
 #include <list>
+#include <vector>
 
 namespace cycles_server {
 using cycles::Direction;
@@ -27,6 +28,41 @@ struct Configuration {
   int gameBannerHeight = 100;
   float cellSize = 10;
   bool enablePostProcessing = false;
+  float tickPeriod = 33;               ///< Time between frames (ms)
+  int maxClientCommunicationTime = 50; ///< Time a client has to answer (ms)
+  bool adaptiveTickRate = false;       ///< Adapt tickPeriod to client latency
+  float minTickPeriod = 4;             ///< Lower bound of the adaptive period (ms)
+  float maxTickPeriod = 100;           ///< Upper bound of the adaptive period (ms)
+  float tickLatencyHeadroom = 1.5;     ///< Adaptive period = p99 latency * headroom
+  int maxMissedFrames = 0; ///< Late frames a player keeps its direction before removal
+  int maxPlanLength = 64;  ///< Maximum number of directions in a move plan
+  int pipelineThreads = 1; ///< Helper threads for off critical path tick work
+  int logQueueSize = 8192; ///< Messages the async logger can hold
+  bool ioUring = false;    ///< Use the io_uring network backend if available
+  int spectatorPort = 0;   ///< Port for the spectator stream, 0 disables it
+  int spectatorKeyframeInterval = 100; ///< Frames between spectator keyframes
+  std::string replayFile;  ///< Record the spectator stream here, empty disables it
+  bool headless = false;   ///< Run without a window, the game starts by itself
+  float joinTimeout = 10;  ///< Headless: seconds after the first player joins to start
+  std::string resultFile;  ///< Write the standings here when the game ends, empty disables it
+  std::string latencyLog;  ///< Write every client's response time per frame here, empty disables it
+  std::vector<int> gameLoopCpus;   ///< Cpus for the game loop thread, empty for any
+  std::vector<int> pipelineCpus;   ///< Cpus for the pipeline threads, empty for any
+  std::vector<int> rendererCpus;   ///< Cpus for the window thread, empty for any
+  std::vector<int> backgroundCpus; ///< Cpus for the accept, spectator and log threads
+  int realtimePriority = 0; ///< Real-time priority of the game loop and pipeline, 0 disables it
+  unsigned seed = 0;        ///< Seed of the spawn positions, 0 picks a random one
+  int moveThreads = 0;      ///< Helper threads that move the players, 0 moves them on the game loop
+  int shards = 2;           ///< Sharded mode: number of strips the board is cut into
+  bool shardVertical = false; ///< Sharded mode: strips of columns instead of rows
+  int shardBasePort = 50200;  ///< Sharded mode: shard i listens on this port + i
+  std::string shardHost = "127.0.0.1"; ///< Sharded mode: host of the shards
+  std::string broker;       ///< Report the load to the broker at host:port, empty disables it
+  std::string publicHost = "127.0.0.1"; ///< Address the broker sends clients to for this server
+  int brokerReportPort = 50300; ///< Broker: port where the servers report their load
+  std::string checkpointFile; ///< Save the match here to resume it after a restart, empty disables it
+  int checkpointInterval = 100; ///< Frames between checkpoints
+  float reconnectGrace = 10;    ///< Seconds a restored match waits for its clients to reconnect
   Configuration(std::string configPath);
 };
 } // namespace cycles_server
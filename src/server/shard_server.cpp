@@ -0,0 +1,367 @@
+// Sharded game: one process per strip of the board and a front end that the
+// clients connect to.
+//   shard_server <config_file> shard <index>
+//   shard_server <config_file> front
+// Start the shards (in any order), then the front end. The clients use the
+// same protocol as with the server, on CYCLES_PORT.
+#include "client_session.h"
+#include "match_result.h"
+#include "sharding.h"
+#include <SFML/Network.hpp>
+#include <chrono>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <vector>
+
+using namespace cycles_server;
+
+// Messages from the front end to a shard
+enum class ShardCommand : sf::Uint8 { addPlayer, tick, stop };
+
+// Who opened a connection to a shard, sent first
+enum class Peer : sf::Uint8 { front, shard };
+
+// Retries while the other process starts, null after a minute
+std::unique_ptr<sf::TcpSocket> connectTo(const std::string &host, int port,
+                                         Peer peer, int index) {
+  for (int attempt = 0; attempt < 600; attempt++) {
+    auto socket = std::make_unique<sf::TcpSocket>();
+    if (socket->connect(host, port, sf::seconds(1)) == sf::Socket::Done) {
+      sf::Packet hello;
+      hello << static_cast<sf::Uint8>(peer) << index;
+      if (socket->send(hello) == sf::Socket::Done) {
+        return socket;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  spdlog::critical("Failed to connect to {}:{}", host, port);
+  return nullptr;
+}
+
+int runShard(const Configuration &conf, const ShardLayout &layout,
+             int index) {
+  Shard shard(layout, index);
+  sf::TcpListener listener;
+  if (listener.listen(conf.shardBasePort + index) != sf::Socket::Done) {
+    spdlog::critical("Shard {}: failed to bind to port {}", index,
+                     conf.shardBasePort + index);
+    return 1;
+  }
+  // Each shard connects to the one before and accepts the one after
+  std::array<std::unique_ptr<sf::TcpSocket>, 2> neighbours;
+  if (shard.hasNeighbour(0)) {
+    neighbours[0] = connectTo(conf.shardHost, conf.shardBasePort + index - 1,
+                              Peer::shard, index);
+    if (!neighbours[0]) {
+      return 1;
+    }
+  }
+  std::unique_ptr<sf::TcpSocket> front;
+  while (!front || (shard.hasNeighbour(1) && !neighbours[1])) {
+    auto socket = std::make_unique<sf::TcpSocket>();
+    if (listener.accept(*socket) != sf::Socket::Done) {
+      continue;
+    }
+    sf::Packet hello;
+    sf::Uint8 peer;
+    int from;
+    if (socket->receive(hello) != sf::Socket::Done || !(hello >> peer >> from)) {
+      continue;
+    }
+    if (static_cast<Peer>(peer) == Peer::front) {
+      front = std::move(socket);
+    } else if (from == index + 1) {
+      neighbours[1] = std::move(socket);
+    }
+  }
+  spdlog::info("Shard {}: owns {} {} to {}", index,
+               layout.vertical ? "columns" : "rows", layout.begin(index),
+               layout.begin(index + 1) - 1);
+  sf::Packet packet;
+  while (front->receive(packet) == sf::Socket::Done) {
+    sf::Uint8 command;
+    packet >> command;
+    if (static_cast<ShardCommand>(command) == ShardCommand::addPlayer) {
+      Player player;
+      if (read(packet, player)) {
+        shard.addPlayer(player);
+      }
+      continue;
+    }
+    if (static_cast<ShardCommand>(command) != ShardCommand::tick) {
+      break;
+    }
+    TickInput input;
+    if (!read(packet, input)) {
+      spdlog::critical("Shard {}: malformed tick from the front end", index);
+      return 1;
+    }
+    // Neighbours have opposite parities: even shards send first and odd
+    // ones receive first, so a blocking send always meets a receive
+    auto messages = shard.begin(input);
+    std::array<std::optional<BorderMessage>, 2> received;
+    auto sendBorder = [&](int side) {
+      sf::Packet border;
+      write(border, *messages[side]);
+      return neighbours[side]->send(border) == sf::Socket::Done;
+    };
+    auto receiveBorder = [&](int side) {
+      sf::Packet border;
+      BorderMessage message;
+      if (neighbours[side]->receive(border) != sf::Socket::Done ||
+          !read(border, message)) {
+        return false;
+      }
+      received[side] = std::move(message);
+      return true;
+    };
+    for (int side : {0, 1}) {
+      if (!neighbours[side]) {
+        continue;
+      }
+      bool exchanged = index % 2 == 0
+                           ? sendBorder(side) && receiveBorder(side)
+                           : receiveBorder(side) && sendBorder(side);
+      if (!exchanged) {
+        spdlog::critical("Shard {}: lost the shard {}", index,
+                         side == 0 ? index - 1 : index + 1);
+        return 1;
+      }
+    }
+    sf::Packet output;
+    write(output, shard.finish(received));
+    front->send(output);
+  }
+  spdlog::info("Shard {}: game over", index);
+  return 0;
+}
+
+// A client of the front end, same rules as a session of the server
+struct Client {
+  ClientSession session;
+  std::unique_ptr<sf::TcpSocket> socket;
+};
+
+// The newest plan that covers the frame replaces the previous one
+void receivePlan(Client &client, int frame, int maxPlanLength) {
+  auto &session = client.session;
+  sf::Packet packet;
+  auto status = client.socket->receive(packet);
+  if (status == sf::Socket::Disconnected) {
+    session.disconnected = true;
+  }
+  if (status != sf::Socket::Done) {
+    return;
+  }
+  if (readPlan(packet, frame, maxPlanLength, session.plan) ==
+      PlanStatus::malformed) {
+    spdlog::warn("Front ({}): Malformed move from player {} ({})", frame,
+                 session.id, session.name);
+  }
+}
+
+// Same layout as the frames of the server
+void serializeGameState(sf::Packet &packet, const ShardFront &front,
+                        const ShardLayout &layout, int frame) {
+  writeGameState(packet, layout.width, layout.height, front.getPlayers(),
+                 frame);
+  static_assert(sizeof(Id) == 1);
+  packet.append(front.getGrid().data(), front.getGrid().size());
+}
+
+int runFront(const Configuration &conf, const ShardLayout &layout) {
+  std::vector<std::unique_ptr<sf::TcpSocket>> shards;
+  for (int i = 0; i < layout.shards; i++) {
+    shards.push_back(
+        connectTo(conf.shardHost, conf.shardBasePort + i, Peer::front, 0));
+    if (!shards.back()) {
+      return 1;
+    }
+  }
+  const char *portenv = std::getenv("CYCLES_PORT");
+  if (portenv == nullptr) {
+    spdlog::critical("Please set the CYCLES_PORT environment variable");
+    return 1;
+  }
+  sf::TcpListener listener;
+  if (listener.listen(std::stoi(portenv)) != sf::Socket::Done) {
+    spdlog::critical("Failed to bind to port {}", portenv);
+    return 1;
+  }
+  listener.setBlocking(false);
+  spdlog::info("Listening on port {}", portenv);
+  // Clients join like on a headless server
+  ShardFront front(layout, conf.seed);
+  std::vector<Client> clients;
+  sf::Clock joinClock;
+  while (static_cast<int>(clients.size()) < conf.maxClients &&
+         (clients.empty() ||
+          joinClock.getElapsedTime().asSeconds() < conf.joinTimeout)) {
+    auto socket = std::make_unique<sf::TcpSocket>();
+    if (listener.accept(*socket) != sf::Socket::Done) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    socket->setBlocking(true);
+    sf::Packet namePacket;
+    std::string name;
+    if (socket->receive(namePacket) != sf::Socket::Done ||
+        !(namePacket >> name)) {
+      continue;
+    }
+    auto [shard, player] = front.addPlayer(name);
+    sf::Packet add;
+    add << static_cast<sf::Uint8>(ShardCommand::addPlayer);
+    write(add, player);
+    shards[shard]->send(add);
+    sf::Packet colorPacket;
+    colorPacket << player.color.r << player.color.g << player.color.b;
+    socket->send(colorPacket);
+    if (clients.empty()) {
+      joinClock.restart();
+    }
+    spdlog::info("New client connected: {} with id {} on shard {}", name,
+                 player.id, shard);
+    Client client;
+    client.session.id = player.id;
+    client.session.name = name;
+    client.socket = std::move(socket);
+    clients.push_back(std::move(client));
+  }
+  spdlog::info("Starting the game with {} players", clients.size());
+  MatchRecorder recorder;
+  recorder.addPlayers(front.getPlayers());
+  sf::SocketSelector selector;
+  for (auto &client : clients) {
+    selector.add(*client.socket);
+  }
+  sf::Packet state;
+  sf::Clock clock;
+  int frame = 0;
+  while (!front.isGameOver()) {
+    auto wait = sf::milliseconds(conf.tickPeriod) - clock.getElapsedTime();
+    if (wait > sf::Time::Zero) {
+      sf::sleep(wait);
+    }
+    clock.restart();
+    serializeGameState(state, front, layout, frame);
+    int pending = 0;
+    for (auto &client : clients) {
+      if (client.socket->send(state) != sf::Socket::Done) {
+        client.session.disconnected = true;
+      }
+      pending += !client.session.disconnected &&
+                 !client.session.plan.covers(frame);
+    }
+    sf::Clock window;
+    while (pending > 0) {
+      auto left = sf::milliseconds(conf.maxClientCommunicationTime) -
+                  window.getElapsedTime();
+      if (left <= sf::Time::Zero || !selector.wait(left)) {
+        break;
+      }
+      for (auto &client : clients) {
+        auto &session = client.session;
+        if (!session.disconnected && selector.isReady(*client.socket)) {
+          bool covered = session.plan.covers(frame);
+          receivePlan(client, frame, conf.maxPlanLength);
+          if (session.disconnected) {
+            selector.remove(*client.socket);
+          }
+          pending -= !covered &&
+                     (session.disconnected || session.plan.covers(frame));
+        }
+      }
+    }
+    std::map<Id, Direction> directions;
+    for (auto &[session, socket] : clients) {
+      if (session.disconnected) {
+        spdlog::info("Player {} has disconnected", session.id);
+        front.removePlayer(session.id);
+      } else if (session.plan.covers(frame)) {
+        directions[session.id] = session.plan.at(frame);
+        session.lastDirection = directions[session.id];
+        session.missedFrames = 0;
+      } else if (++session.missedFrames <= conf.maxMissedFrames) {
+        if (session.lastDirection) {
+          directions[session.id] = *session.lastDirection;
+        }
+      } else {
+        spdlog::info("Client {} has not sent input for a long time",
+                     session.id);
+        front.removePlayer(session.id);
+      }
+    }
+    auto inputs = front.prepareTick(frame, directions);
+    for (int i = 0; i < layout.shards; i++) {
+      sf::Packet packet;
+      packet << static_cast<sf::Uint8>(ShardCommand::tick);
+      write(packet, inputs[i]);
+      shards[i]->send(packet);
+    }
+    std::vector<TickOutput> outputs(layout.shards);
+    for (int i = 0; i < layout.shards; i++) {
+      sf::Packet packet;
+      if (shards[i]->receive(packet) != sf::Socket::Done ||
+          !read(packet, outputs[i])) {
+        spdlog::critical("Lost the shard {}", i);
+        return 1;
+      }
+    }
+    for (const auto &event : front.merge(outputs)) {
+      recorder.record(event);
+      if (event.type == GameEvent::Type::playerDied) {
+        spdlog::info("Player {} has died", event.player);
+      }
+    }
+    std::erase_if(clients, [&](Client &client) {
+      if (front.getPlayers().count(client.session.id)) {
+        return false;
+      }
+      if (!client.session.disconnected) {
+        selector.remove(*client.socket);
+      }
+      return true;
+    });
+    frame++;
+  }
+  for (auto &shard : shards) {
+    sf::Packet stop;
+    stop << static_cast<sf::Uint8>(ShardCommand::stop);
+    shard->send(stop);
+  }
+  if (!conf.resultFile.empty()) {
+    writeMatchResult(conf.resultFile, recorder.finish(frame));
+  }
+  spdlog::info("Game over after {} frames", frame);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  std::string mode = argc > 2 ? argv[2] : "";
+  if (mode != "front" && !(mode == "shard" && argc > 3)) {
+    spdlog::critical("Usage: shard_server <config_file> front | shard <index>");
+    return 1;
+  }
+  const Configuration conf(argv[1]);
+  ShardLayout layout{conf.gridWidth, conf.gridHeight, conf.shards,
+                     conf.shardVertical};
+  if (!layout.valid()) {
+    spdlog::critical("Can not cut a {}x{} grid in {} strips of at least two "
+                     "{}",
+                     conf.gridWidth, conf.gridHeight, conf.shards,
+                     conf.shardVertical ? "columns" : "rows");
+    return 1;
+  }
+  if (mode == "front") {
+    return runFront(conf, layout);
+  }
+  int index = std::stoi(argv[3]);
+  if (index < 0 || index >= conf.shards) {
+    spdlog::critical("Shard index {} out of range", index);
+    return 1;
+  }
+  return runShard(conf, layout, index);
+}
@@ -0,0 +1,452 @@
+#include "sharding.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace cycles_server {
+
+namespace {
+
+void write(sf::Packet &packet, sf::Vector2i position) {
+  packet << position.x << position.y;
+}
+
+bool read(sf::Packet &packet, sf::Vector2i &position) {
+  return static_cast<bool>(packet >> position.x >> position.y);
+}
+
+void write(sf::Packet &packet, Id id) { packet << id; }
+
+bool read(sf::Packet &packet, Id &id) { return static_cast<bool>(packet >> id); }
+
+void write(sf::Packet &packet, const CellWrite &cell) {
+  write(packet, cell.position);
+  packet << cell.value;
+}
+
+bool read(sf::Packet &packet, CellWrite &cell) {
+  return read(packet, cell.position) && packet >> cell.value;
+}
+
+void write(sf::Packet &packet, const Claim &claim) {
+  packet << claim.id;
+  write(packet, claim.target);
+}
+
+bool read(sf::Packet &packet, Claim &claim) {
+  return packet >> claim.id && read(packet, claim.target);
+}
+
+void write(sf::Packet &packet, const CellChange &change) {
+  packet << change.cell << change.before << change.after;
+}
+
+bool read(sf::Packet &packet, CellChange &change) {
+  return static_cast<bool>(packet >> change.cell >> change.before >>
+                           change.after);
+}
+
+void write(sf::Packet &packet, const GameEvent &event) {
+  packet << static_cast<sf::Uint8>(event.type) << event.player
+         << static_cast<sf::Uint8>(event.cause) << event.other << event.frame;
+}
+
+bool read(sf::Packet &packet, GameEvent &event) {
+  sf::Uint8 type, cause;
+  if (!(packet >> type >> event.player >> cause >> event.other >>
+        event.frame)) {
+    return false;
+  }
+  event.type = static_cast<GameEvent::Type>(type);
+  event.cause = static_cast<DeathCause>(cause);
+  return true;
+}
+
+void write(sf::Packet &packet, const std::pair<Id, sf::Vector2i> &head) {
+  packet << head.first;
+  write(packet, head.second);
+}
+
+bool read(sf::Packet &packet, std::pair<Id, sf::Vector2i> &head) {
+  return packet >> head.first && read(packet, head.second);
+}
+
+template <typename T>
+void writeList(sf::Packet &packet, const std::vector<T> &list) {
+  packet << static_cast<sf::Uint32>(list.size());
+  for (const auto &item : list) {
+    write(packet, item);
+  }
+}
+
+// Stops at the first item missing, a bad count can not allocate much
+template <typename T> bool readList(sf::Packet &packet, std::vector<T> &list) {
+  sf::Uint32 count = 0;
+  if (!(packet >> count)) {
+    return false;
+  }
+  list.clear();
+  for (sf::Uint32 i = 0; i < count; i++) {
+    T item{};
+    if (!read(packet, item)) {
+      return false;
+    }
+    list.push_back(std::move(item));
+  }
+  return true;
+}
+
+} // namespace
+
+void write(sf::Packet &packet, const Player &player) {
+  packet << player.id << player.name << player.color.r << player.color.g
+         << player.color.b;
+  write(packet, player.position);
+  packet << static_cast<sf::Uint32>(player.tail.size());
+  for (auto cell : player.tail) {
+    write(packet, cell);
+  }
+}
+
+bool read(sf::Packet &packet, Player &player) {
+  sf::Uint32 count = 0;
+  if (!(packet >> player.id >> player.name >> player.color.r >>
+        player.color.g >> player.color.b) ||
+      !read(packet, player.position) || !(packet >> count)) {
+    return false;
+  }
+  player.tail.clear();
+  for (sf::Uint32 i = 0; i < count; i++) {
+    sf::Vector2i cell;
+    if (!read(packet, cell)) {
+      return false;
+    }
+    player.tail.push_back(cell);
+  }
+  return true;
+}
+
+void write(sf::Packet &packet, const BorderMessage &message) {
+  writeList(packet, message.edge);
+  writeList(packet, message.claims);
+}
+
+bool read(sf::Packet &packet, BorderMessage &message) {
+  return readList(packet, message.edge) && readList(packet, message.claims);
+}
+
+void write(sf::Packet &packet, const TickInput &input) {
+  packet << input.frame << static_cast<sf::Uint32>(input.directions.size());
+  for (const auto &[id, direction] : input.directions) {
+    packet << id << static_cast<sf::Uint8>(direction);
+  }
+  writeList(packet, input.removed);
+  writeList(packet, input.arriving);
+  writeList(packet, input.writes);
+}
+
+bool read(sf::Packet &packet, TickInput &input) {
+  sf::Uint32 count = 0;
+  if (!(packet >> input.frame >> count)) {
+    return false;
+  }
+  input.directions.clear();
+  for (sf::Uint32 i = 0; i < count; i++) {
+    Id id;
+    sf::Uint8 direction;
+    if (!(packet >> id >> direction) || direction > 3) {
+      return false;
+    }
+    input.directions[id] = static_cast<Direction>(direction);
+  }
+  return readList(packet, input.removed) &&
+         readList(packet, input.arriving) && readList(packet, input.writes);
+}
+
+void write(sf::Packet &packet, const TickOutput &output) {
+  writeList(packet, output.events);
+  writeList(packet, output.changes);
+  writeList(packet, output.leaving);
+  writeList(packet, output.remote);
+  writeList(packet, output.heads);
+}
+
+bool read(sf::Packet &packet, TickOutput &output) {
+  return readList(packet, output.events) && readList(packet, output.changes) &&
+         readList(packet, output.leaving) && readList(packet, output.remote) &&
+         readList(packet, output.heads);
+}
+
+int ShardLayout::owner(sf::Vector2i position) const {
+  int shard = (shards * (across(position) + 1) - 1) / span();
+  return std::clamp(shard, 0, shards - 1);
+}
+
+Shard::Shard(ShardLayout layout, int index)
+    : layout(layout), index(index), first(layout.begin(index)),
+      rows(layout.begin(index + 1) - first),
+      grid(layout.length(), rows) {}
+
+void Shard::addPlayer(const Player &player) {
+  players[player.id] = player;
+  grid.at(local(player.position)) = player.id;
+}
+
+void Shard::set(sf::Vector2i position, Id before, Id after,
+                TickOutput &output) {
+  output.changes.push_back(
+      {position.y * layout.width + position.x, before, after});
+  if (owns(position)) {
+    grid.at(local(position)) = after;
+  } else {
+    output.remote.push_back({position, after});
+  }
+}
+
+std::array<std::optional<BorderMessage>, 2>
+Shard::begin(const TickInput &input) {
+  frame = input.frame;
+  // Arrivals first, a player can cross and leave in the same tick
+  for (const auto &player : input.arriving) {
+    players[player.id] = player;
+  }
+  for (const auto &cell : input.writes) {
+    grid.at(local(cell.position)) = cell.value;
+  }
+  for (Id id : input.removed) {
+    players.erase(id);
+    for (int row = 0; row < rows; row++) {
+      for (int i = grid.index(0, row); i < grid.index(layout.length(), row);
+           i++) {
+        if (grid[i] == id) {
+          grid[i] = 0;
+        }
+      }
+    }
+  }
+  moves.clear();
+  for (const auto &[id, direction] : input.directions) {
+    auto it = players.find(id);
+    if (it != players.end()) {
+      moves.push_back({id, it->second.position + getDirectionVector(direction)});
+    }
+  }
+  std::array<std::optional<BorderMessage>, 2> messages;
+  for (int side : {0, 1}) {
+    if (!hasNeighbour(side)) {
+      continue;
+    }
+    // The edge row, and the moves to it or across the border
+    int edge = side == 0 ? 0 : rows - 1;
+    int beyond = side == 0 ? -1 : rows;
+    BorderMessage message;
+    for (int along = 0; along < layout.length(); along++) {
+      message.edge.push_back(grid[grid.index(along, edge)]);
+    }
+    for (const auto &move : moves) {
+      int row = local(move.target).y;
+      if (row == edge || row == beyond) {
+        message.claims.push_back(move);
+      }
+    }
+    messages[side] = std::move(message);
+  }
+  return messages;
+}
+
+TickOutput
+Shard::finish(const std::array<std::optional<BorderMessage>, 2> &neighbours) {
+  TickOutput output;
+  for (int side : {0, 1}) {
+    if (neighbours[side]) {
+      int row = side == 0 ? -1 : rows;
+      const auto &edge = neighbours[side]->edge;
+      for (int along = 0;
+           along < std::min<int>(layout.length(), edge.size()); along++) {
+        grid[grid.index(along, row)] = edge[along];
+      }
+    }
+  }
+  // The two lowest ids moving to each cell, like Game's parallel claims
+  constexpr int none = 256;
+  std::unordered_map<int, std::pair<int, int>> claims;
+  auto claim = [&](const Claim &move) {
+    auto &[lowest, second] =
+        claims.try_emplace(grid.index(local(move.target)), none, none)
+            .first->second;
+    if (move.id < lowest) {
+      second = lowest;
+      lowest = move.id;
+    } else if (move.id < second) {
+      second = move.id;
+    }
+  };
+  for (const auto &move : moves) {
+    claim(move);
+  }
+  for (const auto &neighbour : neighbours) {
+    if (neighbour) {
+      for (const auto &move : neighbour->claims) {
+        claim(move);
+      }
+    }
+  }
+  // Same causes and order as Game::checkCollisions
+  std::vector<GameEvent> deaths;
+  for (const auto &move : moves) {
+    int cell = grid.index(local(move.target));
+    auto [lowest, second] = claims.at(cell);
+    auto die = [&](DeathCause cause, Id other) {
+      deaths.push_back({.type = GameEvent::Type::playerDied,
+                        .player = move.id,
+                        .cause = cause,
+                        .other = other,
+                        .frame = frame});
+    };
+    if (second != none) {
+      die(DeathCause::headOn, static_cast<Id>(lowest == move.id ? second
+                                                                : lowest));
+    } else if (grid[cell] != 0) {
+      bool inside = move.target.x >= 0 && move.target.x < layout.width &&
+                    move.target.y >= 0 && move.target.y < layout.height;
+      if (inside) {
+        die(DeathCause::trail, grid[cell]);
+      } else {
+        die(DeathCause::wall, 0);
+      }
+    }
+  }
+  for (const auto &death : deaths) {
+    output.events.push_back(death);
+    auto &player = players.at(death.player);
+    set(player.position, player.id, 0, output);
+    for (auto cell : player.tail) {
+      set(cell, player.id, 0, output);
+    }
+    players.erase(death.player);
+    output.events.push_back({.type = GameEvent::Type::playerRemoved,
+                             .player = death.player,
+                             .frame = frame});
+  }
+  const std::size_t maxTailLength = 55 + frame / 100;
+  for (const auto &move : moves) {
+    auto it = players.find(move.id);
+    if (it == players.end()) {
+      continue;
+    }
+    auto &player = it->second;
+    set(move.target, 0, player.id, output);
+    if (player.tail.size() > maxTailLength) {
+      set(player.tail.back(), player.id, 0, output);
+      player.tail.pop_back();
+    }
+    player.tail.push_front(player.position);
+    player.position = move.target;
+    if (!owns(move.target)) {
+      output.leaving.push_back(std::move(player));
+      players.erase(it);
+    }
+  }
+  for (const auto &[id, player] : players) {
+    output.heads.emplace_back(id, player.position);
+  }
+  return output;
+}
+
+ShardFront::ShardFront(ShardLayout layout, unsigned seed)
+    : layout(layout), rng(seed != 0 ? seed : std::random_device()()),
+      grid(layout.width * layout.height, 0), next(layout.shards) {}
+
+std::pair<int, Player> ShardFront::addPlayer(const std::string &name) {
+  gameStarted = true;
+  Player newPlayer;
+  newPlayer.name = name;
+  newPlayer.color = playerColor(idCounter);
+  newPlayer.id = idCounter;
+  // Same draws as Game::addPlayer, a seed gives the same spawns
+  std::uniform_real_distribution<float> dist(0, 1.0);
+  auto occupied = [this](sf::Vector2i position) {
+    return position.x >= layout.width || position.y >= layout.height ||
+           grid[position.y * layout.width + position.x] != 0;
+  };
+  do {
+    newPlayer.position.x = layout.width * dist(rng);
+    newPlayer.position.y = layout.height * dist(rng);
+  } while (occupied(newPlayer.position));
+  grid[newPlayer.position.y * layout.width + newPlayer.position.x] =
+      newPlayer.id;
+  players[idCounter] = newPlayer;
+  idCounter++;
+  return {layout.owner(newPlayer.position), newPlayer};
+}
+
+void ShardFront::removePlayer(Id id) {
+  if (players.erase(id) == 0) {
+    return;
+  }
+  std::replace(grid.begin(), grid.end(), id, Id(0));
+  removed.push_back(id);
+  // The frame is set when the tick starts
+  removedEvents.push_back(
+      {.type = GameEvent::Type::playerRemoved, .player = id, .frame = 0});
+}
+
+std::vector<TickInput>
+ShardFront::prepareTick(int frame, const std::map<Id, Direction> &directions) {
+  this->frame = frame;
+  std::vector<TickInput> inputs(layout.shards);
+  std::swap(inputs, next);
+  next.assign(layout.shards, {});
+  for (auto &input : inputs) {
+    input.frame = frame;
+    input.removed = removed;
+  }
+  removed.clear();
+  for (const auto &[id, direction] : directions) {
+    auto it = players.find(id);
+    if (it != players.end()) {
+      inputs[layout.owner(it->second.position)].directions[id] = direction;
+    }
+  }
+  return inputs;
+}
+
+std::vector<GameEvent>
+ShardFront::merge(const std::vector<TickOutput> &outputs) {
+  // Players removed before the moves come first, then the deaths by id
+  std::vector<GameEvent> events;
+  for (auto event : removedEvents) {
+    event.frame = frame;
+    events.push_back(event);
+  }
+  removedEvents.clear();
+  std::vector<GameEvent> deaths;
+  for (const auto &output : outputs) {
+    for (const auto &change : output.changes) {
+      grid[change.cell] = change.after;
+    }
+    for (const auto &player : output.leaving) {
+      next[layout.owner(player.position)].arriving.push_back(player);
+      players[player.id].position = player.position;
+    }
+    for (const auto &cell : output.remote) {
+      next[layout.owner(cell.position)].writes.push_back(cell);
+    }
+    for (const auto &[id, position] : output.heads) {
+      players[id].position = position;
+    }
+    deaths.insert(deaths.end(), output.events.begin(), output.events.end());
+  }
+  std::stable_sort(deaths.begin(), deaths.end(),
+                   [](const auto &a, const auto &b) {
+                     return a.player < b.player;
+                   });
+  for (const auto &event : deaths) {
+    if (event.type == GameEvent::Type::playerRemoved) {
+      players.erase(event.player);
+    }
+    events.push_back(event);
+  }
+  return events;
+}
+
+} // namespace cycles_server
@@ -0,0 +1,188 @@
+#pragma once
+#include "game_logic.h"
+#include <SFML/Network.hpp>
+#include <array>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// Sharded mode: the board is cut into strips, each owned by a shard process
+// that moves the players whose head is in it. A tick runs as:
+//   front end -> shards: moves, arrivals and writes routed from the last tick
+//   shard <-> neighbours: edge row and the moves that target the border
+//   shards -> front end: cell changes, events, leaving players, remote writes
+// Moves are one cell, so the edge row of each neighbour and its moves next to
+// the border are all a shard needs to apply the rules of Game::movePlayers
+// exactly. Cells written in another strip (a player crossing the border, the
+// tail of a dead player) are routed to their owner and applied before the
+// next tick reads them.
+
+// How the board is cut: strips of whole rows, or of whole columns when
+// vertical. "Along" runs with the strip, "across" from one strip to the next.
+struct ShardLayout {
+  int width = 0;
+  int height = 0;
+  int shards = 1;
+  bool vertical = false;
+
+  int along(sf::Vector2i position) const {
+    return vertical ? position.y : position.x;
+  }
+
+  int across(sf::Vector2i position) const {
+    return vertical ? position.x : position.y;
+  }
+
+  int length() const { return vertical ? height : width; }
+
+  int span() const { return vertical ? width : height; }
+
+  // First row (or column) of a strip, begin(shards) is the end of the board
+  int begin(int shard) const { return span() * shard / shards; }
+
+  // Shard that owns a cell of the board
+  int owner(sf::Vector2i position) const;
+
+  // Strips need two rows so only neighbours can claim the same cell
+  bool valid() const {
+    return shards >= 1 && width > 0 && height > 0 && span() >= 2 * shards;
+  }
+};
+
+// A cell written by one shard in the strip of another, position is global
+struct CellWrite {
+  sf::Vector2i position;
+  Id value;
+};
+
+// A move towards a cell next to the border
+struct Claim {
+  Id id;
+  sf::Vector2i target;
+};
+
+// What a shard sends each neighbour before moving
+struct BorderMessage {
+  std::vector<Id> edge; // Its row (or column) next to the neighbour
+  std::vector<Claim> claims;
+};
+
+// Front end to shard, once per tick
+struct TickInput {
+  int frame = 0;
+  std::map<Id, Direction> directions; // Of the players the shard owns
+  std::vector<Id> removed;            // Players that left, any shard
+  std::vector<Player> arriving;       // Players that crossed into the strip
+  std::vector<CellWrite> writes;      // Cells of the strip changed elsewhere
+};
+
+// Shard to front end, once per tick
+struct TickOutput {
+  std::vector<GameEvent> events;
+  std::vector<CellChange> changes; // Every cell the shard wrote, global index
+  std::vector<Player> leaving;     // Players now owned by another shard
+  std::vector<CellWrite> remote;   // Cells of other strips to route
+  std::vector<std::pair<Id, sf::Vector2i>> heads; // Players it still owns
+};
+
+void write(sf::Packet &packet, const Player &player);
+bool read(sf::Packet &packet, Player &player);
+void write(sf::Packet &packet, const BorderMessage &message);
+bool read(sf::Packet &packet, BorderMessage &message);
+void write(sf::Packet &packet, const TickInput &input);
+bool read(sf::Packet &packet, TickInput &input);
+void write(sf::Packet &packet, const TickOutput &output);
+bool read(sf::Packet &packet, TickOutput &output);
+
+// One strip of the board and the players whose head is in it
+class Shard {
+  ShardLayout layout;
+  int index;
+  int first; // First row (or column) of the strip
+  int rows;
+  // The strip in local coordinates (along, across - first). The padding
+  // rows hold the edges of the neighbours, or walls at the board border.
+  PaddedGrid grid;
+  std::map<Id, Player> players;
+  int frame = 0;
+  std::vector<Claim> moves;
+
+  sf::Vector2i local(sf::Vector2i position) const {
+    return {layout.along(position), layout.across(position) - first};
+  }
+
+  bool owns(sf::Vector2i position) const {
+    int row = layout.across(position) - first;
+    return row >= 0 && row < rows && layout.along(position) >= 0 &&
+           layout.along(position) < layout.length();
+  }
+
+  // Write a cell of the strip, or queue it for its owner
+  void set(sf::Vector2i position, Id before, Id after, TickOutput &output);
+
+public:
+  Shard(ShardLayout layout, int index);
+
+  int getIndex() const { return index; }
+
+  bool hasNeighbour(int side) const {
+    return side == 0 ? index > 0 : index + 1 < layout.shards;
+  }
+
+  // A player that spawned in the strip
+  void addPlayer(const Player &player);
+
+  // Apply what the other shards changed, then compute the moves. Returns
+  // the messages for the neighbour before (0) and after (1) the strip.
+  std::array<std::optional<BorderMessage>, 2> begin(const TickInput &input);
+
+  // Move the players once the neighbours' messages arrived
+  TickOutput finish(
+      const std::array<std::optional<BorderMessage>, 2> &neighbours);
+};
+
+// The front end's view of a sharded game: spawns the players like
+// Game::addPlayer, splits the moves between the shards, routes what crosses
+// strips and merges the results into the grid and players sent to the
+// clients.
+class ShardFront {
+  ShardLayout layout;
+  std::mt19937 rng;
+  Id idCounter = 1;
+  bool gameStarted = false;
+  std::vector<Id> grid; // Row-major, like Game::getGrid
+  std::map<Id, Player> players; // Without tails
+  std::vector<Id> removed;
+  std::vector<GameEvent> removedEvents;
+  std::vector<TickInput> next; // Routed from the last tick
+  int frame = 0;
+
+public:
+  ShardFront(ShardLayout layout, unsigned seed);
+
+  // Spawn a player, it must be added to the shard returned
+  std::pair<int, Player> addPlayer(const std::string &name);
+
+  // The player leaves at the next tick
+  void removePlayer(Id id);
+
+  // Inputs of the next tick, one per shard
+  std::vector<TickInput> prepareTick(int frame,
+                                     const std::map<Id, Direction> &directions);
+
+  // Apply the outputs of a tick, one per shard. Returns the events of the
+  // tick in the order Game emits them.
+  std::vector<GameEvent> merge(const std::vector<TickOutput> &outputs);
+
+  const std::vector<Id> &getGrid() const { return grid; }
+
+  const std::map<Id, Player> &getPlayers() const { return players; }
+
+  bool isGameOver() const { return gameStarted && players.size() <= 1; }
+};
+
+} // namespace cycles_server
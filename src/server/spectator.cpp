@@ -0,0 +1,153 @@
+#include "spectator.h"
+#include "logging.h"
+#include "thread_placement.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace cycles_server {
+
+SpectatorBroadcaster::SpectatorBroadcaster(const Configuration &conf,
+                                           std::shared_ptr<EventQueue> events)
+    : conf(conf), events(events),
+      encoder(conf.gridWidth, conf.gridHeight,
+              conf.spectatorKeyframeInterval) {
+  if (conf.spectatorPort != 0) {
+    if (listener.listen(conf.spectatorPort) != sf::Socket::Done) {
+      spdlog::error("Failed to listen for spectators on port {}",
+                    conf.spectatorPort);
+    } else {
+      spdlog::info("Listening for spectators on port {}", conf.spectatorPort);
+      listening = true;
+    }
+    listener.setBlocking(false);
+  }
+  if (!conf.replayFile.empty()) {
+    replay.open(conf.replayFile, std::ios::binary);
+    if (!replay) {
+      spdlog::error("Failed to open the replay file {}", conf.replayFile);
+    } else {
+      writeReplayHeader(replay);
+      spdlog::info("Recording the game to {}", conf.replayFile);
+    }
+  }
+  thread = std::thread(&SpectatorBroadcaster::run, this);
+}
+
+SpectatorBroadcaster::~SpectatorBroadcaster() {
+  {
+    std::scoped_lock lock(mutex);
+    running = false;
+  }
+  wakeUp.notify_one();
+  thread.join();
+}
+
+void SpectatorBroadcaster::publish(
+    std::shared_ptr<const GameSnapshot> snapshot) {
+  Published published{std::move(snapshot), {}};
+  GameEvent event;
+  while (events->pop(event)) {
+    published.events.push_back(event);
+  }
+  {
+    std::scoped_lock lock(mutex);
+    pending.push_back(std::move(published));
+    const auto maxPending =
+        static_cast<std::size_t>(std::max(1, conf.spectatorKeyframeInterval));
+    while (pending.size() > maxPending) {
+      auto &next = pending[1].events;
+      next.insert(next.begin(), pending.front().events.begin(),
+                  pending.front().events.end());
+      pending.pop_front();
+    }
+  }
+  wakeUp.notify_one();
+}
+
+void SpectatorBroadcaster::run() {
+  placeThread("spectator", conf.backgroundCpus);
+  // Wake up now and then to accept spectators and finish partial sends
+  constexpr auto pollPeriod = std::chrono::milliseconds(5);
+  std::deque<Published> snapshots;
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      wakeUp.wait_for(lock, pollPeriod,
+                      [this] { return !pending.empty() || !running; });
+      if (!running && pending.empty()) {
+        break;
+      }
+      std::swap(snapshots, pending);
+    }
+    acceptSpectators();
+    for (const auto &published : snapshots) {
+      encode(published);
+    }
+    snapshots.clear();
+    std::erase_if(spectators,
+                  [this](Spectator &spectator) { return !flush(spectator); });
+  }
+  // Give the spectators a moment to receive the end of the game
+  sf::Clock drainClock;
+  while (!spectators.empty() && drainClock.getElapsedTime() < sf::seconds(1)) {
+    std::erase_if(spectators, [this](Spectator &spectator) {
+      return !flush(spectator) || spectator.backlog.queue.empty();
+    });
+    std::this_thread::sleep_for(pollPeriod);
+  }
+  replay.close();
+}
+
+void SpectatorBroadcaster::acceptSpectators() {
+  while (listening) {
+    auto socket = std::make_unique<sf::TcpSocket>();
+    if (listener.accept(*socket) != sf::Socket::Done) {
+      return;
+    }
+    socket->setBlocking(false);
+    spdlog::info("Spectator connected from {}",
+                 socket->getRemoteAddress().toString());
+    spectators.push_back({std::move(socket), {}});
+    spectators.back().backlog.catchUp(encoder.getHistory());
+  }
+}
+
+void SpectatorBroadcaster::encode(const Published &published) {
+  auto message = encoder.encode(published.snapshot, published.events);
+  if (replay.is_open()) {
+    replay.write(message->data(), message->size());
+  }
+  const auto maxBacklog =
+      static_cast<std::size_t>(2 * conf.spectatorKeyframeInterval);
+  for (auto &spectator : spectators) {
+    if (spectator.backlog.queue.size() > maxBacklog) {
+      CYCLES_HOT_DEBUG("Spectator lagging, skipping to the latest keyframe");
+    }
+    spectator.backlog.push(message, encoder.getHistory(), maxBacklog);
+  }
+}
+
+bool SpectatorBroadcaster::flush(Spectator &spectator) {
+  auto &backlog = spectator.backlog;
+  while (!backlog.queue.empty()) {
+    const auto &message = *backlog.queue.front();
+    std::size_t sent = 0;
+    auto status = spectator.socket->send(message.data() + backlog.sent,
+                                         message.size() - backlog.sent, sent);
+    backlog.sent += sent;
+    if (status == sf::Socket::Done ||
+        (status == sf::Socket::Partial && backlog.sent == message.size())) {
+      backlog.queue.pop_front();
+      backlog.sent = 0;
+    } else if (status == sf::Socket::Partial ||
+               status == sf::Socket::NotReady) {
+      return true;
+    } else {
+      spdlog::info("Spectator disconnected");
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace cycles_server
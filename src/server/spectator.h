@@ -0,0 +1,71 @@
+#pragma once
+#include "game_logic.h"
+#include "spectator_stream.h"
+#include <SFML/Network.hpp>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cycles_server {
+
+// Streams the game to any number of spectators from its own thread. The game
+// loop only hands over the snapshots it already publishes for the renderer,
+// so spectators never slow the players down.
+class SpectatorBroadcaster {
+  struct Spectator {
+    std::unique_ptr<sf::TcpSocket> socket;
+    SpectatorBacklog backlog;
+  };
+
+  // A snapshot and the events of the game since the previous one
+  struct Published {
+    std::shared_ptr<const GameSnapshot> snapshot;
+    std::vector<GameEvent> events;
+  };
+
+  const Configuration conf;
+  std::shared_ptr<EventQueue> events;
+  sf::TcpListener listener;
+  bool listening = false;
+  std::vector<Spectator> spectators;
+  // Gets every message encoded: every frame, unless the encoder fell a
+  // keyframe interval behind and publish dropped some
+  std::ofstream replay;
+  StreamEncoder encoder;
+
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::deque<Published> pending; // Snapshots not encoded yet, oldest first
+  bool running = true;
+  std::thread thread;
+
+  void run();
+
+  void acceptSpectators();
+
+  void encode(const Published &published);
+
+  // False if the spectator disconnected
+  bool flush(Spectator &spectator);
+
+public:
+  // Listen on conf.spectatorPort and record to conf.replayFile when set,
+  // events is a queue subscribed to the game that publish reads
+  SpectatorBroadcaster(const Configuration &conf,
+                       std::shared_ptr<EventQueue> events);
+
+  ~SpectatorBroadcaster();
+
+  // Called once per frame while the game does not change, never blocks on
+  // the spectators. Snapshots are encoded in order with the events that
+  // happened before them. When the encoder falls a keyframe interval
+  // behind the oldest ones are dropped, their events go with the next
+  // snapshot and the next message is a keyframe.
+  void publish(std::shared_ptr<const GameSnapshot> snapshot);
+};
+
+} // namespace cycles_server
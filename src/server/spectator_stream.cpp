@@ -0,0 +1,356 @@
+#include "spectator_stream.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+namespace cycles_server {
+
+namespace detail {
+
+// Direction of the step between two adjacent cells
+sf::Uint8 stepBetween(sf::Vector2i from, sf::Vector2i to) {
+  auto diff = to - from;
+  for (sf::Uint8 step = 0; step < 4; step++) {
+    if (diff == cycles::getDirectionVector(static_cast<Direction>(step))) {
+      return step;
+    }
+  }
+  return noStep;
+}
+
+sf::Vector2i applyStep(sf::Vector2i from, sf::Uint8 step) {
+  return from + cycles::getDirectionVector(static_cast<Direction>(step));
+}
+
+void encodeEvents(sf::Packet &packet, const std::vector<GameEvent> &events) {
+  packet << static_cast<sf::Uint16>(events.size());
+  for (const auto &event : events) {
+    packet << static_cast<sf::Uint8>(event.type) << event.player
+           << static_cast<sf::Uint8>(event.cause) << event.other
+           << static_cast<sf::Int32>(event.frame);
+  }
+}
+
+bool decodeEvents(sf::Packet &packet, std::vector<GameEvent> &events) {
+  sf::Uint16 count = 0;
+  packet >> count;
+  for (sf::Uint16 i = 0; i < count && packet; i++) {
+    sf::Uint8 type = 0, cause = 0;
+    sf::Int32 frame = 0;
+    GameEvent event;
+    packet >> type >> event.player >> cause >> event.other >> frame;
+    event.type = static_cast<GameEvent::Type>(type);
+    event.cause = static_cast<DeathCause>(cause);
+    event.frame = frame;
+    events.push_back(event);
+  }
+  return static_cast<bool>(packet);
+}
+
+sf::Uint16 encodeLatency(const GameSnapshot &game, Id id) {
+  auto it = game.latencies.find(id);
+  if (it == game.latencies.end()) {
+    return noLatency;
+  }
+  auto tenths = it->second.asMicroseconds() / 100;
+  return static_cast<sf::Uint16>(std::clamp<sf::Int64>(tenths, 0, noLatency - 1));
+}
+
+void decodeLatency(GameSnapshot &game, Id id, sf::Uint16 latency) {
+  if (latency != noLatency) {
+    game.latencies[id] = sf::microseconds(latency * 100);
+  }
+}
+
+// Same framing as sf::Packet: the size in network byte order then the data
+FramedMessage frameMessage(const sf::Packet &packet) {
+  auto size = static_cast<sf::Uint32>(packet.getDataSize());
+  auto message = std::make_shared<std::vector<char>>(sizeof(size) + size);
+  for (int i = 0; i < 4; i++) {
+    (*message)[i] = static_cast<char>((size >> (24 - 8 * i)) & 0xff);
+  }
+  if (size > 0) {
+    std::memcpy(message->data() + sizeof(size), packet.getData(), size);
+  }
+  return message;
+}
+
+void rebuildGrid(GameSnapshot &game, int width, int height) {
+  game.grid.assign(width * height, 0);
+  auto set = [&](sf::Vector2i cell, Id id) {
+    if (cell.x >= 0 && cell.x < width && cell.y >= 0 && cell.y < height) {
+      game.grid[cell.y * width + cell.x] = id;
+    }
+  };
+  for (const auto &[id, player] : game.players) {
+    set(player.position, id);
+    for (auto cell : player.tail) {
+      set(cell, id);
+    }
+  }
+}
+
+} // namespace detail
+
+void encodeKeyframe(sf::Packet &packet, const GameSnapshot &game, int width,
+                    int height, const std::vector<GameEvent> &events) {
+  packet << static_cast<sf::Uint8>(StreamMessage::keyframe)
+         << static_cast<sf::Int32>(game.frame) << game.gameOver
+         << static_cast<sf::Uint16>(width) << static_cast<sf::Uint16>(height)
+         << static_cast<sf::Uint16>(game.players.size());
+  for (const auto &[id, player] : game.players) {
+    packet << id << player.name << player.color.r << player.color.g
+           << player.color.b << static_cast<sf::Uint16>(player.position.x)
+           << static_cast<sf::Uint16>(player.position.y)
+           << static_cast<sf::Uint16>(player.tail.size())
+           << detail::encodeLatency(game, id);
+    // Four steps per byte
+    sf::Uint8 packed = 0;
+    int count = 0;
+    auto previous = player.position;
+    for (auto cell : player.tail) {
+      packed |= (detail::stepBetween(previous, cell) & 3) << (2 * count);
+      previous = cell;
+      if (++count == 4) {
+        packet << packed;
+        packed = 0;
+        count = 0;
+      }
+    }
+    if (count > 0) {
+      packet << packed;
+    }
+  }
+  detail::encodeEvents(packet, events);
+}
+
+bool encodeDelta(sf::Packet &packet, const GameSnapshot &previous,
+                 const GameSnapshot &current,
+                 const std::vector<GameEvent> &events) {
+  if (current.frame != previous.frame + 1) {
+    return false;
+  }
+  for (const auto &[id, player] : current.players) {
+    auto it = previous.players.find(id);
+    if (it == previous.players.end()) {
+      return false;
+    }
+    const auto &before = it->second;
+    if (player.position != before.position &&
+        detail::stepBetween(before.position, player.position) == noStep) {
+      return false;
+    }
+  }
+  packet << static_cast<sf::Uint8>(StreamMessage::delta)
+         << static_cast<sf::Int32>(current.frame) << current.gameOver
+         << static_cast<sf::Uint16>(current.players.size());
+  for (const auto &[id, player] : current.players) {
+    const auto &before = previous.players.at(id);
+    sf::Uint8 step = noStep;
+    sf::Uint16 trimmed = 0;
+    if (player.position != before.position) {
+      step = detail::stepBetween(before.position, player.position);
+      trimmed = before.tail.size() + 1 - player.tail.size();
+    }
+    packet << id << step << trimmed << detail::encodeLatency(current, id);
+  }
+  std::vector<Id> removed;
+  for (const auto &[id, player] : previous.players) {
+    if (current.players.find(id) == current.players.end()) {
+      removed.push_back(id);
+    }
+  }
+  packet << static_cast<sf::Uint16>(removed.size());
+  for (auto id : removed) {
+    packet << id;
+  }
+  detail::encodeEvents(packet, events);
+  return true;
+}
+
+FramedMessage StreamEncoder::encode(std::shared_ptr<const GameSnapshot> snapshot,
+                                    const std::vector<GameEvent> &events) {
+  sf::Packet packet;
+  bool isDelta = lastEncoded && framesSinceKeyframe + 1 < keyframeInterval &&
+                 encodeDelta(packet, *lastEncoded, *snapshot, events);
+  FramedMessage message;
+  if (isDelta) {
+    message = detail::frameMessage(packet);
+    history.deltas.push_back(message);
+    framesSinceKeyframe++;
+  } else {
+    packet.clear();
+    encodeKeyframe(packet, *snapshot, width, height, events);
+    message = detail::frameMessage(packet);
+    history.keyframe = message;
+    history.deltas.clear();
+    framesSinceKeyframe = 0;
+  }
+  lastEncoded = std::move(snapshot);
+  return message;
+}
+
+void SpectatorBacklog::catchUp(const StreamHistory &history) {
+  // A message partially sent must be completed to keep the stream framed
+  queue.resize(sent > 0 ? 1 : 0);
+  if (history.keyframe) {
+    queue.push_back(history.keyframe);
+    queue.insert(queue.end(), history.deltas.begin(), history.deltas.end());
+  }
+}
+
+void SpectatorBacklog::push(const FramedMessage &message,
+                            const StreamHistory &history,
+                            std::size_t maxLength) {
+  if (queue.size() > maxLength) {
+    catchUp(history);
+    return;
+  }
+  queue.push_back(message);
+}
+
+void writeReplayHeader(std::ostream &out) {
+  char header[replayHeaderSize + 1];
+  std::snprintf(header, sizeof(header), "CYCRPL%02d", replayVersion);
+  out.write(header, replayHeaderSize);
+}
+
+int readReplayVersion(const char *header) {
+  if (std::memcmp(header, "CYCRPL", 6) != 0 ||
+      !std::isdigit(static_cast<unsigned char>(header[6])) ||
+      !std::isdigit(static_cast<unsigned char>(header[7]))) {
+    return -1;
+  }
+  return (header[6] - '0') * 10 + header[7] - '0';
+}
+
+bool readMessage(std::istream &in, sf::Packet &packet) {
+  unsigned char header[4];
+  if (!in.read(reinterpret_cast<char *>(header), sizeof(header))) {
+    return false;
+  }
+  std::size_t size = (std::size_t(header[0]) << 24) |
+                     (std::size_t(header[1]) << 16) |
+                     (std::size_t(header[2]) << 8) | header[3];
+  std::vector<char> data(size);
+  if (!in.read(data.data(), size)) {
+    return false;
+  }
+  packet.clear();
+  packet.append(data.data(), size);
+  return true;
+}
+
+bool StreamDecoder::apply(sf::Packet &packet, std::vector<GameEvent> &events) {
+  sf::Uint8 kind = 0;
+  sf::Int32 frame = 0;
+  bool gameOver = false;
+  if (!(packet >> kind >> frame >> gameOver)) {
+    return false;
+  }
+  if (kind == static_cast<sf::Uint8>(StreamMessage::keyframe)) {
+    GameSnapshot next;
+    next.frame = frame;
+    next.gameOver = gameOver;
+    sf::Uint16 newWidth = 0, newHeight = 0, count = 0;
+    packet >> newWidth >> newHeight >> count;
+    for (sf::Uint16 i = 0; i < count && packet; i++) {
+      Player player;
+      sf::Uint16 x = 0, y = 0, tailLength = 0, latency = noLatency;
+      packet >> player.id >> player.name >> player.color.r >> player.color.g >>
+          player.color.b >> x >> y >> tailLength >> latency;
+      detail::decodeLatency(next, player.id, latency);
+      player.position = {x, y};
+      auto cell = player.position;
+      sf::Uint8 packed = 0;
+      for (int j = 0; j < tailLength; j++) {
+        if (j % 4 == 0) {
+          packet >> packed;
+        }
+        cell = detail::applyStep(cell, (packed >> (2 * (j % 4))) & 3);
+        player.tail.push_back(cell);
+      }
+      next.players[player.id] = std::move(player);
+    }
+    if (!detail::decodeEvents(packet, events)) {
+      return false;
+    }
+    width = newWidth;
+    height = newHeight;
+    detail::rebuildGrid(next, width, height);
+    game = std::move(next);
+    synced = true;
+    return true;
+  }
+  if (kind != static_cast<sf::Uint8>(StreamMessage::delta) || !synced) {
+    return false;
+  }
+  // Parse everything before touching the game
+  struct Move {
+    Id id;
+    sf::Uint8 step;
+    sf::Uint16 trimmed;
+    sf::Uint16 latency;
+  };
+  std::vector<Move> moves;
+  std::vector<Id> removed;
+  sf::Uint16 count = 0;
+  packet >> count;
+  for (sf::Uint16 i = 0; i < count && packet; i++) {
+    Move move{};
+    packet >> move.id >> move.step >> move.trimmed >> move.latency;
+    moves.push_back(move);
+  }
+  packet >> count;
+  for (sf::Uint16 i = 0; i < count && packet; i++) {
+    Id id = 0;
+    packet >> id;
+    removed.push_back(id);
+  }
+  std::vector<GameEvent> newEvents;
+  if (!detail::decodeEvents(packet, newEvents)) {
+    return false;
+  }
+  // Positions come from the network, never write outside the grid
+  auto setCell = [this](sf::Vector2i position, Id id) {
+    if (position.x >= 0 && position.x < width && position.y >= 0 &&
+        position.y < height) {
+      game.grid[position.y * width + position.x] = id;
+    }
+  };
+  for (auto id : removed) {
+    auto it = game.players.find(id);
+    if (it == game.players.end()) {
+      continue;
+    }
+    setCell(it->second.position, 0);
+    for (auto tail : it->second.tail) {
+      setCell(tail, 0);
+    }
+    game.players.erase(it);
+  }
+  game.latencies.clear();
+  for (const auto &move : moves) {
+    detail::decodeLatency(game, move.id, move.latency);
+    auto it = game.players.find(move.id);
+    if (it == game.players.end() || move.step >= noStep) {
+      continue;
+    }
+    auto &player = it->second;
+    for (int i = 0; i < move.trimmed && !player.tail.empty(); i++) {
+      setCell(player.tail.back(), 0);
+      player.tail.pop_back();
+    }
+    player.tail.push_front(player.position);
+    player.position = detail::applyStep(player.position, move.step);
+    setCell(player.position, move.id);
+  }
+  game.frame = frame;
+  game.gameOver = gameOver;
+  events.insert(events.end(), newEvents.begin(), newEvents.end());
+  return true;
+}
+
+} // namespace cycles_server
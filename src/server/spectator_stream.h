@@ -0,0 +1,121 @@
+#pragma once
+#include "game_logic.h"
+#include <SFML/Network.hpp>
+#include <deque>
+#include <istream>
+#include <ostream>
+#include <memory>
+#include <vector>
+
+namespace cycles_server {
+
+// Spectator stream: a keyframe with the whole game followed by one delta per
+// frame. Tails are sent as the chain of steps from the head, 2 bits per cell,
+// deltas as one step and the number of tail cells trimmed per player.
+// Each player also carries its response time to the previous frame.
+// The game events since the previous message travel with each message.
+enum class StreamMessage : sf::Uint8 { keyframe, delta };
+
+// Step of a delta when the player did not move
+constexpr sf::Uint8 noStep = 4;
+
+// Latencies travel in tenths of a millisecond, this one means no answer
+constexpr sf::Uint16 noLatency = 0xffff;
+
+// Append a keyframe of the game to packet
+void encodeKeyframe(sf::Packet &packet, const GameSnapshot &game, int width,
+                    int height, const std::vector<GameEvent> &events);
+
+// Append the changes from previous to current, false if they can not be
+// encoded as a delta (frames not consecutive or new players) and a
+// keyframe must be sent instead
+bool encodeDelta(sf::Packet &packet, const GameSnapshot &previous,
+                 const GameSnapshot &current,
+                 const std::vector<GameEvent> &events);
+
+// A recording starts with "CYCRPL" and the version of the stream format as
+// two digits, bumped whenever a message changes. Version 1 has latencies.
+constexpr int replayVersion = 1;
+constexpr std::size_t replayHeaderSize = 8;
+
+void writeReplayHeader(std::ostream &out);
+
+// Version from the first replayHeaderSize bytes of a recording, -1 if they
+// are not a replay header
+int readReplayVersion(const char *header);
+
+// Read the next message of a recorded stream, framed as sf::Packet does.
+// False at the end of the stream.
+bool readMessage(std::istream &in, sf::Packet &packet);
+
+// A message framed for the wire, shared by every spectator it goes to
+using FramedMessage = std::shared_ptr<const std::vector<char>>;
+
+// The latest keyframe and the deltas after it, what a spectator needs to
+// join the stream
+struct StreamHistory {
+  FramedMessage keyframe;
+  std::vector<FramedMessage> deltas;
+};
+
+// Turns the snapshots of a game into the messages of a stream: deltas
+// between consecutive frames, a keyframe every keyframeInterval frames and
+// after a gap
+class StreamEncoder {
+  int width;
+  int height;
+  int keyframeInterval;
+  StreamHistory history;
+  std::shared_ptr<const GameSnapshot> lastEncoded;
+  int framesSinceKeyframe = 0;
+
+public:
+  StreamEncoder(int width, int height, int keyframeInterval)
+      : width(width), height(height), keyframeInterval(keyframeInterval) {}
+
+  // The message for the next snapshot, framed as sf::Packet does, with the
+  // events since the previous one
+  FramedMessage encode(std::shared_ptr<const GameSnapshot> snapshot,
+                       const std::vector<GameEvent> &events);
+
+  const StreamHistory &getHistory() const { return history; }
+};
+
+// Messages waiting to be sent to one spectator
+struct SpectatorBacklog {
+  std::deque<FramedMessage> queue;
+  std::size_t sent = 0; // Bytes of queue.front() already sent
+
+  // Replace the messages not started yet with the history
+  void catchUp(const StreamHistory &history);
+
+  // Queue the latest message, already in history. A spectator with more
+  // than maxLength messages waiting can not keep up and skips to the
+  // latest keyframe instead.
+  void push(const FramedMessage &message, const StreamHistory &history,
+            std::size_t maxLength);
+};
+
+// Rebuilds the game from the messages of a stream
+class StreamDecoder {
+  GameSnapshot game;
+  int width = 0;
+  int height = 0;
+  bool synced = false; // A keyframe was applied
+
+public:
+  // Apply the next message, the events it carries are appended to events.
+  // Returns false if the message is malformed or a delta arrives before the
+  // first keyframe, the state is then unchanged until the next keyframe.
+  bool apply(sf::Packet &packet, std::vector<GameEvent> &events);
+
+  const GameSnapshot &getSnapshot() const { return game; }
+
+  bool hasKeyframe() const { return synced; }
+
+  int getGridWidth() const { return width; }
+
+  int getGridHeight() const { return height; }
+};
+
+} // namespace cycles_server
@@ -0,0 +1,76 @@
+#include "thread_placement.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace cycles_server {
+
+bool pinThread(const std::vector<int> &cpus) {
+#if defined(_WIN32)
+  DWORD_PTR mask = 0;
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < 64) {
+      mask |= DWORD_PTR(1) << cpu;
+    }
+  }
+  return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+bool raiseThreadPriority(int priority) {
+#ifdef _WIN32
+  return SetThreadPriority(GetCurrentThread(),
+                           priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL
+                                          : THREAD_PRIORITY_HIGHEST) != 0;
+#else
+  // Round robin rather than FIFO so threads at the same priority share a core
+  sched_param param{};
+  param.sched_priority =
+      std::clamp(priority, sched_get_priority_min(SCHED_RR),
+                 sched_get_priority_max(SCHED_RR));
+  return pthread_setschedparam(pthread_self(), SCHED_RR, &param) == 0;
+#endif
+}
+
+void placeThread(const std::string &name, const std::vector<int> &cpus,
+                 int priority) {
+  if (!cpus.empty()) {
+    std::string list;
+    for (int cpu : cpus) {
+      list += (list.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    if (pinThread(cpus)) {
+      spdlog::info("Thread {} pinned to cpus {}", name, list);
+    } else {
+      spdlog::warn("Failed to pin thread {} to cpus {}", name, list);
+    }
+  }
+  if (priority > 0) {
+    if (raiseThreadPriority(priority)) {
+      spdlog::info("Thread {} runs at real-time priority {}", name, priority);
+    } else {
+      spdlog::warn("Thread {} keeps its normal priority, real-time "
+                   "scheduling needs privileges (CAP_SYS_NICE on Linux)",
+                   name);
+    }
+  }
+}
+
+} // namespace cycles_server
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// Pin the calling thread to cpus, false if the system refused or can not pin
+// threads (macOS)
+bool pinThread(const std::vector<int> &cpus);
+
+// Real-time round robin scheduling at priority (1-99) for the calling thread,
+// false if refused
+bool raiseThreadPriority(int priority);
+
+// Both of the above with logs: cpus empty leaves the affinity alone and
+// priority 0 the scheduling. When the system refuses, a warning is logged and
+// the thread keeps its previous settings.
+void placeThread(const std::string &name, const std::vector<int> &cpus,
+                 int priority = 0);
+
+} // namespace cycles_server
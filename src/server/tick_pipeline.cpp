@@ -0,0 +1,82 @@
+#include "tick_pipeline.h"
+#include "logging.h"
+
+namespace cycles_server {
+
+TickPipeline::TickPipeline(int threads, std::function<void()> onStart) {
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back([this, onStart] {
+      if (onStart) {
+        onStart();
+      }
+      work();
+    });
+  }
+}
+
+TickPipeline::~TickPipeline() {
+  {
+    std::scoped_lock lock(mutex);
+    stopping = true;
+  }
+  jobAvailable.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void TickPipeline::submit(std::function<void()> job) {
+  if (workers.empty()) {
+    job();
+    return;
+  }
+  {
+    std::scoped_lock lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  jobAvailable.notify_one();
+}
+
+void TickPipeline::wait() {
+  std::unique_lock lock(mutex);
+  idle.wait(lock, [this] { return jobs.empty() && running == 0; });
+}
+
+void TickPipeline::work() {
+  std::unique_lock lock(mutex);
+  while (true) {
+    jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+    if (jobs.empty()) {
+      return;
+    }
+    auto job = std::move(jobs.front());
+    jobs.pop_front();
+    running++;
+    lock.unlock();
+    job();
+    lock.lock();
+    running--;
+    if (jobs.empty() && running == 0) {
+      idle.notify_all();
+    }
+  }
+}
+
+void TickStats::report(int frame, int interval) const {
+  if (frame == 0 || frame % interval != 0 || criticalPath.empty()) {
+    return;
+  }
+  spdlog::info("Server ({}): critical path p50 {} us p99 {} us, tick p50 {} "
+               "us p99 {} us, jitter p50 {} us p99 {} us max {} us, {} log "
+               "messages dropped",
+               frame, criticalPath.percentile(50).asMicroseconds(),
+               criticalPath.percentile(99).asMicroseconds(),
+               tickDuration.percentile(50).asMicroseconds(),
+               tickDuration.percentile(99).asMicroseconds(),
+               tickJitter.percentile(50).asMicroseconds(),
+               tickJitter.percentile(99).asMicroseconds(),
+               tickJitter.percentile(100).asMicroseconds(),
+               getDroppedLogMessages());
+}
+
+} // namespace cycles_server
@@ -0,0 +1,48 @@
+#pragma once
+#include "tick_rate.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cycles_server {
+
+// Helper threads for the work of a tick that is off the critical path
+// (serializing the next frame, publishing snapshots, bookkeeping).
+// With zero threads jobs run inline when submitted. Each helper thread calls
+// onStart before taking its first job.
+class TickPipeline {
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> jobs;
+  std::mutex mutex;
+  std::condition_variable jobAvailable;
+  std::condition_variable idle;
+  int running = 0;
+  bool stopping = false;
+
+  void work();
+
+public:
+  TickPipeline(int threads, std::function<void()> onStart = {});
+
+  ~TickPipeline();
+
+  void submit(std::function<void()> job);
+
+  // Block until all submitted jobs have finished
+  void wait();
+};
+
+// Timing of the tick loop
+struct TickStats {
+  LatencyWindow criticalPath; ///< Moves collected -> applied, plus the next send
+  LatencyWindow tickDuration; ///< Tick start -> moves applied
+  LatencyWindow tickJitter;   ///< Tick start -> how late it started
+
+  // Log a summary every interval frames
+  void report(int frame, int interval = 300) const;
+};
+
+} // namespace cycles_server
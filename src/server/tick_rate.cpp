@@ -0,0 +1,60 @@
+#include "tick_rate.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace cycles_server {
+
+namespace detail {
+sf::Time fromMilliseconds(float ms) {
+  return sf::microseconds(static_cast<sf::Int64>(ms * 1000));
+}
+} // namespace detail
+
+void LatencyWindow::add(sf::Time sample) {
+  if (samples.size() < capacity) {
+    samples.push_back(sample);
+  } else {
+    samples[next] = sample;
+  }
+  next = (next + 1) % capacity;
+}
+
+sf::Time LatencyWindow::percentile(float percentile) const {
+  if (samples.empty()) {
+    return sf::Time::Zero;
+  }
+  auto sorted = samples;
+  auto rank = static_cast<std::size_t>(percentile / 100 * (sorted.size() - 1));
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  return sorted[rank];
+}
+
+TickRateController::TickRateController(Configuration conf)
+    : conf(conf), period(detail::fromMilliseconds(conf.tickPeriod)) {
+  if (conf.adaptiveTickRate) {
+    period = std::clamp(period, detail::fromMilliseconds(conf.minTickPeriod),
+                        detail::fromMilliseconds(conf.maxTickPeriod));
+  }
+}
+
+void TickRateController::endFrame() {
+  if (!conf.adaptiveTickRate || ++framesSinceUpdate < updateInterval ||
+      latencies.empty()) {
+    return;
+  }
+  framesSinceUpdate = 0;
+  auto p99 = getLatencyPercentile(99);
+  auto target = p99 * conf.tickLatencyHeadroom;
+  target = std::clamp(target, detail::fromMilliseconds(conf.minTickPeriod),
+                      detail::fromMilliseconds(conf.maxTickPeriod));
+  // Back off at once when clients get slower, speed up gradually
+  auto newPeriod = target > period ? target : period - (period - target) / 4.f;
+  if (newPeriod != period) {
+    spdlog::debug("Tick period: {} us -> {} us (p99 latency {} us)",
+                  period.asMicroseconds(), newPeriod.asMicroseconds(),
+                  p99.asMicroseconds());
+  }
+  period = newPeriod;
+}
+
+} // namespace cycles_server
@@ -0,0 +1,63 @@
+#pragma once
+#include "server.h"
+#include <SFML/System.hpp>
+#include <vector>
+
+namespace cycles_server {
+
+// Window with the latest duration samples
+class LatencyWindow {
+  std::vector<sf::Time> samples;
+  std::size_t next = 0;
+  std::size_t capacity;
+
+public:
+  LatencyWindow(std::size_t capacity = 512) : capacity(capacity) {
+    samples.reserve(capacity);
+  }
+
+  void add(sf::Time sample);
+
+  // Percentile (0-100) of the samples in the window
+  sf::Time percentile(float percentile) const;
+
+  bool empty() const { return samples.empty(); }
+};
+
+// Tick rate control
+//
+// Keeps a window of the latest client response latencies (time between a
+// frame being sent and the move for it being received), a client that does
+// not answer in time counting as the whole maxClientCommunicationTime. With
+// adaptiveTickRate enabled the tick period follows the p99 of that window,
+// scaled by tickLatencyHeadroom and clamped to [minTickPeriod, maxTickPeriod].
+class TickRateController {
+  const Configuration conf;
+  sf::Time period;
+  LatencyWindow latencies;
+  int framesSinceUpdate = 0;
+
+  static constexpr int updateInterval = 16; // frames
+
+public:
+  TickRateController(Configuration conf);
+
+  sf::Time getPeriod() const { return period; }
+
+  void addLatency(sf::Time latency) { latencies.add(latency); }
+
+  // A client that did not answer within maxClientCommunicationTime
+  void addTimeout() {
+    latencies.add(sf::milliseconds(conf.maxClientCommunicationTime));
+  }
+
+  // Latency percentile (0-100) over the current window
+  sf::Time getLatencyPercentile(float percentile) const {
+    return latencies.percentile(percentile);
+  }
+
+  // Called once per frame, updates the period when adaptive
+  void endFrame();
+};
+
+} // namespace cycles_server
@@ -0,0 +1,269 @@
+#include "tournament.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+namespace cycles_server {
+
+TournamentConfig::TournamentConfig(const std::string &configPath) {
+  if (!std::filesystem::exists(configPath)) {
+    spdlog::critical("Tournament file {} does not exist", configPath);
+    exit(1);
+  }
+  YAML::Node config = YAML::LoadFile(configPath);
+  if (config["format"]) {
+    auto name = config["format"].as<std::string>();
+    if (name == "roundRobin") {
+      format = TournamentFormat::roundRobin;
+    } else if (name == "swiss") {
+      format = TournamentFormat::swiss;
+    } else if (name == "knockout") {
+      format = TournamentFormat::knockout;
+    } else {
+      spdlog::critical("Unknown tournament format {}", name);
+      exit(1);
+    }
+  }
+  for (const auto &bot : config["bots"]) {
+    bots.push_back(
+        {bot["name"].as<std::string>(), bot["command"].as<std::string>()});
+  }
+  if (config["playersPerMatch"]) {
+    playersPerMatch = config["playersPerMatch"].as<int>();
+  }
+  if (config["rounds"]) {
+    rounds = config["rounds"].as<int>();
+  }
+  if (config["server"]) {
+    server = config["server"].as<std::string>();
+  }
+  if (config["serverConfig"]) {
+    serverConfig = config["serverConfig"].as<std::string>();
+  }
+  if (config["parallelMatches"]) {
+    parallelMatches = config["parallelMatches"].as<int>();
+  }
+  if (config["basePort"]) {
+    basePort = config["basePort"].as<int>();
+  }
+  if (config["matchTimeout"]) {
+    matchTimeout = config["matchTimeout"].as<float>();
+  }
+  if (config["pinCpus"]) {
+    pinCpus = config["pinCpus"].as<bool>();
+  }
+  if (config["replays"]) {
+    replays = config["replays"].as<bool>();
+  }
+  if (config["output"]) {
+    output = config["output"].as<std::string>();
+  }
+  std::set<std::string> names;
+  for (const auto &bot : bots) {
+    if (!names.insert(bot.name).second) {
+      spdlog::critical("The bot name {} is used twice", bot.name);
+      exit(1);
+    }
+  }
+  if (bots.size() < 2 || playersPerMatch < 2) {
+    spdlog::critical("A tournament needs at least two bots per match");
+    exit(1);
+  }
+}
+
+Tournament::Tournament(TournamentFormat format, int bots, int playersPerMatch,
+                       int rounds)
+    : format(format), playersPerMatch(std::min(playersPerMatch, bots)),
+      rounds(rounds > 0 ? rounds
+                        : static_cast<int>(std::ceil(std::log2(bots)))),
+      scores(bots) {
+  for (int bot = 0; bot < bots; bot++) {
+    scores[bot].bot = bot;
+    alive.push_back(bot);
+  }
+}
+
+std::vector<Match> Tournament::nextRound() {
+  std::vector<Match> matches;
+  switch (format) {
+  case TournamentFormat::roundRobin:
+    matches = roundRobin();
+    break;
+  case TournamentFormat::swiss:
+    matches = swiss();
+    break;
+  case TournamentFormat::knockout:
+    matches = knockout();
+    break;
+  }
+  if (!matches.empty()) {
+    round++;
+  }
+  return matches;
+}
+
+std::vector<Match> Tournament::roundRobin() {
+  std::vector<Match> matches;
+  if (round > 0) {
+    return matches;
+  }
+  // Every combination of playersPerMatch bots, in lexicographic order
+  std::vector<int> group(playersPerMatch);
+  for (int i = 0; i < playersPerMatch; i++) {
+    group[i] = i;
+  }
+  const int bots = static_cast<int>(scores.size());
+  while (true) {
+    matches.push_back({round, group});
+    int i = playersPerMatch - 1;
+    while (i >= 0 && group[i] == bots - playersPerMatch + i) {
+      i--;
+    }
+    if (i < 0) {
+      return matches;
+    }
+    group[i]++;
+    for (int j = i + 1; j < playersPerMatch; j++) {
+      group[j] = group[j - 1] + 1;
+    }
+  }
+}
+
+std::vector<Match> Tournament::swiss() {
+  std::vector<Match> matches;
+  if (round >= rounds) {
+    return matches;
+  }
+  // Leaders first, the seeds break the ties
+  std::vector<int> remaining(scores.size());
+  for (std::size_t i = 0; i < remaining.size(); i++) {
+    remaining[i] = static_cast<int>(i);
+  }
+  std::stable_sort(remaining.begin(), remaining.end(), [this](int a, int b) {
+    return scores[a].score > scores[b].score;
+  });
+  auto met = [this](int a, int b) {
+    return played.contains(std::minmax(a, b));
+  };
+  while (!remaining.empty()) {
+    // The best bot left meets the next ones it has not played yet, rematches
+    // only when there is no one else
+    Match match{round, {remaining.front()}};
+    remaining.erase(remaining.begin());
+    for (bool rematch : {false, true}) {
+      for (auto it = remaining.begin();
+           it != remaining.end() &&
+           static_cast<int>(match.bots.size()) < playersPerMatch;) {
+        bool fresh = std::none_of(match.bots.begin(), match.bots.end(),
+                                  [&](int bot) { return met(bot, *it); });
+        if (rematch || fresh) {
+          match.bots.push_back(*it);
+          it = remaining.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    if (match.bots.size() == 1) {
+      // A bye counts as beating everyone in a match
+      scores[match.bots[0]].score += playersPerMatch - 1;
+      continue;
+    }
+    matches.push_back(match);
+  }
+  return matches;
+}
+
+std::vector<Match> Tournament::knockout() {
+  std::vector<Match> matches;
+  if (alive.size() <= 1) {
+    return matches;
+  }
+  // Deal the bots to the matches back and forth so the best seeds meet the
+  // worst ones, 1 against 8, 2 against 7... with two bots per match
+  const int groups = static_cast<int>(
+      (alive.size() + playersPerMatch - 1) / playersPerMatch);
+  std::vector<Match> dealt(groups, Match{round, {}});
+  for (std::size_t i = 0; i < alive.size(); i++) {
+    int pass = static_cast<int>(i) / groups;
+    int slot = static_cast<int>(i) % groups;
+    dealt[pass % 2 == 0 ? slot : groups - 1 - slot].bots.push_back(alive[i]);
+  }
+  for (auto &match : dealt) {
+    // A bot alone goes through
+    if (match.bots.size() > 1) {
+      matches.push_back(match);
+    }
+  }
+  return matches;
+}
+
+void Tournament::record(const Match &match, const std::vector<int> &places) {
+  const auto size = match.bots.size();
+  for (std::size_t i = 0; i < size; i++) {
+    auto &standing = scores[match.bots[i]];
+    standing.matches++;
+    standing.lastRound = match.round;
+    bool won = true;
+    for (std::size_t j = 0; j < size; j++) {
+      if (i == j) {
+        continue;
+      }
+      played.insert(std::minmax(match.bots[i], match.bots[j]));
+      if (places[i] < places[j]) {
+        standing.score += 1;
+      } else if (places[i] == places[j]) {
+        standing.score += 0.5f;
+      } else {
+        won = false;
+      }
+    }
+    standing.wins += won;
+  }
+  if (format != TournamentFormat::knockout) {
+    return;
+  }
+  // The best place goes through, on a tie the best seed
+  std::size_t winner = 0;
+  auto seed = [this](int bot) {
+    return std::find(alive.begin(), alive.end(), bot) - alive.begin();
+  };
+  for (std::size_t i = 1; i < size; i++) {
+    if (places[i] < places[winner] ||
+        (places[i] == places[winner] &&
+         seed(match.bots[i]) < seed(match.bots[winner]))) {
+      winner = i;
+    }
+  }
+  for (std::size_t i = 0; i < size; i++) {
+    if (i != winner) {
+      std::erase(alive, match.bots[i]);
+    }
+  }
+}
+
+std::vector<Standing> Tournament::standings() const {
+  auto result = scores;
+  for (int bot : alive) {
+    if (format == TournamentFormat::knockout) {
+      result[bot].lastRound = round;
+    }
+  }
+  // Knockout ranks by the round a bot reached first
+  std::stable_sort(result.begin(), result.end(),
+                   [this](const Standing &a, const Standing &b) {
+                     if (format == TournamentFormat::knockout &&
+                         a.lastRound != b.lastRound) {
+                       return a.lastRound > b.lastRound;
+                     }
+                     if (a.score != b.score) {
+                       return a.score > b.score;
+                     }
+                     return a.wins > b.wins;
+                   });
+  return result;
+}
+
+} // namespace cycles_server
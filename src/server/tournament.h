@@ -0,0 +1,78 @@
+#pragma once
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cycles_server {
+
+enum class TournamentFormat {
+  roundRobin, // Every group of playersPerMatch bots plays once, in one round
+  swiss,      // Bots with similar scores meet, for a fixed number of rounds
+  knockout    // The winner of each match goes to the next round
+};
+
+struct Bot {
+  std::string name;    // Unique, it is also the name the bot plays with
+  std::string command; // Started with the name as its last argument
+};
+
+struct TournamentConfig {
+  TournamentFormat format = TournamentFormat::roundRobin;
+  std::vector<Bot> bots;    ///< The roster, best seed first
+  int playersPerMatch = 2;  ///< Bots in each match
+  int rounds = 0;           ///< Swiss rounds, 0 for log2 of the bots
+  std::string server = "./build/bin/server"; ///< Server binary
+  std::string serverConfig; ///< Base configuration of the matches
+  int parallelMatches = 0;  ///< Matches played at once, 0 to fill the cores
+  int basePort = 50100;     ///< Port of the first match slot
+  float matchTimeout = 600; ///< Seconds before a match is stopped
+  bool pinCpus = true;      ///< Give the server and each bot of a match a core
+  bool replays = false;     ///< Record a replay of every match
+  std::string output = "tournament"; ///< Directory for the logs and results
+  TournamentConfig(const std::string &configPath);
+};
+
+struct Match {
+  int round = 0;
+  std::vector<int> bots; // Indices in the roster
+};
+
+struct Standing {
+  int bot = 0;
+  float score = 0;  // One point for each opponent placed behind, half a tie
+  int matches = 0;
+  int wins = 0;     // Matches it finished first in, ties included
+  int lastRound = 0; // Knockout: round it was eliminated in
+};
+
+// Pairs the bots round after round, the runner plays the matches of a round
+// and records their results before asking for the next one
+class Tournament {
+  TournamentFormat format;
+  int playersPerMatch;
+  int rounds;
+  int round = 0;
+  std::vector<Standing> scores;
+  std::vector<int> alive; // Knockout: bots still in, best seed first
+  std::set<std::pair<int, int>> played;
+
+  std::vector<Match> roundRobin();
+  std::vector<Match> swiss();
+  std::vector<Match> knockout();
+
+public:
+  Tournament(TournamentFormat format, int bots, int playersPerMatch,
+             int rounds);
+
+  // Matches of the next round, empty once the tournament is over
+  std::vector<Match> nextRound();
+
+  // Places of the bots of a match, in the order of match.bots
+  void record(const Match &match, const std::vector<int> &places);
+
+  // Best first
+  std::vector<Standing> standings() const;
+};
+
+} // namespace cycles_server
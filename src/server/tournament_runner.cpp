@@ -0,0 +1,502 @@
+// Plays a tournament on a pool of headless servers, each match with its own
+// server, port and bot processes:
+//   tournament <tournament_file>
+// The server and every bot of a match get their own core when there are
+// enough of them, and as many matches run at once as the cores allow. The
+// resources used by every process are recorded next to the response times
+// the server measured.
+#include "match_result.h"
+#include "thread_placement.h"
+#include "tournament.h"
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <numeric>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <signal.h>
+#include <spawn.h>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+extern char **environ;
+
+using namespace cycles_server;
+namespace fs = std::filesystem;
+
+// Cores the runner may use
+std::vector<int> availableCpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned cpu = 0; cpu < count; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// Start a command with CYCLES_PORT set and its output in a log file
+pid_t spawn(const std::vector<std::string> &args, int port,
+            const std::string &log) {
+  std::vector<std::string> env;
+  for (char **var = environ; *var != nullptr; var++) {
+    if (std::string_view(*var).substr(0, 12) != "CYCLES_PORT=") {
+      env.push_back(*var);
+    }
+  }
+  env.push_back("CYCLES_PORT=" + std::to_string(port));
+  std::vector<char *> argv, envp;
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  for (const auto &var : env) {
+    envp.push_back(const_cast<char *>(var.c_str()));
+  }
+  envp.push_back(nullptr);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(),
+                                   O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  pid_t pid = -1;
+  if (posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(),
+                   envp.data()) != 0) {
+    spdlog::error("Failed to start {}", args[0]);
+    pid = -1;
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  return pid;
+}
+
+// Resources used by a process
+struct Usage {
+  double userSeconds = 0;
+  double systemSeconds = 0;
+  long rssKb = 0; // Resident memory when sampled, unknown after the exit
+  long peakRssKb = 0;
+  long voluntarySwitches = 0;   // Gave the core up, waiting for the network
+  long involuntarySwitches = 0; // Preempted, the process wanted more CPU
+};
+
+Usage fromRusage(const rusage &resources) {
+  Usage usage;
+  usage.userSeconds =
+      resources.ru_utime.tv_sec + resources.ru_utime.tv_usec / 1e6;
+  usage.systemSeconds =
+      resources.ru_stime.tv_sec + resources.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+  usage.peakRssKb = resources.ru_maxrss / 1024; // In bytes on macOS
+#else
+  usage.peakRssKb = resources.ru_maxrss;
+#endif
+  usage.voluntarySwitches = resources.ru_nvcsw;
+  usage.involuntarySwitches = resources.ru_nivcsw;
+  return usage;
+}
+
+// Usage of a running process so far, from /proc on Linux
+std::optional<Usage> sampleUsage(pid_t pid) {
+#ifdef __linux__
+  const auto dir = "/proc/" + std::to_string(pid);
+  std::ifstream stat(dir + "/stat");
+  std::string line;
+  if (!std::getline(stat, line) || line.rfind(')') == std::string::npos) {
+    return std::nullopt;
+  }
+  // The fields after the name, which may hold spaces, start at the state
+  std::istringstream fields(line.substr(line.rfind(')') + 2));
+  std::vector<std::string> values;
+  for (std::string value; fields >> value;) {
+    values.push_back(value);
+  }
+  if (values.size() < 13 || values[0] == "Z") {
+    return std::nullopt;
+  }
+  Usage usage;
+  const double ticks = sysconf(_SC_CLK_TCK);
+  usage.userSeconds = std::stol(values[11]) / ticks;
+  usage.systemSeconds = std::stol(values[12]) / ticks;
+  const std::map<std::string, long Usage::*> keys = {
+      {"VmRSS:", &Usage::rssKb},
+      {"VmHWM:", &Usage::peakRssKb},
+      {"voluntary_ctxt_switches:", &Usage::voluntarySwitches},
+      {"nonvoluntary_ctxt_switches:", &Usage::involuntarySwitches}};
+  std::ifstream status(dir + "/status");
+  for (std::string key; status >> key;) {
+    auto it = keys.find(key);
+    if (it != keys.end()) {
+      status >> usage.*(it->second);
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return usage;
+#else
+  (void)pid;
+  return std::nullopt;
+#endif
+}
+
+// True once the process exited, waits up to timeout
+bool waitExit(pid_t pid, std::chrono::milliseconds timeout,
+              Usage *usage = nullptr) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  do {
+    int status;
+    rusage resources{};
+    if (wait4(pid, &status, WNOHANG, &resources) != 0) {
+      if (usage != nullptr) {
+        *usage = fromRusage(resources);
+      }
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  } while (std::chrono::steady_clock::now() < deadline);
+  return false;
+}
+
+Usage stopProcess(pid_t pid) {
+  Usage usage;
+  kill(pid, SIGTERM);
+  if (!waitExit(pid, std::chrono::seconds(2), &usage)) {
+    kill(pid, SIGKILL);
+    rusage resources{};
+    wait4(pid, nullptr, 0, &resources);
+    usage = fromRusage(resources);
+  }
+  return usage;
+}
+
+std::int64_t wallClockMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// The bots exit if the server is not listening when they start. A probe
+// that connects and leaves at once is not added to the game.
+bool waitListening(pid_t server, int port) {
+  for (int attempt = 0; attempt < 200; attempt++) {
+    // Left to be reaped by the caller
+    siginfo_t info{};
+    if (waitid(P_PID, server, &info, WEXITED | WNOHANG | WNOWAIT) != 0 ||
+        info.si_pid != 0) {
+      return false;
+    }
+    sf::TcpSocket probe;
+    if (probe.connect("127.0.0.1", port, sf::milliseconds(100)) ==
+        sf::Socket::Done) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return false;
+}
+
+std::vector<std::string> splitCommand(const std::string &command) {
+  std::vector<std::string> args;
+  std::istringstream stream(command);
+  std::string arg;
+  while (stream >> arg) {
+    args.push_back(arg);
+  }
+  return args;
+}
+
+// What a process of a match used and, for a bot, how it answered the server
+struct ProcessReport {
+  std::string name; // The bot, or "server"
+  Usage usage;
+  int answered = 0;
+  int planned = 0;
+  int late = 0;
+  std::vector<float> latencies; // Of the answered frames (ms)
+};
+
+struct MatchReport {
+  MatchResult result; // Empty if the server failed
+  std::vector<ProcessReport> processes;
+};
+
+// Count how every bot answered from the latency log of the server
+void readLatencyLog(const std::string &path,
+                    std::vector<ProcessReport> &processes) {
+  std::ifstream log(path);
+  std::string line;
+  std::getline(log, line); // Header
+  while (std::getline(log, line)) {
+    // frame,time_ms,player,name,status,latency_ms
+    std::vector<std::string> fields;
+    std::istringstream row(line);
+    for (std::string field; std::getline(row, field, ',');) {
+      fields.push_back(field);
+    }
+    if (fields.size() != 6) {
+      continue;
+    }
+    auto process =
+        std::find_if(processes.begin(), processes.end(),
+                     [&](const auto &p) { return p.name == fields[3]; });
+    if (process == processes.end()) {
+      continue;
+    }
+    if (fields[4] == "answered") {
+      process->answered++;
+      process->latencies.push_back(std::stof(fields[5]));
+    } else if (fields[4] == "planned") {
+      process->planned++;
+    } else {
+      process->late++;
+    }
+  }
+}
+
+void writeReportHeader(std::ostream &out) {
+  out << "process,cpu_user_s,cpu_system_s,peak_rss_kb,voluntary_switches,"
+         "involuntary_switches,answered,planned,late,latency_mean_ms,"
+         "latency_p99_ms,latency_max_ms\n";
+}
+
+void writeReport(std::ostream &out, ProcessReport report) {
+  auto &latencies = report.latencies;
+  std::sort(latencies.begin(), latencies.end());
+  const bool any = !latencies.empty();
+  const auto &usage = report.usage;
+  out << report.name << "," << usage.userSeconds << "," << usage.systemSeconds
+      << "," << usage.peakRssKb << "," << usage.voluntarySwitches << ","
+      << usage.involuntarySwitches << "," << report.answered << ","
+      << report.planned << "," << report.late << ","
+      << (any ? std::accumulate(latencies.begin(), latencies.end(), 0.0) /
+                    latencies.size()
+              : 0)
+      << "," << (any ? latencies[latencies.size() * 99 / 100] : 0) << ","
+      << (any ? latencies.back() : 0) << "\n";
+}
+
+class Runner {
+  const TournamentConfig &conf;
+  std::vector<int> cpus;
+  YAML::Node serverConfig;
+
+public:
+  Runner(const TournamentConfig &conf) : conf(conf), cpus(availableCpus()) {
+    if (!conf.serverConfig.empty()) {
+      serverConfig = YAML::LoadFile(conf.serverConfig);
+    }
+  }
+
+  // Match slots that fit on the cores, one core for the server and each bot
+  int slots() const {
+    if (conf.parallelMatches > 0) {
+      return conf.parallelMatches;
+    }
+    return std::max<int>(1, cpus.size() / (conf.playersPerMatch + 1));
+  }
+
+  // Play a match in a slot
+  MatchReport play(int slot, int id, const Match &match) {
+    auto dir = fs::path(conf.output) / ("match_" + std::to_string(id));
+    fs::create_directories(dir);
+    auto resultPath = (dir / "result.yaml").string();
+    auto latencyPath = (dir / "latency.csv").string();
+    fs::remove(resultPath);
+    fs::remove(latencyPath);
+    YAML::Node matchConfig = YAML::Clone(serverConfig);
+    matchConfig["headless"] = true;
+    matchConfig["maxClients"] = static_cast<int>(match.bots.size());
+    matchConfig["resultFile"] = resultPath;
+    matchConfig["latencyLog"] = latencyPath;
+    if (conf.replays) {
+      matchConfig["replayFile"] = (dir / "replay.cycles").string();
+    }
+    // Matches played at once share nothing: checkpoints stay in the match
+    // directory, spectators get a port per slot and no match takes clients
+    // from a broker
+    if (matchConfig["checkpointFile"]) {
+      matchConfig["checkpointFile"] = (dir / "checkpoint.bin").string();
+    }
+    if (auto spectatorPort = matchConfig["spectatorPort"].as<int>(0)) {
+      matchConfig["spectatorPort"] = spectatorPort + slot;
+    }
+    matchConfig.remove("broker");
+    auto configPath = (dir / "config.yaml").string();
+    std::ofstream(configPath) << matchConfig << "\n";
+
+    const int port = conf.basePort + slot;
+    const int first = slot * (conf.playersPerMatch + 1);
+    // The processes started inherit the affinity of this thread
+    auto pin = [&](int member) {
+      if (conf.pinCpus) {
+        pinThread({cpus[(first + member) % cpus.size()]});
+      }
+    };
+    MatchReport report;
+    pin(0);
+    pid_t server = spawn({conf.server, configPath}, port,
+                         (dir / "server.log").string());
+    if (server < 0) {
+      pinThread(cpus);
+      return report;
+    }
+    if (!waitListening(server, port)) {
+      pinThread(cpus);
+      spdlog::error("Match {}: the server did not start, see {}", id,
+                    (dir / "server.log").string());
+      stopProcess(server);
+      return report;
+    }
+    std::vector<pid_t> pids;
+    for (std::size_t i = 0; i < match.bots.size(); i++) {
+      const auto &bot = conf.bots[match.bots[i]];
+      auto args = splitCommand(bot.command);
+      args.push_back(bot.name);
+      pin(static_cast<int>(i) + 1);
+      pids.push_back(
+          spawn(args, port, (dir / (bot.name + ".log")).string()));
+      report.processes.push_back({bot.name, {}, 0, 0, 0, {}});
+    }
+    pinThread(cpus);
+
+    // Sample the bots while the game runs, the times line up with the
+    // latency log of the server
+    std::ofstream samples(dir / "usage.csv");
+    samples << "time_ms,process,cpu_user_s,cpu_system_s,rss_kb,"
+               "voluntary_switches,involuntary_switches\n";
+    Usage serverUsage;
+    const auto deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(static_cast<int>(conf.matchTimeout * 1000));
+    bool finished = false;
+    while (!finished && std::chrono::steady_clock::now() < deadline) {
+      for (std::size_t i = 0; i < pids.size(); i++) {
+        auto usage = pids[i] > 0 ? sampleUsage(pids[i]) : std::nullopt;
+        if (usage) {
+          samples << wallClockMs() << "," << report.processes[i].name << ","
+                  << usage->userSeconds << "," << usage->systemSeconds << ","
+                  << usage->rssKb << "," << usage->voluntarySwitches << ","
+                  << usage->involuntarySwitches << "\n";
+        }
+      }
+      finished =
+          waitExit(server, std::chrono::milliseconds(100), &serverUsage);
+    }
+    if (!finished) {
+      spdlog::error("Match {} timed out", id);
+      serverUsage = stopProcess(server);
+    }
+    for (std::size_t i = 0; i < pids.size(); i++) {
+      if (pids[i] > 0) {
+        report.processes[i].usage = stopProcess(pids[i]);
+      }
+    }
+    readLatencyLog(latencyPath, report.processes);
+    report.processes.push_back({"server", serverUsage, 0, 0, 0, {}});
+    readMatchResult(resultPath, report.result);
+    std::ofstream processes(dir / "processes.csv");
+    writeReportHeader(processes);
+    for (const auto &process : report.processes) {
+      writeReport(processes, process);
+    }
+    return report;
+  }
+};
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    spdlog::critical("Usage: {} <tournament_file>", argv[0]);
+    return 1;
+  }
+  TournamentConfig conf(argv[1]);
+  fs::create_directories(conf.output);
+  Runner runner(conf);
+  Tournament tournament(conf.format, static_cast<int>(conf.bots.size()),
+                        conf.playersPerMatch, conf.rounds);
+  std::ofstream matchesCsv(fs::path(conf.output) / "matches.csv");
+  matchesCsv << "round,match,bot,place,outcome,last_frame\n";
+  std::ofstream processesCsv(fs::path(conf.output) / "processes.csv");
+  processesCsv << "round,match,";
+  writeReportHeader(processesCsv);
+  int played = 0;
+  for (auto matches = tournament.nextRound(); !matches.empty();
+       matches = tournament.nextRound()) {
+    const int slots = std::min<int>(runner.slots(), matches.size());
+    spdlog::info("Round {}: {} matches on {} servers", matches[0].round + 1,
+                 matches.size(), slots);
+    // Each slot plays the next match left until the round is over
+    std::vector<MatchReport> reports(matches.size());
+    std::atomic<std::size_t> next = 0;
+    std::vector<std::thread> pool;
+    for (int slot = 0; slot < slots; slot++) {
+      pool.emplace_back([&, slot] {
+        for (auto i = next++; i < matches.size(); i = next++) {
+          reports[i] = runner.play(slot, played + static_cast<int>(i),
+                                   matches[i]);
+        }
+      });
+    }
+    for (auto &thread : pool) {
+      thread.join();
+    }
+    for (std::size_t i = 0; i < matches.size(); i++) {
+      const auto &result = reports[i].result;
+      // A bot missing from the result never joined, it comes last. If the
+      // server failed every bot ties.
+      std::vector<int> places;
+      for (int bot : matches[i].bots) {
+        const auto &name = conf.bots[bot].name;
+        auto player = std::find_if(
+            result.players.begin(), result.players.end(),
+            [&name](const PlayerResult &p) { return p.name == name; });
+        bool found = player != result.players.end();
+        places.push_back(found ? player->place
+                               : static_cast<int>(result.players.size()) + 1);
+        matchesCsv << matches[i].round + 1 << "," << played + i << ","
+                   << name << "," << places.back() << ","
+                   << (found ? player->outcome : "missing") << ","
+                   << (found ? player->lastFrame : 0) << "\n";
+      }
+      tournament.record(matches[i], places);
+      for (const auto &process : reports[i].processes) {
+        processesCsv << matches[i].round + 1 << "," << played + i << ",";
+        writeReport(processesCsv, process);
+      }
+    }
+    played += static_cast<int>(matches.size());
+  }
+
+  std::ofstream standingsCsv(fs::path(conf.output) / "standings.csv");
+  standingsCsv << "rank,bot,score,matches,wins\n";
+  int rank = 1;
+  for (const auto &standing : tournament.standings()) {
+    const auto &name = conf.bots[standing.bot].name;
+    spdlog::info("{:>3}. {:<20} {:>6.1f} points, {} wins in {} matches", rank,
+                 name, standing.score, standing.wins, standing.matches);
+    standingsCsv << rank << "," << name << "," << standing.score << ","
+                 << standing.matches << "," << standing.wins << "\n";
+    rank++;
+  }
+  return 0;
+}
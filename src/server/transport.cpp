@@ -0,0 +1,43 @@
+#include "transport.h"
+#include <spdlog/spdlog.h>
+
+namespace cycles_server {
+
+void SfmlTransport::addClient(Id id, std::shared_ptr<sf::TcpSocket> socket) {
+  socket->setBlocking(false);
+  sockets[id] = socket;
+}
+
+void SfmlTransport::removeClient(Id id) { sockets[id].reset(); }
+
+void SfmlTransport::send(sf::Packet &packet, int,
+                         const std::vector<Id> &ids,
+                         std::vector<sf::Socket::Status> &statuses) {
+  statuses.resize(ids.size());
+  for (std::size_t i = 0; i < ids.size(); i++) {
+    auto &socket = sockets[ids[i]];
+    statuses[i] = socket ? socket->send(packet) : sf::Socket::Disconnected;
+  }
+}
+
+sf::Socket::Status SfmlTransport::receive(Id id, sf::Packet &packet) {
+  auto &socket = sockets[id];
+  return socket ? socket->receive(packet) : sf::Socket::Disconnected;
+}
+
+std::unique_ptr<Transport> makeTransport(const Configuration &conf) {
+  if (conf.ioUring) {
+#ifdef CYCLES_HAS_IO_URING
+    if (auto transport = makeUringTransport(conf)) {
+      spdlog::info("Using the io_uring network backend");
+      return transport;
+    }
+    spdlog::warn("io_uring is not available, using SFML sockets");
+#else
+    spdlog::warn("Built without io_uring support, using SFML sockets");
+#endif
+  }
+  return std::make_unique<SfmlTransport>();
+}
+
+} // namespace cycles_server
@@ -0,0 +1,61 @@
+#pragma once
+#include "server.h"
+#include <SFML/Network.hpp>
+#include <array>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace cycles_server {
+
+// How the game loop talks to the clients once they joined.
+// Statuses follow sf::Socket: Done, NotReady (try again later) or
+// Disconnected.
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  virtual void addClient(Id id, std::shared_ptr<sf::TcpSocket> socket) = 0;
+
+  virtual void removeClient(Id id) = 0;
+
+  // Send the packet of a frame to every client in ids, statuses[i] is the
+  // result for ids[i]. Done means every byte went out; after NotReady,
+  // sending the same frame again either retries or reports how the earlier
+  // send ended. The packet must not change while its frame does not.
+  virtual void send(sf::Packet &packet, int frame, const std::vector<Id> &ids,
+                    std::vector<sf::Socket::Status> &statuses) = 0;
+
+  // Gather the data that arrived since the last call
+  virtual void poll() {}
+
+  // Next complete packet from a client
+  virtual sf::Socket::Status receive(Id id, sf::Packet &packet) = 0;
+};
+
+// One non-blocking SFML socket call per client and operation
+class SfmlTransport : public Transport {
+  std::array<std::shared_ptr<sf::TcpSocket>,
+             std::numeric_limits<Id>::max() + 1>
+      sockets;
+
+public:
+  void addClient(Id id, std::shared_ptr<sf::TcpSocket> socket) override;
+
+  void removeClient(Id id) override;
+
+  void send(sf::Packet &packet, int frame, const std::vector<Id> &ids,
+            std::vector<sf::Socket::Status> &statuses) override;
+
+  sf::Socket::Status receive(Id id, sf::Packet &packet) override;
+};
+
+// The io_uring transport when enabled and available, SFML otherwise
+std::unique_ptr<Transport> makeTransport(const Configuration &conf);
+
+#ifdef CYCLES_HAS_IO_URING
+// Null if the kernel does not support what it needs
+std::unique_ptr<Transport> makeUringTransport(const Configuration &conf);
+#endif
+
+} // namespace cycles_server
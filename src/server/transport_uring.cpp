@@ -0,0 +1,364 @@
+#include "transport.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <liburing.h>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+
+namespace cycles_server {
+
+namespace {
+
+constexpr unsigned ringEntries = 1024;
+constexpr unsigned receiveBufferCount = 256; // Must be a power of two
+constexpr unsigned receiveBufferSize = 4096;
+constexpr int bufferGroup = 0;
+constexpr std::uint32_t maxPacketSize = 1 << 20;
+
+enum class Operation : std::uint64_t { send = 1, receive, cancel };
+
+std::uint64_t toUserData(Operation op, Id id) {
+  return (static_cast<std::uint64_t>(op) << 8) | id;
+}
+
+struct UringClient {
+  std::shared_ptr<sf::TcpSocket> socket; // Keeps the descriptor open
+  int fd = -1;
+  std::vector<char> stream;       // Received bytes not parsed yet
+  std::deque<sf::Packet> packets; // Complete packets not read yet
+  // Last frame queued, shared by all the clients it goes to, and what became
+  // of it: NotReady while in flight, then Done or Disconnected
+  std::shared_ptr<const std::vector<char>> sendBuffer;
+  std::size_t sendOffset = 0;
+  sf::Socket::Status sendStatus = sf::Socket::NotReady;
+  bool sending = false;
+  bool receiving = false;
+  bool disconnected = false;
+  bool removed = false;
+};
+
+} // namespace
+
+// Frames are sent to every client with one batched submission, moves are
+// received with a multishot receive per client into a ring of provided
+// buffers, so a tick costs a handful of syscalls instead of two per client.
+// Only the thread of the game loop touches the ring: clients added from
+// other threads wait in a list until it picks them up.
+class UringTransport : public Transport {
+  io_uring ring;
+  std::mutex addedMutex;
+  std::vector<std::pair<Id, std::shared_ptr<sf::TcpSocket>>> added;
+  std::atomic<bool> anyAdded = false;
+  io_uring_buf_ring *bufferRing = nullptr;
+  std::vector<char> receiveBuffers;
+  std::array<std::unique_ptr<UringClient>,
+             std::numeric_limits<Id>::max() + 1>
+      clients;
+  std::shared_ptr<std::vector<char>> frame;
+  int framedFrame = -1; // Frame the bytes in frame belong to
+  bool ringReady = false;
+  bool multishot = true;
+
+  io_uring_sqe *getSqe() {
+    auto *sqe = io_uring_get_sqe(&ring);
+    if (sqe == nullptr) {
+      io_uring_submit(&ring);
+      sqe = io_uring_get_sqe(&ring);
+    }
+    return sqe;
+  }
+
+  void queueSend(Id id) {
+    auto &client = *clients[id];
+    auto *sqe = getSqe();
+    io_uring_prep_send(sqe, client.fd,
+                       client.sendBuffer->data() + client.sendOffset,
+                       client.sendBuffer->size() - client.sendOffset,
+                       MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, toUserData(Operation::send, id));
+    client.sending = true;
+  }
+
+  void armReceive(Id id) {
+    auto &client = *clients[id];
+    auto *sqe = getSqe();
+    if (multishot) {
+      io_uring_prep_recv_multishot(sqe, client.fd, nullptr, 0, 0);
+    } else {
+      io_uring_prep_recv(sqe, client.fd, nullptr, receiveBufferSize, 0);
+    }
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bufferGroup;
+    io_uring_sqe_set_data64(sqe, toUserData(Operation::receive, id));
+    client.receiving = true;
+  }
+
+  void recycleBuffer(unsigned bufferId) {
+    io_uring_buf_ring_add(bufferRing,
+                          receiveBuffers.data() + bufferId * receiveBufferSize,
+                          receiveBufferSize, bufferId,
+                          io_uring_buf_ring_mask(receiveBufferCount), 0);
+    io_uring_buf_ring_advance(bufferRing, 1);
+  }
+
+  // Split the received bytes in packets, framed as SFML does: the size in
+  // network byte order followed by the data
+  void parse(UringClient &client) {
+    std::size_t offset = 0;
+    while (client.stream.size() - offset >= sizeof(std::uint32_t)) {
+      std::uint32_t size;
+      std::memcpy(&size, client.stream.data() + offset, sizeof(size));
+      size = ntohl(size);
+      if (size > maxPacketSize) {
+        client.disconnected = true;
+        break;
+      }
+      if (client.stream.size() - offset - sizeof(size) < size) {
+        break;
+      }
+      sf::Packet packet;
+      packet.append(client.stream.data() + offset + sizeof(size), size);
+      client.packets.push_back(std::move(packet));
+      offset += sizeof(size) + size;
+    }
+    client.stream.erase(client.stream.begin(), client.stream.begin() + offset);
+  }
+
+  void onReceive(Id id, io_uring_cqe *cqe) {
+    auto &client = *clients[id];
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+      unsigned bufferId = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      if (cqe->res > 0 && !client.removed) {
+        const char *data = receiveBuffers.data() + bufferId * receiveBufferSize;
+        client.stream.insert(client.stream.end(), data, data + cqe->res);
+        parse(client);
+      }
+      recycleBuffer(bufferId);
+    }
+    if (cqe->res == 0) {
+      client.disconnected = true;
+    } else if (cqe->res == -EINVAL && multishot) {
+      spdlog::warn("Multishot receive not supported, falling back to single "
+                   "shot receives");
+      multishot = false;
+    } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -EAGAIN &&
+               cqe->res != -EINTR) {
+      client.disconnected = true;
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+      client.receiving = false;
+      if (!client.disconnected && !client.removed) {
+        armReceive(id);
+      }
+    }
+  }
+
+  void onSend(Id id, io_uring_cqe *cqe) {
+    auto &client = *clients[id];
+    client.sending = false;
+    if (cqe->res < 0) {
+      client.disconnected = true;
+      client.sendStatus = sf::Socket::Disconnected;
+      return;
+    }
+    client.sendOffset += cqe->res;
+    if (client.sendOffset < client.sendBuffer->size() && !client.removed) {
+      queueSend(id);
+      return;
+    }
+    client.sendStatus = client.removed ? sf::Socket::Disconnected
+                                       : sf::Socket::Done;
+  }
+
+  // The clients added since the last call, on the ring's thread
+  void adopt() {
+    if (!anyAdded.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::scoped_lock lock(addedMutex);
+    for (auto &[id, socket] : added) {
+      clients[id] = std::make_unique<UringClient>();
+      clients[id]->socket = socket;
+      clients[id]->fd = socket->getHandle();
+      armReceive(id);
+    }
+    added.clear();
+    anyAdded.store(false, std::memory_order_release);
+  }
+
+  void reap() {
+    io_uring_cqe *cqe;
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&ring, head, cqe) {
+      handleCompletion(cqe);
+      count++;
+    }
+    io_uring_cq_advance(&ring, count);
+  }
+
+  void handleCompletion(io_uring_cqe *cqe) {
+    auto data = io_uring_cqe_get_data64(cqe);
+    auto op = static_cast<Operation>(data >> 8);
+    auto id = static_cast<Id>(data & 0xff);
+    if (!clients[id]) {
+      return;
+    }
+    if (op == Operation::receive) {
+      onReceive(id, cqe);
+    } else if (op == Operation::send) {
+      onSend(id, cqe);
+    }
+    // The kernel is done with a removed client once nothing is in flight
+    auto &client = *clients[id];
+    if (client.removed && !client.sending && !client.receiving) {
+      clients[id].reset();
+    }
+  }
+
+public:
+  UringTransport() : receiveBuffers(receiveBufferCount * receiveBufferSize) {}
+
+  ~UringTransport() override {
+    if (bufferRing != nullptr) {
+      io_uring_free_buf_ring(&ring, bufferRing, receiveBufferCount,
+                             bufferGroup);
+    }
+    if (ringReady) {
+      io_uring_queue_exit(&ring);
+    }
+  }
+
+  bool init() {
+    if (io_uring_queue_init(ringEntries, &ring, 0) < 0) {
+      return false;
+    }
+    ringReady = true;
+    int ret = 0;
+    bufferRing = io_uring_setup_buf_ring(&ring, receiveBufferCount,
+                                         bufferGroup, 0, &ret);
+    if (bufferRing == nullptr) {
+      return false;
+    }
+    for (unsigned i = 0; i < receiveBufferCount; i++) {
+      io_uring_buf_ring_add(bufferRing,
+                            receiveBuffers.data() + i * receiveBufferSize,
+                            receiveBufferSize, i,
+                            io_uring_buf_ring_mask(receiveBufferCount), i);
+    }
+    io_uring_buf_ring_advance(bufferRing, receiveBufferCount);
+    return true;
+  }
+
+  // Called from the accept thread, the receive is armed by the game loop
+  void addClient(Id id, std::shared_ptr<sf::TcpSocket> socket) override {
+    // Blocking descriptors make io_uring wait for readiness internally
+    // instead of failing with EAGAIN
+    socket->setBlocking(true);
+    std::scoped_lock lock(addedMutex);
+    added.emplace_back(id, std::move(socket));
+    anyAdded.store(true, std::memory_order_release);
+  }
+
+  void removeClient(Id id) override {
+    adopt();
+    if (!clients[id]) {
+      return;
+    }
+    auto &client = *clients[id];
+    client.removed = true;
+    if (client.receiving) {
+      auto *sqe = getSqe();
+      io_uring_prep_cancel64(sqe, toUserData(Operation::receive, id), 0);
+      io_uring_sqe_set_data64(sqe, toUserData(Operation::cancel, id));
+      io_uring_submit(&ring);
+    }
+    if (!client.sending && !client.receiving) {
+      clients[id].reset();
+    }
+  }
+
+  // A send is Done once its completion says every byte went out. Until
+  // then it reports NotReady, and sending the same frame again reports
+  // what became of the send in flight instead of queueing another one.
+  void send(sf::Packet &packet, int frameNumber, const std::vector<Id> &ids,
+            std::vector<sf::Socket::Status> &statuses) override {
+    adopt();
+    // Framed once per frame, the buffers queued before are never written
+    // again
+    if (!frame || framedFrame != frameNumber) {
+      auto size = static_cast<std::uint32_t>(packet.getDataSize());
+      auto networkSize = htonl(size);
+      frame = std::make_shared<std::vector<char>>(sizeof(networkSize) + size);
+      std::memcpy(frame->data(), &networkSize, sizeof(networkSize));
+      if (size > 0) {
+        std::memcpy(frame->data() + sizeof(networkSize), packet.getData(),
+                    size);
+      }
+      framedFrame = frameNumber;
+    }
+    for (Id id : ids) {
+      auto &client = clients[id];
+      // One send in flight per client keeps the byte stream in order
+      if (client && !client->removed && !client->disconnected &&
+          !client->sending && client->sendBuffer != frame) {
+        client->sendBuffer = frame;
+        client->sendOffset = 0;
+        client->sendStatus = sf::Socket::NotReady;
+        queueSend(id);
+      }
+    }
+    io_uring_submit(&ring);
+    // Sends that went out at once complete right away
+    reap();
+    io_uring_submit(&ring);
+    statuses.resize(ids.size());
+    for (std::size_t i = 0; i < ids.size(); i++) {
+      auto &client = clients[ids[i]];
+      if (!client || client->removed || client->disconnected) {
+        statuses[i] = sf::Socket::Disconnected;
+      } else if (client->sendBuffer != frame) {
+        statuses[i] = sf::Socket::NotReady; // An older frame is in flight
+      } else {
+        statuses[i] = client->sendStatus;
+      }
+    }
+  }
+
+  void poll() override {
+    adopt();
+    io_uring_submit(&ring);
+    reap();
+    // Re-armed receives and the rest of partial sends
+    io_uring_submit(&ring);
+  }
+
+  sf::Socket::Status receive(Id id, sf::Packet &packet) override {
+    adopt();
+    auto &client = clients[id];
+    if (!client || client->removed) {
+      return sf::Socket::Disconnected;
+    }
+    if (!client->packets.empty()) {
+      packet = std::move(client->packets.front());
+      client->packets.pop_front();
+      return sf::Socket::Done;
+    }
+    return client->disconnected ? sf::Socket::Disconnected
+                                : sf::Socket::NotReady;
+  }
+};
+
+std::unique_ptr<Transport> makeUringTransport(const Configuration &) {
+  auto transport = std::make_unique<UringTransport>();
+  if (!transport->init()) {
+    return nullptr;
+  }
+  return transport;
+}
+
+} // namespace cycles_server
@@ -0,0 +1,211 @@
+// Watch a game from another machine: connects to the spectator port of a
+// server, or plays a replay file recorded with the replayFile option.
+#include "renderer.h"
+#include "replay.h"
+#include "server.h"
+#include "spectator_stream.h"
+#include <SFML/Network.hpp>
+#include <cmath>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+
+using namespace cycles_server;
+
+// Receives the stream of a server as it is played
+class SpectatorSource {
+  sf::TcpSocket socket;
+  bool connected = false;
+
+public:
+  SpectatorSource(const std::string &host, unsigned short port) {
+    if (socket.connect(host, port, sf::seconds(5)) != sf::Socket::Done) {
+      spdlog::critical("Failed to connect to {}:{}", host, port);
+      exit(1);
+    }
+    spdlog::info("Watching {}:{}", host, port);
+    socket.setBlocking(false);
+    connected = true;
+  }
+
+  // Next message if one arrived, never blocks
+  bool next(sf::Packet &packet) {
+    if (!connected) {
+      return false;
+    }
+    auto status = socket.receive(packet);
+    if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+      spdlog::info("The server closed the stream");
+      connected = false;
+    }
+    return status == sf::Socket::Done;
+  }
+
+  // No more messages will come
+  bool finished() const { return !connected; }
+};
+
+void setGridSize(Configuration &conf, const StreamDecoder &decoder) {
+  conf.gridWidth = decoder.getGridWidth();
+  conf.gridHeight = decoder.getGridHeight();
+  conf.cellSize = conf.gameWidth / float(conf.gridWidth);
+}
+
+int watch(Configuration conf, const std::string &host, unsigned short port) {
+  SpectatorSource source(host, port);
+  StreamDecoder decoder;
+  std::vector<GameEvent> events;
+  sf::Packet packet;
+  // The grid size comes with the first keyframe
+  while (!decoder.hasKeyframe()) {
+    if (source.finished()) {
+      spdlog::critical("The stream ended before the first keyframe");
+      return 1;
+    }
+    if (source.next(packet)) {
+      decoder.apply(packet, events);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+  setGridSize(conf, decoder);
+
+  GameRenderer renderer(conf);
+  auto queue = std::make_shared<EventQueue>();
+  renderer.setEventQueue(queue);
+  while (renderer.isOpen()) {
+    renderer.handleEvents();
+    while (source.next(packet)) {
+      if (!decoder.apply(packet, events)) {
+        spdlog::warn("Skipping a message of the stream");
+      }
+    }
+    for (const auto &event : events) {
+      queue->push(event);
+    }
+    events.clear();
+    renderer.render(decoder.getSnapshot());
+  }
+  return 0;
+}
+
+// Plays a replay at speed times the recorded tick rate. The window shows the
+// latest frame only, so at high speeds most frames are skipped.
+//   Space: pause, Left/Right: step one frame, Up/Down: double/halve speed,
+//   PageUp/PageDown: jump 10% back/forward, Home/End: start/end
+int replay(Configuration conf, const std::string &path, float speed) {
+  ReplayFile file;
+  if (!file.open(path)) {
+    spdlog::critical("Failed to open the replay file {}", path);
+    return 1;
+  }
+  if (file.keyframeBefore(file.size() - 1) < 0) {
+    spdlog::critical("The replay has no keyframe");
+    return 1;
+  }
+  ReplayPlayer player(file);
+  int first = 0;
+  while (file.keyframeBefore(first) < 0) {
+    first++;
+  }
+  player.seek(first);
+  setGridSize(conf, player.getDecoder());
+  const int firstFrame = file.getFrame(first);
+  const int lastFrame = file.getFrame(file.size() - 1);
+  spdlog::info("Replay of {} frames, playing at {}x",
+               lastFrame - firstFrame + 1, speed);
+
+  GameRenderer renderer(conf);
+  auto queue = std::make_shared<EventQueue>();
+  renderer.setEventQueue(queue);
+  bool paused = false;
+  const int jump = std::max(1, (lastFrame - firstFrame) / 10);
+  auto controls = [&](sf::Event &event) {
+    if (event.type != sf::Event::KeyPressed) {
+      return;
+    }
+    switch (event.key.code) {
+    case sf::Keyboard::Space:
+      paused = !paused;
+      break;
+    case sf::Keyboard::Right:
+      paused = true;
+      player.stepFrames(1);
+      break;
+    case sf::Keyboard::Left:
+      paused = true;
+      player.stepFrames(-1);
+      break;
+    case sf::Keyboard::Up:
+      speed *= 2;
+      spdlog::info("Playing at {}x", speed);
+      break;
+    case sf::Keyboard::Down:
+      speed /= 2;
+      spdlog::info("Playing at {}x", speed);
+      break;
+    case sf::Keyboard::PageUp:
+      player.stepFrames(-jump);
+      break;
+    case sf::Keyboard::PageDown:
+      player.stepFrames(jump);
+      break;
+    case sf::Keyboard::Home:
+      player.seek(first);
+      break;
+    case sf::Keyboard::End:
+      player.seek(file.size() - 1);
+      break;
+    default:
+      break;
+    }
+  };
+  sf::Clock clock;
+  double due = 0; // Frames to play, fractional at low speeds
+  while (renderer.isOpen()) {
+    renderer.handleEvents({controls});
+    auto elapsed = clock.restart();
+    if (!paused && !player.atEnd()) {
+      due += elapsed.asSeconds() * 1000 * speed / conf.tickPeriod;
+      int frames = static_cast<int>(std::floor(due));
+      due -= frames;
+      // Frames of the game, not messages: the replay can miss some
+      player.stepFrames(frames);
+    } else {
+      due = 0;
+    }
+    for (const auto &event : player.takeEvents()) {
+      queue->push(event);
+    }
+    renderer.render(player.getSnapshot());
+  }
+  return 0;
+}
+
+void usage(const char *name) {
+  spdlog::critical("Usage: {} <config_file> <host:port>", name);
+  spdlog::critical("       {} <config_file> --replay <replay_file> [speed]",
+                   name);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    usage(argv[0]);
+  }
+  Configuration conf(argv[1]);
+  std::string target = argv[2];
+  if (target == "--replay") {
+    if (argc < 4) {
+      usage(argv[0]);
+    }
+    return replay(conf, argv[3], argc > 4 ? std::stof(argv[4]) : 1);
+  }
+  auto colon = target.rfind(':');
+  if (colon == std::string::npos) {
+    usage(argv[0]);
+  }
+  return watch(conf, target.substr(0, colon),
+               std::stoi(target.substr(colon + 1)));
+}
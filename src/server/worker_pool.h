@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace cycles_server {
+
+// Threads that split one job at a time with the calling thread, for the short
+// parallel phases inside a tick. Unlike TickPipeline there is no queue and no
+// allocation per job: run() hands out the parts and blocks until all are
+// done.
+class WorkerPool {
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable finished;
+  // The current job, read under the mutex
+  void (*invoke)(void *, int) = nullptr;
+  void *job = nullptr;
+  int parts = 0;
+  unsigned generation = 0;
+  std::atomic<int> next = 0;
+  int arrived = 0; // Helpers that saw the current job
+  int working = 0; // Helpers running parts of it
+  bool stopping = false;
+
+  static void help(void (*invoke)(void *, int), void *job, int parts,
+                   std::atomic<int> &next) {
+    for (int part = next++; part < parts; part = next++) {
+      invoke(job, part);
+    }
+  }
+
+  void work() {
+    unsigned seen = 0;
+    std::unique_lock lock(mutex);
+    while (true) {
+      wakeUp.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+      auto currentInvoke = invoke;
+      auto currentJob = job;
+      int currentParts = parts;
+      arrived++;
+      working++;
+      lock.unlock();
+      help(currentInvoke, currentJob, currentParts, next);
+      lock.lock();
+      working--;
+      finished.notify_one();
+    }
+  }
+
+public:
+  explicit WorkerPool(int helpers) {
+    for (int i = 0; i < helpers; i++) {
+      threads.emplace_back(&WorkerPool::work, this);
+    }
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool() {
+    {
+      std::scoped_lock lock(mutex);
+      stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  // Threads a job is split between, the caller included
+  int size() const { return static_cast<int>(threads.size()) + 1; }
+
+  // Call f(part) for every part in [0, count) and wait for all of them.
+  // Returns once every helper has seen the job, so none can pick up a part
+  // of it after f is gone.
+  template <typename F> void run(int count, F &&f) {
+    using Job = std::remove_reference_t<F>;
+    {
+      std::scoped_lock lock(mutex);
+      invoke = [](void *job, int part) { (*static_cast<Job *>(job))(part); };
+      job = const_cast<void *>(static_cast<const void *>(&f));
+      parts = count;
+      next = 0;
+      arrived = 0;
+      generation++;
+    }
+    wakeUp.notify_all();
+    help(invoke, job, count, next);
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [this] {
+      return arrived == static_cast<int>(threads.size()) && working == 0;
+    });
+  }
+};
+
+} // namespace cycles_server
@@ -0,0 +1,78 @@
+// Compare BoardAnalysis::update with an analysis from scratch along a game
+// of bots that mostly go straight.
+// Not part of ctest, run ./bench_analysis after building in Release.
+#include "board_analysis.h"
+#include "server/game_logic.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace cycles_server;
+
+// Milliseconds per frame of update and of a rebuild, over the same states
+std::pair<double, double> run(int size, int players, int frames) {
+  Configuration conf("");
+  conf.gridWidth = size;
+  conf.gridHeight = size;
+  conf.seed = 7;
+  Game game(conf);
+  for (int i = 0; i < players; i++) {
+    game.addPlayer("player" + std::to_string(i));
+  }
+  std::mt19937 rng(11);
+  std::map<Id, Direction> headings;
+  cycles::GameState state;
+  state.gridWidth = size;
+  state.gridHeight = size;
+  state.grid.resize(size * size);
+  cycles::BoardAnalysis analysis;
+  std::chrono::duration<double, std::milli> updates{0};
+  std::chrono::duration<double, std::milli> rebuilds{0};
+  long checksum = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    game.setFrame(frame);
+    state.frameNumber = frame;
+    game.forEachGridRow([&, y = 0](const Id *row, int width) mutable {
+      std::copy(row, row + width, state.grid.begin() + y++ * width);
+    });
+    state.players.clear();
+    std::map<Id, Direction> directions;
+    for (const auto &[id, player] : game.getPlayers()) {
+      state.players.push_back({player.name, player.color, player.position, id});
+      // Mostly straight, a turn now and then
+      auto &heading = headings[id];
+      if (rng() % 16 == 0) {
+        heading = static_cast<Direction>((static_cast<int>(heading) +
+                                          (rng() % 2 ? 1 : 3)) % 4);
+      }
+      directions[id] = heading;
+    }
+    auto start = std::chrono::steady_clock::now();
+    analysis.update(state);
+    updates += std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    cycles::BoardAnalysis scratch(state);
+    rebuilds += std::chrono::steady_clock::now() - start;
+    checksum += analysis.territory(cycles::BoardAnalysis::contested) +
+                scratch.territory(cycles::BoardAnalysis::contested);
+    game.movePlayers(directions);
+  }
+  if (checksum < 0) {
+    std::cout << "checksum " << checksum << "\n";
+  }
+  return {updates.count() / frames, rebuilds.count() / frames};
+}
+
+int main() {
+  constexpr int frames = 100;
+  for (int size : {200, 500, 1000}) {
+    for (int players : {8, 16}) {
+      auto [update, rebuild] = run(size, players, frames);
+      std::cout << size << "x" << size << " " << players
+                << " players: update " << update << " ms, from scratch "
+                << rebuild << " ms per frame\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Compare the padded board with the unpadded layout on the kernels the game
+// and the bots run the most: legality probes and flood fills.
+// Not part of ctest, run ./bench_board after building in Release.
+#include "server/board.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cycles_server;
+
+template <typename Grid> void fill(Grid &grid, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::bernoulli_distribution occupied(0.3);
+  for (int y = 0; y < grid.getHeight(); y++) {
+    for (int x = 0; x < grid.getWidth(); x++) {
+      grid.at({x, y}) = occupied(rng) ? 1 : 0;
+    }
+  }
+}
+
+// Cells reachable from the centre
+template <typename Grid> int floodFill(const Grid &grid) {
+  std::vector<bool> seen(grid.stride() * (grid.getHeight() + 2), false);
+  std::vector<int> stack;
+  int start = grid.index(grid.getWidth() / 2, grid.getHeight() / 2);
+  stack.push_back(start);
+  seen[start] = true;
+  int reached = 0;
+  auto offsets = grid.neighbourOffsets();
+  while (!stack.empty()) {
+    int cell = stack.back();
+    stack.pop_back();
+    reached++;
+    for (int offset : offsets) {
+      int next = cell + offset;
+      if (grid[next] == 0 && !seen[next]) {
+        seen[next] = true;
+        stack.push_back(next);
+      }
+    }
+  }
+  return reached;
+}
+
+// Free neighbours summed over the board, what a move evaluation does
+template <typename Grid> long probe(const Grid &grid) {
+  long free = 0;
+  for (int y = 0; y < grid.getHeight(); y++) {
+    for (int x = 0; x < grid.getWidth(); x++) {
+      free += grid.freeNeighbours(grid.index(x, y));
+    }
+  }
+  return free;
+}
+
+// The layout the game used before the board: row-major without border,
+// four comparisons per probe
+long probeUnpadded(const std::vector<Id> &cells, int width, int height) {
+  auto isFree = [&](int x, int y) {
+    return x >= 0 && x < width && y >= 0 && y < height &&
+           cells[y * width + x] == 0;
+  };
+  long free = 0;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      free += isFree(x, y - 1) + isFree(x + 1, y) + isFree(x, y + 1) +
+              isFree(x - 1, y);
+    }
+  }
+  return free;
+}
+
+template <typename F> void time(const std::string &name, F &&f) {
+  constexpr int iterations = 2000;
+  long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    checksum += f(i);
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << name << ": " << elapsed.count() / iterations
+            << " us per iteration (checksum " << checksum << ")\n";
+}
+
+template <typename Grid> void run(const std::string &name, Grid grid) {
+  fill(grid, 42);
+  // Toggling a cell keeps the compiler from hoisting the work out of the loop
+  time(name + " probe", [&grid](int i) {
+    grid.at({i % grid.getWidth(), 0}) ^= 1;
+    return probe(grid);
+  });
+  time(name + " flood fill", [&grid](int i) {
+    grid.at({i % grid.getWidth(), 0}) ^= 1;
+    return floodFill(grid);
+  });
+}
+
+int main() {
+  for (auto [width, height] : {std::pair{100, 100}, {100, 80}}) {
+    auto name = std::to_string(width) + "x" + std::to_string(height);
+    PaddedGrid grid(width, height);
+    fill(grid, 42);
+    auto cells = grid.unpadded();
+    time(name + " unpadded probe", [&](int i) {
+      cells[i % width] ^= 1;
+      return probeUnpadded(cells, width, height);
+    });
+    run(name + " padded", grid);
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+// Compare the serial and the parallel movePlayers with the most players a
+// game can have, on a small and a large grid.
+// Not part of ctest, run ./bench_moves after building in Release.
+#include "server/game_logic.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace cycles_server;
+
+// Microseconds per movePlayers over ticks frames, the same game for any
+// number of threads
+double run(int size, int threads, int ticks) {
+  Configuration conf("");
+  conf.gridWidth = size;
+  conf.gridHeight = size;
+  conf.seed = 7;
+  conf.moveThreads = threads;
+  Game game(conf);
+  for (int i = 0; i < cycles::maxPlayerId; i++) {
+    game.addPlayer("player" + std::to_string(i));
+  }
+  std::mt19937 rng(11);
+  std::map<Id, Direction> headings;
+  std::chrono::duration<double, std::micro> elapsed{0};
+  for (int frame = 0; frame < ticks; frame++) {
+    game.setFrame(frame);
+    std::map<Id, Direction> directions;
+    for (const auto &[id, player] : game.getPlayers()) {
+      // Mostly straight, a turn now and then
+      auto &heading = headings[id];
+      if (rng() % 8 == 0) {
+        heading = static_cast<Direction>((static_cast<int>(heading) +
+                                          (rng() % 2 ? 1 : 3)) % 4);
+      }
+      directions[id] = heading;
+    }
+    auto start = std::chrono::steady_clock::now();
+    game.movePlayers(directions);
+    elapsed += std::chrono::steady_clock::now() - start;
+  }
+  return elapsed.count() / ticks;
+}
+
+int main() {
+  constexpr int ticks = 300;
+  for (int size : {100, 1000}) {
+    for (int threads : {0, 1, 3, 7}) {
+      double perTick = run(size, threads, ticks);
+      std::cout << size << "x" << size << " moveThreads " << threads << ": "
+                << perTick << " us per tick\n";
+    }
+  }
+  return 0;
+}
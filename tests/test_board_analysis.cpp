@@ -0,0 +1,173 @@
+//GTest tests for the incremental distance and territory maps
+#include"board_analysis.h"
+#include"gtest/gtest.h"
+#include<deque>
+#include<map>
+#include<random>
+using namespace cycles;
+
+GameState emptyState(int width, int height) {
+  GameState state;
+  state.gridWidth = width;
+  state.gridHeight = height;
+  state.grid.assign(width * height, 0);
+  state.frameNumber = 0;
+  return state;
+}
+
+// Players moving at random with tails that expire, like the server's
+struct RandomGame {
+  GameState state;
+  std::map<Id, std::deque<sf::Vector2i>> tails; // Head first
+  std::mt19937 rng;
+  std::size_t tailLength;
+
+  RandomGame(int width, int height, int players, unsigned seed,
+             std::size_t tailLength = 30)
+      : state(emptyState(width, height)), rng(seed), tailLength(tailLength) {
+    for (int i = 1; i <= players; i++) {
+      sf::Vector2i head(rng() % width, rng() % height);
+      if (!state.isCellEmpty(head)) {
+        continue;
+      }
+      state.players.push_back({"p" + std::to_string(i), sf::Color(255, 255, 255), head,
+                               static_cast<Id>(i)});
+      set(head, i);
+      tails[i].push_back(head);
+    }
+  }
+
+  void set(sf::Vector2i cell, Id id) {
+    state.grid[cell.y * state.gridWidth + cell.x] = id;
+  }
+
+  // Returns the cells that changed
+  std::vector<int> step() {
+    auto before = state.grid;
+    const sf::Vector2i steps[] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+    std::vector<Player> alive;
+    for (auto player : state.players) {
+      std::vector<sf::Vector2i> targets;
+      for (auto step : steps) {
+        auto target = player.position + step;
+        if (state.isInsideGrid(target) && state.isCellEmpty(target)) {
+          targets.push_back(target);
+        }
+      }
+      auto &tail = tails[player.id];
+      if (targets.empty() || rng() % 100 == 0) {
+        for (auto cell : tail) {
+          set(cell, 0);
+        }
+        tails.erase(player.id);
+        continue;
+      }
+      auto target = targets[rng() % targets.size()];
+      set(target, player.id);
+      tail.push_front(target);
+      if (tail.size() > tailLength) {
+        set(tail.back(), 0);
+        tail.pop_back();
+      }
+      player.position = target;
+      alive.push_back(player);
+    }
+    state.players = alive;
+    state.frameNumber++;
+    std::vector<int> changed;
+    for (std::size_t i = 0; i < before.size(); i++) {
+      if (before[i] != state.grid[i]) {
+        changed.push_back(i);
+      }
+    }
+    return changed;
+  }
+};
+
+void expectSameMaps(const BoardAnalysis &incremental, const BoardAnalysis &fresh,
+                    const GameState &state) {
+  for (int y = 0; y < state.gridHeight; y++) {
+    for (int x = 0; x < state.gridWidth; x++) {
+      sf::Vector2i cell(x, y);
+      ASSERT_EQ(incremental.distance(cell), fresh.distance(cell))
+          << x << "," << y << " frame " << state.frameNumber;
+      ASSERT_EQ(incremental.owner(cell), fresh.owner(cell))
+          << x << "," << y << " frame " << state.frameNumber;
+      for (Id id = 1; id <= 6; id++) {
+        ASSERT_EQ(incremental.distance(id, cell), fresh.distance(id, cell))
+            << "player " << int(id) << " " << x << "," << y;
+      }
+    }
+  }
+  for (int id = 0; id < 256; id++) {
+    ASSERT_EQ(incremental.territory(id), fresh.territory(id)) << id;
+  }
+}
+
+TEST(BoardAnalysisTest, DistancesAndOwners) {
+  auto state = emptyState(5, 3);
+  state.players.push_back({"a", sf::Color(255, 255, 255), {0, 1}, 1});
+  state.players.push_back({"b", sf::Color(255, 255, 255), {4, 1}, 2});
+  state.grid[1 * 5 + 0] = 1;
+  state.grid[1 * 5 + 4] = 2;
+  state.grid[0 * 5 + 1] = 2; // Part of b's trail
+  BoardAnalysis analysis;
+  analysis.update(state);
+  EXPECT_EQ(analysis.distance({0, 1}), 0);
+  EXPECT_EQ(analysis.distance({1, 0}), BoardAnalysis::unreachable);
+  EXPECT_EQ(analysis.distance(1, {3, 1}), 3);
+  EXPECT_EQ(analysis.distance(2, {3, 1}), 1);
+  EXPECT_EQ(analysis.distance(3, {3, 1}), BoardAnalysis::unreachable);
+  EXPECT_EQ(analysis.owner({1, 1}), 1);
+  EXPECT_EQ(analysis.owner({3, 1}), 2);
+  EXPECT_EQ(analysis.owner({2, 1}), BoardAnalysis::contested);
+  EXPECT_EQ(analysis.owner({4, 1}), 0);
+  // a: (0,0) (0,2) (1,1) (1,2), b: (3,0) (3,1) (3,2) (4,0) (4,2), column 2
+  // is as far from both
+  EXPECT_EQ(analysis.territory(1), 4);
+  EXPECT_EQ(analysis.territory(2), 5);
+  EXPECT_EQ(analysis.territory(BoardAnalysis::contested), 3);
+}
+
+TEST(BoardAnalysisTest, IncrementalMatchesRebuild) {
+  for (unsigned seed = 1; seed <= 4; seed++) {
+    RandomGame game(48, 32, 6, seed);
+    BoardAnalysis incremental;
+    incremental.update(game.state);
+    std::vector<int> changed;
+    for (int frame = 0; frame < 200 && !game.state.players.empty(); frame++) {
+      auto step = game.step();
+      changed.insert(changed.end(), step.begin(), step.end());
+      // Some states are skipped, as when the client drops stale ones
+      if (frame % 7 == 3) {
+        continue;
+      }
+      if (seed % 2 == 0) {
+        incremental.update(game.state);
+      } else {
+        incremental.update(game.state, changed);
+      }
+      changed.clear();
+      BoardAnalysis fresh(game.state);
+      expectSameMaps(incremental, fresh, game.state);
+      if (HasFatalFailure()) {
+        return;
+      }
+    }
+  }
+}
+
+TEST(BoardAnalysisTest, RepairsLessThanARebuild) {
+  RandomGame game(200, 200, 8, 3, 55);
+  BoardAnalysis analysis(game.state);
+  long repaired = 0;
+  long rebuilt = 0;
+  for (int frame = 0; frame < 100 && !game.state.players.empty(); frame++) {
+    game.step();
+    analysis.update(game.state);
+    repaired += analysis.repairedCells();
+    rebuilt += BoardAnalysis(game.state).repairedCells();
+  }
+  ASSERT_GT(rebuilt, 0);
+  EXPECT_LT(repaired * 2, rebuilt);
+}
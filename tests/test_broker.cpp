@@ -0,0 +1,88 @@
+//GTest tests for the broker's choice of server
+#include"server/broker.h"
+#include"gtest/gtest.h"
+using namespace cycles_server;
+
+LoadReport lobby(const std::string &host, int port, int players,
+                 int maxClients = 4) {
+  LoadReport report;
+  report.host = host;
+  report.port = port;
+  report.players = players;
+  report.maxClients = maxClients;
+  report.accepting = true;
+  report.tickPeriod = 33;
+  return report;
+}
+
+LoadReport match(const std::string &host, int port, float tickP99) {
+  auto report = lobby(host, port, 4);
+  report.accepting = false;
+  report.playing = true;
+  report.tickP99 = tickP99;
+  return report;
+}
+
+TEST(BrokerTest, LeastLoadedHost) {
+  Broker broker;
+  auto now = sf::seconds(10);
+  broker.report(lobby("a", 1, 0), now);
+  broker.report(match("a", 2, 10), now);
+  broker.report(lobby("b", 1, 0), now);
+  EXPECT_FLOAT_EQ(broker.hostLoad("a", now), 1 + 10 / 33.f);
+  auto server = broker.assign(now);
+  ASSERT_TRUE(server);
+  EXPECT_EQ(server->first, "b");
+  // A running match weighs more than a busy cpu
+  auto busy = lobby("b", 1, 1);
+  busy.cpu = 0.9f;
+  broker.report(busy, now);
+  broker.report(match("a", 2, 0), now);
+  EXPECT_EQ(broker.assign(now)->first, "b");
+  // Until it ends
+  auto ended = match("a", 2, 0);
+  ended.playing = false;
+  broker.report(ended, now);
+  EXPECT_EQ(broker.assign(now)->first, "a");
+}
+
+TEST(BrokerTest, FillsLobbies) {
+  Broker broker;
+  auto now = sf::seconds(10);
+  broker.report(lobby("a", 1, 1), now);
+  broker.report(lobby("a", 2, 2), now);
+  // The fullest lobby first, counting the clients sent since its report
+  EXPECT_EQ(broker.assign(now)->second, 2);
+  EXPECT_EQ(broker.assign(now)->second, 2);
+  EXPECT_EQ(broker.assign(now)->second, 1);
+  // The report shows the two that joined
+  broker.report(lobby("a", 2, 4), now);
+  EXPECT_EQ(broker.assign(now)->second, 1);
+  EXPECT_EQ(broker.assign(now)->second, 1);
+  EXPECT_FALSE(broker.assign(now));
+  // Servers that stopped reporting are left out
+  broker.report(lobby("b", 1, 0), now);
+  EXPECT_FALSE(broker.assign(now + sf::seconds(5)));
+}
+
+TEST(BrokerTest, Packets) {
+  sf::Packet packet;
+  auto sent = match("host", 50017, 12.5f);
+  sent.cpu = 0.25f;
+  write(packet, sent);
+  LoadReport received;
+  ASSERT_TRUE(read(packet, received));
+  EXPECT_EQ(received.host, "host");
+  EXPECT_EQ(received.port, 50017);
+  EXPECT_TRUE(received.playing);
+  EXPECT_FLOAT_EQ(received.tickP99, 12.5f);
+  EXPECT_FLOAT_EQ(received.cpu, 0.25f);
+  sf::Packet redirect;
+  writeRedirect(redirect, "h", 1);
+  std::string tag, host;
+  int port = 0;
+  ASSERT_TRUE(redirect >> tag >> host >> port);
+  EXPECT_EQ(tag, "redirect");
+  EXPECT_EQ(host, "h");
+  EXPECT_EQ(port, 1);
+}
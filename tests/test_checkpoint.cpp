@@ -0,0 +1,94 @@
+//GTest tests for saving and restoring a match
+#include"server/checkpoint.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+#include<fstream>
+#include<random>
+using namespace cycles_server;
+
+Configuration checkpointConfig(int width = 200) {
+  return Configuration(writeConfig("gridHeight: 150\ngridWidth: " +
+                                   std::to_string(width) + "\nseed: 7\n"));
+}
+
+// Random moves for the players of a game, the same for the same rng
+std::map<Id, Direction> randomMoves(Game &game, std::mt19937 &rng) {
+  std::map<Id, Direction> directions;
+  for (const auto &[id, player] : game.getPlayers()) {
+    directions[id] = static_cast<Direction>(rng() % 4);
+  }
+  return directions;
+}
+
+TEST(CheckpointTest, ResumesTheSameGame) {
+  Game original(checkpointConfig());
+  for (int i = 0; i < 30; i++) {
+    original.addPlayer("player" + std::to_string(i));
+  }
+  std::mt19937 rng(1);
+  for (int frame = 0; frame < 40; frame++) {
+    original.setFrame(frame);
+    original.movePlayers(randomMoves(original, rng));
+  }
+  Checkpoint saved;
+  saved.game = original.save();
+  saved.sessions.push_back({3, "player2", 0x1234567890abcdefull, 2, 1});
+  MatchRecorder::Entry entry;
+  entry.result = {5, "player4", 0, 12, "removed"};
+  entry.out = true;
+  saved.standings.push_back(entry);
+  sf::Packet packet;
+  write(packet, saved);
+  // Mostly empty cells, far less than a byte per cell
+  EXPECT_LT(packet.getDataSize(), saved.game.grid.size() / 4);
+  Checkpoint loaded;
+  ASSERT_TRUE(read(packet, loaded));
+  ASSERT_EQ(loaded.sessions.size(), 1u);
+  EXPECT_EQ(loaded.sessions[0].token, 0x1234567890abcdefull);
+  EXPECT_EQ(loaded.sessions[0].lastDirection, 2);
+  ASSERT_EQ(loaded.standings.size(), 1u);
+  EXPECT_EQ(loaded.standings[0].result.outcome, "removed");
+  EXPECT_TRUE(loaded.standings[0].out);
+
+  Game restored(checkpointConfig());
+  ASSERT_TRUE(restored.restore(loaded.game));
+  EXPECT_EQ(restored.getFrame(), original.getFrame());
+  auto restoredRng = rng;
+  for (int frame = 40; frame < 80; frame++) {
+    original.setFrame(frame);
+    restored.setFrame(frame);
+    original.movePlayers(randomMoves(original, rng));
+    restored.movePlayers(randomMoves(restored, restoredRng));
+    ASSERT_EQ(original.getGrid(), restored.getGrid()) << "frame " << frame;
+  }
+  auto players = original.getPlayers();
+  for (const auto &[id, player] : restored.getPlayers()) {
+    EXPECT_EQ(player.position, players.at(id).position);
+    EXPECT_EQ(player.tail, players.at(id).tail);
+  }
+  // Same spawns too
+  auto id = original.addPlayer("late");
+  EXPECT_EQ(restored.addPlayer("late"), id);
+  EXPECT_EQ(restored.getPlayers().at(id).position,
+            original.getPlayers().at(id).position);
+}
+
+TEST(CheckpointTest, Files) {
+  Game game(checkpointConfig());
+  game.addPlayer("a");
+  game.addPlayer("b");
+  Checkpoint saved;
+  saved.game = game.save();
+  auto path = std::string(std::tmpnam(nullptr));
+  ASSERT_TRUE(writeCheckpoint(path, saved));
+  auto loaded = readCheckpoint(path);
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(loaded->game.grid, saved.game.grid);
+  EXPECT_EQ(loaded->game.players.size(), 2u);
+  // A game of another size can not take it
+  Game other(checkpointConfig(100));
+  EXPECT_FALSE(other.restore(loaded->game));
+  std::ofstream(path) << "not a checkpoint";
+  EXPECT_FALSE(readCheckpoint(path));
+  EXPECT_FALSE(readCheckpoint(path + ".missing"));
+}
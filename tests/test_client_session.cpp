@@ -0,0 +1,90 @@
+//GTest tests for the client protocol of the server
+#include"server/client_session.h"
+#include"gtest/gtest.h"
+using namespace cycles_server;
+
+// A submission as cycles::Connection::sendPlan packs it
+sf::Packet planPacket(int firstFrame, const std::vector<int> &directions) {
+  sf::Packet packet;
+  packet << firstFrame << static_cast<sf::Uint32>(directions.size());
+  for (int direction : directions) {
+    packet << direction;
+  }
+  return packet;
+}
+
+TEST(ClientSessionTest, GameStateRoundTrip) {
+  std::map<Id, Player> players;
+  Player player;
+  player.id = 3;
+  player.name = "bot";
+  player.position = {2, 1};
+  player.color = sf::Color(10, 20, 30);
+  players[3] = player;
+  sf::Packet packet;
+  writeGameState(packet, 4, 2, players, 17);
+  const Id grid[] = {0, 0, 0, 0, 0, 0, 3, 0};
+  packet.append(grid, sizeof(grid));
+
+  cycles::GameState state(packet);
+  EXPECT_EQ(state.gridWidth, 4);
+  EXPECT_EQ(state.gridHeight, 2);
+  EXPECT_EQ(state.frameNumber, 17);
+  ASSERT_EQ(state.players.size(), 1u);
+  EXPECT_EQ(state.players[0].id, 3);
+  EXPECT_EQ(state.players[0].name, "bot");
+  EXPECT_EQ(state.players[0].position, sf::Vector2i(2, 1));
+  EXPECT_EQ(state.getGridCell({2, 1}), 3);
+}
+
+TEST(ClientSessionTest, PlansForTheFrame) {
+  MovePlan plan;
+  auto packet = planPacket(10, {0, 1, 2});
+  ASSERT_EQ(readPlan(packet, 10, 64, plan), PlanStatus::accepted);
+  EXPECT_EQ(plan.firstFrame, 10);
+  EXPECT_EQ(plan.at(12), Direction::south);
+  EXPECT_FALSE(plan.covers(13));
+
+  // Started two frames ago, the passed directions are dropped
+  packet = planPacket(8, {3, 3, 1, 0});
+  ASSERT_EQ(readPlan(packet, 10, 64, plan), PlanStatus::accepted);
+  EXPECT_EQ(plan.firstFrame, 10);
+  EXPECT_EQ(plan.directions.size(), 2u);
+  EXPECT_EQ(plan.at(10), Direction::east);
+
+  // Longer than allowed
+  packet = planPacket(10, {0, 1, 2, 3, 0, 1});
+  ASSERT_EQ(readPlan(packet, 10, 4, plan), PlanStatus::accepted);
+  EXPECT_EQ(plan.directions.size(), 4u);
+}
+
+TEST(ClientSessionTest, RejectsStaleAndFutureMoves) {
+  MovePlan plan;
+  auto packet = planPacket(10, {1});
+  ASSERT_EQ(readPlan(packet, 10, 64, plan), PlanStatus::accepted);
+  // A move for the previous frame, one for the next, and a plan that ended
+  for (auto [first, count] : {std::pair{9, 1}, {11, 1}, {5, 3}}) {
+    packet = planPacket(first, std::vector<int>(count, 2));
+    EXPECT_EQ(readPlan(packet, 10, 64, plan), PlanStatus::outdated) << first;
+  }
+  // The accepted plan is kept
+  EXPECT_EQ(plan.firstFrame, 10);
+  EXPECT_EQ(plan.at(10), Direction::east);
+}
+
+TEST(ClientSessionTest, RejectsMalformedMoves) {
+  MovePlan plan;
+  sf::Packet empty;
+  EXPECT_EQ(readPlan(empty, 0, 64, plan), PlanStatus::malformed);
+  auto packet = planPacket(0, {});
+  EXPECT_EQ(readPlan(packet, 0, 64, plan), PlanStatus::malformed);
+  packet = planPacket(0, {0, 4});
+  EXPECT_EQ(readPlan(packet, 0, 64, plan), PlanStatus::malformed);
+  packet = planPacket(0, {-1});
+  EXPECT_EQ(readPlan(packet, 0, 64, plan), PlanStatus::malformed);
+  // Fewer directions than announced
+  packet.clear();
+  packet << 0 << sf::Uint32(3) << 1;
+  EXPECT_EQ(readPlan(packet, 0, 64, plan), PlanStatus::malformed);
+  EXPECT_TRUE(plan.directions.empty());
+}
@@ -0,0 +1,23 @@
+// Temporary configuration files for the tests
+#pragma once
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// Writes the yaml to a temporary file and returns its path
+inline std::string writeConfig(const std::string &yaml) {
+  std::string path = std::tmpnam(nullptr);
+  std::ofstream(path) << yaml;
+  return path;
+}
+
+// A 100x100 grid with room for maxClients players
+inline std::string writeConfig(int maxClients = 60) {
+  return writeConfig(R"(
+gameHeight: 1000
+gameWidth: 1000
+gameBannerHeight: 100
+gridHeight: 100
+gridWidth: 100
+)" + std::string("maxClients: ") + std::to_string(maxClients) + "\n");
+}
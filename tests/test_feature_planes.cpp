@@ -0,0 +1,194 @@
+//GTest tests for the feature planes of the bots
+#include"feature_planes.h"
+#include"gtest/gtest.h"
+#include<random>
+using namespace cycles;
+
+GameState makeState(int width, int height) {
+  GameState state;
+  state.gridWidth = width;
+  state.gridHeight = height;
+  state.grid.assign(width * height, 0);
+  state.frameNumber = 0;
+  return state;
+}
+
+void addPlayer(GameState &state, Id id, sf::Vector2i head,
+               const std::vector<sf::Vector2i> &trail = {}) {
+  state.players.push_back({"p" + std::to_string(id), sf::Color(255, 255, 255), head, id});
+  state.grid[head.y * state.gridWidth + head.x] = id;
+  for (auto cell : trail) {
+    state.grid[cell.y * state.gridWidth + cell.x] = id;
+  }
+}
+
+// Value of a plane at a column and row of the window
+float at(const std::vector<float> &features, const FeatureEncoder &encoder,
+         FeaturePlane plane, int column, int row) {
+  const auto &planes = encoder.getOptions().planes;
+  auto index = std::find(planes.begin(), planes.end(), plane) - planes.begin();
+  int side = encoder.side();
+  return features[(index * side + row) * side + column];
+}
+
+TEST(FeaturesTest, Egocentric) {
+  auto state = makeState(10, 8);
+  addPlayer(state, 1, {2, 2}, {{2, 3}});
+  addPlayer(state, 2, {2, 0}, {{3, 0}});
+  FeatureOptions options;
+  options.radius = 3;
+  FeatureEncoder encoder(options);
+  std::vector<float> features(encoder.size());
+  ASSERT_TRUE(encoder.encode({&state, 1, Direction::north}, features.data()));
+  EXPECT_EQ(at(features, encoder, FeaturePlane::ownHead, 3, 3), 1);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::own, 3, 4), 1);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::opponentHeads, 3, 1), 1);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::opponents, 4, 1), 1);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::opponentHeads, 4, 1), 0);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::free, 3, 2), 1);
+  // Row 0 is above the grid, column 0 left of it
+  for (int i = 0; i < encoder.side(); i++) {
+    EXPECT_EQ(at(features, encoder, FeaturePlane::wall, i, 0), 1);
+    EXPECT_EQ(at(features, encoder, FeaturePlane::free, i, 0), 0);
+  }
+  EXPECT_EQ(at(features, encoder, FeaturePlane::wall, 0, 3), 1);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::wall, 1, 3), 0);
+  // Half the smaller side is 4, the head is 3 steps from the top
+  EXPECT_FLOAT_EQ(at(features, encoder, FeaturePlane::wallDistance, 3, 3),
+                  0.75f);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::wallDistance, 3, 0), 0);
+  EXPECT_FALSE(encoder.encode({&state, 3, Direction::north}, features.data()));
+}
+
+TEST(FeaturesTest, Rotation) {
+  auto state = makeState(10, 8);
+  addPlayer(state, 1, {0, 2});
+  addPlayer(state, 2, {3, 2});
+  FeatureOptions options;
+  options.radius = 3;
+  FeatureEncoder encoder(options);
+  std::vector<float> features(encoder.size());
+  // Heading east, the opponent 3 cells east is straight up
+  encoder.encode({&state, 1, Direction::east}, features.data());
+  EXPECT_EQ(at(features, encoder, FeaturePlane::opponentHeads, 3, 0), 1);
+  // and the wall behind on the left (west) is below
+  EXPECT_EQ(at(features, encoder, FeaturePlane::wall, 3, 4), 1);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::wall, 3, 2), 0);
+  // Heading west the wall is straight ahead and the opponent behind
+  encoder.encode({&state, 1, Direction::west}, features.data());
+  EXPECT_EQ(at(features, encoder, FeaturePlane::wall, 3, 2), 1);
+  EXPECT_EQ(at(features, encoder, FeaturePlane::opponentHeads, 3, 6), 1);
+  // Heading south, east is on the left
+  encoder.encode({&state, 1, Direction::south}, features.data());
+  EXPECT_EQ(at(features, encoder, FeaturePlane::opponentHeads, 0, 3), 1);
+  // Without rotation north is always up
+  options.rotate = false;
+  FeatureEncoder fixed(options);
+  fixed.encode({&state, 1, Direction::south}, features.data());
+  EXPECT_EQ(at(features, fixed, FeaturePlane::opponentHeads, 6, 3), 1);
+}
+
+// Every plane computed cell by cell, the way the encoder replaces
+std::vector<float> reference(const GameState &state, Id player,
+                             Direction heading, int radius) {
+  int side = 2 * radius + 1;
+  std::vector<float> planes(7 * side * side, 0);
+  sf::Vector2i head;
+  for (const auto &p : state.players) {
+    if (p.id == player) {
+      head = p.position;
+    }
+  }
+  auto turn = [](sf::Vector2i v, int quarters) {
+    for (int i = 0; i < quarters; i++) {
+      v = {-v.y, v.x};
+    }
+    return v;
+  };
+  int quarters = static_cast<int>(heading);
+  float half = (std::min(state.gridWidth, state.gridHeight) + 1) / 2;
+  for (int row = 0; row < side; row++) {
+    for (int column = 0; column < side; column++) {
+      auto cell = head + turn({column - radius, row - radius}, quarters);
+      auto value = [&](int plane) -> float & {
+        return planes[(plane * side + row) * side + column];
+      };
+      if (!state.isInsideGrid(cell)) {
+        value(1) = 1;
+        continue;
+      }
+      Id id = state.getGridCell(cell);
+      value(0) = id == 0;
+      value(2) = id == player;
+      value(3) = cell == head;
+      value(4) = id != 0 && id != player;
+      for (const auto &p : state.players) {
+        value(5) = value(5) || (p.id != player && p.position == cell);
+      }
+      int steps = std::min({cell.x + 1, cell.y + 1, state.gridWidth - cell.x,
+                            state.gridHeight - cell.y});
+      value(6) = std::min(1.f, steps / half);
+    }
+  }
+  return planes;
+}
+
+TEST(FeaturesTest, MatchesReference) {
+  std::mt19937 rng(3);
+  FeatureOptions options;
+  options.radius = 6;
+  FeatureEncoder encoder(options);
+  std::vector<float> features(encoder.size());
+  std::vector<std::uint8_t> bytes(encoder.size());
+  for (int round = 0; round < 20; round++) {
+    auto state = makeState(13 + round, 9 + round % 5);
+    for (auto &cell : state.grid) {
+      cell = rng() % 3 == 0 ? 1 + rng() % 4 : 0;
+    }
+    for (Id id = 1; id <= 4; id++) {
+      sf::Vector2i head(rng() % state.gridWidth, rng() % state.gridHeight);
+      addPlayer(state, id, head);
+    }
+    for (int heading = 0; heading < 4; heading++) {
+      FeatureInput input{&state, 2, static_cast<Direction>(heading)};
+      auto expected = reference(state, 2, input.heading, options.radius);
+      ASSERT_TRUE(encoder.encode(input, features.data()));
+      ASSERT_TRUE(encoder.encode(input, bytes.data()));
+      for (std::size_t i = 0; i < expected.size(); i++) {
+        ASSERT_FLOAT_EQ(features[i], expected[i]) << "value " << i;
+        ASSERT_EQ(bytes[i], std::lround(expected[i] * (i >= 6 * 169 ? 255 : 1)))
+            << "value " << i;
+      }
+    }
+  }
+}
+
+TEST(FeaturesTest, BatchAndCInterface) {
+  auto state = makeState(20, 20);
+  addPlayer(state, 1, {5, 5}, {{5, 6}, {5, 7}});
+  addPlayer(state, 2, {8, 5}, {{9, 5}});
+  FeatureEncoder encoder;
+  std::vector<float> batch(3 * encoder.size(), -1);
+  std::vector<FeatureInput> inputs = {{&state, 1, Direction::north},
+                                      {&state, 9, Direction::north},
+                                      {&state, 2, Direction::west}};
+  EXPECT_EQ(encoder.encodeBatch(inputs, batch.data()), 2);
+  std::vector<float> single(encoder.size());
+  encoder.encode(inputs[2], single.data());
+  EXPECT_TRUE(std::equal(single.begin(), single.end(),
+                         batch.begin() + 2 * encoder.size()));
+  // The missing player's values are left alone
+  EXPECT_EQ(batch[encoder.size()], -1);
+
+  ASSERT_EQ(cycles_feature_size(7), static_cast<int>(encoder.size()));
+  int heads[] = {5, 5, 8, 5};
+  std::uint8_t ids[] = {1, 2};
+  std::vector<float> raw(encoder.size());
+  EXPECT_EQ(cycles_encode_features(state.grid.data(), 20, 20, heads, ids, 2, 2,
+                                   3, 7, 1, raw.data()),
+            0);
+  EXPECT_EQ(raw, single);
+  EXPECT_EQ(cycles_encode_features(state.grid.data(), 20, 20, heads, ids, 2, 9,
+                                   3, 7, 1, raw.data()),
+            -1);
+}
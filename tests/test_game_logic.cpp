@@ -1,7 +1,7 @@
 //GTest tests for game logic
 #include"server/game_logic.h"
 #include"gtest/gtest.h"
-#include<fstream>
+#include"test_config.h"
 using cycles::Id;
 using namespace cycles_server;
 // Game Logic
@@ -50,21 +50,6 @@ using namespace cycles_server;
 
 // };
 
-std::string writeConfig(){
-  std::string conf_yaml = R"(
-gameHeight: 1000
-gameWidth: 1000
-gameBannerHeight: 100
-gridHeight: 100
-gridWidth: 100
-maxClients: 60
-)";
-  auto temp_file = std::tmpnam(nullptr);
-  std::ofstream out(temp_file);
-  out<<conf_yaml;
-  return temp_file;
-}
-
 bool test_grid(std::vector<sf::Uint8> grid, std::map<Id, Player> players, Configuration conf) {
   int GRID_HEIGHT = conf.gridHeight;
   int GRID_WIDTH = conf.gridWidth;
@@ -155,3 +140,178 @@ TEST(GameLogicTest, Grid){
   auto players = game.getPlayers();
   EXPECT_TRUE(test_grid(grid, players, conf));
 }
+
+TEST(GameLogicTest, DeathEvents){
+  std::string conf_file = writeConfig();
+  Configuration conf(conf_file);
+  Game game(conf);
+  auto events = game.subscribe();
+  Id id = game.addPlayer("player1");
+  std::map<Id, Direction> directions;
+  directions[id] = Direction::north;
+  // Moving north always ends up leaving the grid
+  for (int i = 0; i <= conf.gridHeight && game.getPlayers().size() > 0; i++) {
+    game.setFrame(i);
+    game.movePlayers(directions);
+  }
+  EXPECT_EQ(game.getPlayers().size(), 0);
+  GameEvent event;
+  ASSERT_TRUE(events->pop(event));
+  EXPECT_EQ(event.type, GameEvent::Type::playerDied);
+  EXPECT_EQ(event.player, id);
+  EXPECT_EQ(event.cause, DeathCause::wall);
+  ASSERT_TRUE(events->pop(event));
+  EXPECT_EQ(event.type, GameEvent::Type::playerRemoved);
+  EXPECT_EQ(event.player, id);
+  EXPECT_EQ(event.frame, game.getFrame());
+  EXPECT_FALSE(events->pop(event));
+}
+
+TEST(GameLogicTest, RemoveEvent){
+  std::string conf_file = writeConfig();
+  Configuration conf(conf_file);
+  Game game(conf);
+  auto events = game.subscribe();
+  auto otherEvents = game.subscribe();
+  Id id = game.addPlayer("player1");
+  game.removePlayer(id);
+  game.removePlayer(id);
+  for (auto queue : {events, otherEvents}) {
+    GameEvent event;
+    ASSERT_TRUE(queue->pop(event));
+    EXPECT_EQ(event.type, GameEvent::Type::playerRemoved);
+    EXPECT_EQ(event.player, id);
+    EXPECT_FALSE(queue->pop(event));
+  }
+}
+
+TEST(GameLogicTest, EventsBeyondTheRing){
+  EventQueue queue;
+  // More than the ring holds, with the consumer catching up half way
+  for (int i = 0; i < 3000; i++) {
+    queue.push({GameEvent::Type::playerRemoved, static_cast<Id>(i % 250), DeathCause::wall, 0, i});
+  }
+  GameEvent event;
+  for (int i = 0; i < 1500; i++) {
+    ASSERT_TRUE(queue.pop(event));
+    ASSERT_EQ(event.frame, i);
+  }
+  for (int i = 3000; i < 4000; i++) {
+    queue.push({GameEvent::Type::playerRemoved, 1, DeathCause::wall, 0, i});
+  }
+  for (int i = 1500; i < 4000; i++) {
+    ASSERT_TRUE(queue.pop(event));
+    ASSERT_EQ(event.frame, i);
+  }
+  EXPECT_FALSE(queue.pop(event));
+  // Back to the ring once the overflow is empty
+  queue.push({GameEvent::Type::playerDied, 2, DeathCause::trail, 0, 4000});
+  ASSERT_TRUE(queue.pop(event));
+  EXPECT_EQ(event.frame, 4000);
+}
+
+TEST(GameLogicTest, PaddedGrid){
+  PaddedGrid grid(100, 80);
+  for (sf::Vector2i outside : {sf::Vector2i(-1, 0), sf::Vector2i(100, 79),
+                               sf::Vector2i(50, -1), sf::Vector2i(0, 80)}) {
+    EXPECT_EQ(grid.at(outside), PaddedGrid::wall);
+  }
+  grid.at({3, 2}) = 7;
+  EXPECT_EQ(grid.freeNeighbours(grid.index(0, 0)), 2);
+  EXPECT_EQ(grid.freeNeighbours(grid.index(3, 1)), 3);
+  auto cells = grid.unpadded();
+  ASSERT_EQ(cells.size(), 100 * 80);
+  EXPECT_EQ(cells[2 * 100 + 3], 7);
+}
+
+TEST(GameLogicTest, MaxClientsBelowTheWall){
+  Configuration conf(writeConfig(300));
+  EXPECT_EQ(conf.maxClients, cycles::maxPlayerId);
+  EXPECT_NE(PaddedGrid::wall, conf.maxClients);
+}
+
+TEST(GameLogicTest, Journal){
+  std::string conf_file = writeConfig();
+  Configuration conf(conf_file);
+  Game game(conf);
+  for (int i = 0; i < 6; i++) {
+    game.addPlayer("player" + std::to_string(i));
+  }
+  auto grid = std::vector<sf::Uint8>(conf.gridWidth * conf.gridHeight, 0);
+  for (int frame = 0; frame < 200; frame++) {
+    game.setFrame(frame);
+    auto players = game.getPlayers();
+    if (frame == 50 && !players.empty()) {
+      // Between two ticks, part of the next journal
+      game.removePlayer(players.begin()->first);
+    }
+    std::map<Id, Direction> directions;
+    for (const auto &[id, player] : game.getPlayers()) {
+      directions[id] = static_cast<Direction>((frame / 10 + id) % 4);
+    }
+    game.movePlayers(directions);
+    // A move changes a cell or two per player, a death the whole player
+    for (const auto &change : game.getJournal()) {
+      EXPECT_EQ(grid[change.cell], change.before);
+      grid[change.cell] = change.after;
+    }
+    ASSERT_EQ(grid, game.getGrid()) << "frame " << frame;
+  }
+}
+
+TEST(GameLogicTest, ParallelMoves){
+  for (unsigned seed : {1u, 2u, 3u}) {
+    auto config = [seed](int moveThreads) {
+      return Configuration(writeConfig(
+          "gridHeight: 40\ngridWidth: 50\nseed: " + std::to_string(seed) +
+          "\nmoveThreads: " + std::to_string(moveThreads) + "\n"));
+    };
+    Game serial(config(0));
+    Game parallel(config(3));
+    auto serialEvents = serial.subscribe();
+    auto parallelEvents = parallel.subscribe();
+    for (int i = 0; i < 200; i++) {
+      serial.addPlayer("player" + std::to_string(i));
+      parallel.addPlayer("player" + std::to_string(i));
+    }
+    // Crowded enough for every kind of death, head-on included
+    std::mt19937 rng(seed);
+    std::map<Id, Direction> directions;
+    for (int frame = 0; frame < 300 && !serial.getPlayers().empty(); frame++) {
+      serial.setFrame(frame);
+      parallel.setFrame(frame);
+      for (const auto &[id, player] : serial.getPlayers()) {
+        if (!directions.count(id) || rng() % 4 == 0) {
+          directions[id] = static_cast<Direction>(rng() % 4);
+        }
+      }
+      serial.movePlayers(directions);
+      parallel.movePlayers(directions);
+      ASSERT_EQ(serial.getGrid(), parallel.getGrid()) << "frame " << frame;
+      auto serialPlayers = serial.getPlayers();
+      auto parallelPlayers = parallel.getPlayers();
+      ASSERT_EQ(serialPlayers.size(), parallelPlayers.size());
+      for (const auto &[id, player] : serialPlayers) {
+        EXPECT_EQ(player.position, parallelPlayers[id].position);
+        EXPECT_EQ(player.tail, parallelPlayers[id].tail);
+      }
+      const auto &serialJournal = serial.getJournal();
+      const auto &parallelJournal = parallel.getJournal();
+      ASSERT_EQ(serialJournal.size(), parallelJournal.size());
+      for (std::size_t i = 0; i < serialJournal.size(); i++) {
+        EXPECT_EQ(serialJournal[i].cell, parallelJournal[i].cell);
+        EXPECT_EQ(serialJournal[i].before, parallelJournal[i].before);
+        EXPECT_EQ(serialJournal[i].after, parallelJournal[i].after);
+      }
+      GameEvent expected, actual;
+      while (serialEvents->pop(expected)) {
+        ASSERT_TRUE(parallelEvents->pop(actual));
+        EXPECT_EQ(expected.type, actual.type);
+        EXPECT_EQ(expected.player, actual.player);
+        EXPECT_EQ(expected.cause, actual.cause);
+        EXPECT_EQ(expected.other, actual.other);
+      }
+      EXPECT_FALSE(parallelEvents->pop(actual));
+    }
+  }
+}
@@ -0,0 +1,71 @@
+//GTest tests for the padded grid copy the bots search on
+#include"api.h"
+#include"gtest/gtest.h"
+using namespace cycles;
+
+// 3x2 grid: player 1 at (0, 0), the player with the largest id at (2, 1)
+GameState smallState() {
+  GameState state;
+  state.gridWidth = 3;
+  state.gridHeight = 2;
+  state.grid = {1, 0, 0,
+                0, 0, maxPlayerId};
+  state.frameNumber = 0;
+  return state;
+}
+
+TEST(GridViewTest, PaddingLayout) {
+  GridView view(smallState());
+  EXPECT_EQ(view.getWidth(), 3);
+  EXPECT_EQ(view.getHeight(), 2);
+  ASSERT_EQ(view.size(), 5 * 4);
+  // Row by row with one wall on each side
+  const Id expected[] = {
+      GridView::wall, GridView::wall, GridView::wall, GridView::wall, GridView::wall,
+      GridView::wall, 1,              0,              0,              GridView::wall,
+      GridView::wall, 0,              0,              maxPlayerId,    GridView::wall,
+      GridView::wall, GridView::wall, GridView::wall, GridView::wall, GridView::wall};
+  for (int i = 0; i < view.size(); i++) {
+    EXPECT_EQ(view[i], expected[i]) << i;
+    EXPECT_EQ(view.index(view.position(i)), i);
+  }
+  EXPECT_EQ(view.index({0, 0}), 6);
+  EXPECT_EQ(view.position(6), sf::Vector2i(0, 0));
+}
+
+TEST(GridViewTest, BorderReads) {
+  GridView view(smallState());
+  EXPECT_NE(GridView::wall, maxPlayerId);
+  for (sf::Vector2i outside : {sf::Vector2i(-1, -1), sf::Vector2i(3, 0),
+                               sf::Vector2i(0, 2), sf::Vector2i(-1, 1),
+                               sf::Vector2i(3, 2)}) {
+    EXPECT_EQ(view[view.index(outside)], GridView::wall);
+    EXPECT_FALSE(view.isFree(outside));
+  }
+  EXPECT_FALSE(view.isFree({0, 0}));
+  EXPECT_FALSE(view.isFree({2, 1}));
+  EXPECT_TRUE(view.isFree({1, 0}));
+}
+
+TEST(GridViewTest, OffGridNeighbours) {
+  GridView view(smallState());
+  // Steps from every cell stay in the storage
+  for (int y = 0; y < view.getHeight(); y++) {
+    for (int x = 0; x < view.getWidth(); x++) {
+      int cell = view.index({x, y});
+      for (auto direction : {Direction::north, Direction::east,
+                             Direction::south, Direction::west}) {
+        int next = cell + view.offset(direction);
+        ASSERT_GE(next, 0);
+        ASSERT_LT(next, view.size());
+        EXPECT_EQ(view.position(next), sf::Vector2i(x, y) +
+                                           getDirectionVector(direction));
+      }
+    }
+  }
+  // The border and the players are never free
+  EXPECT_EQ(view.freeNeighbours(view.index({0, 0})), 2);
+  EXPECT_EQ(view.freeNeighbours(view.index({2, 0})), 1);
+  EXPECT_EQ(view.freeNeighbours(view.index({0, 1})), 1);
+  EXPECT_EQ(view.freeNeighbours(view.index({1, 0})), 2);
+}
@@ -0,0 +1,160 @@
+//GTest tests for replay seeking and analysis
+#include"server/replay.h"
+#include"server/replay_analysis.h"
+#include"gtest/gtest.h"
+#include<cstdio>
+#include<fstream>
+#include<iterator>
+#include<set>
+using namespace cycles_server;
+
+// Record a game with a keyframe every 10 frames, keep every snapshot
+// recorded. The dropped frames are left out, as a lagging broadcaster does.
+std::string recordReplay(std::vector<GameSnapshot> &snapshots,
+                         const std::set<int> &dropped = {}) {
+  Configuration conf("");
+  conf.gridWidth = 30;
+  conf.gridHeight = 30;
+  Game game(conf);
+  for (int i = 0; i < 4; i++) {
+    game.addPlayer("player" + std::to_string(i));
+  }
+  auto path = std::string(std::tmpnam(nullptr));
+  std::ofstream out(path, std::ios::binary);
+  writeReplayHeader(out);
+  for (int frame = 0; frame < 25; frame++) {
+    game.setFrame(frame);
+    auto snapshot = game.getSnapshot();
+    for (const auto &[id, player] : game.getPlayers()) {
+      snapshot.latencies[id] = sf::milliseconds(id + 1);
+    }
+    if (!dropped.count(frame)) {
+      sf::Packet packet;
+      if (frame % 10 == 0 || snapshots.empty() ||
+          !encodeDelta(packet, snapshots.back(), snapshot, {})) {
+        packet.clear();
+        encodeKeyframe(packet, snapshot, conf.gridWidth, conf.gridHeight, {});
+      }
+      sf::Uint32 size = packet.getDataSize();
+      char header[] = {char(size >> 24), char(size >> 16), char(size >> 8),
+                       char(size)};
+      out.write(header, 4);
+      out.write(static_cast<const char *>(packet.getData()), size);
+      snapshots.push_back(snapshot);
+    }
+    std::map<Id, Direction> directions;
+    for (const auto &[id, player] : game.getPlayers()) {
+      directions[id] = static_cast<Direction>(id % 4);
+    }
+    game.movePlayers(directions);
+  }
+  return path;
+}
+
+TEST(ReplayTest, Seek) {
+  std::vector<GameSnapshot> snapshots;
+  auto path = recordReplay(snapshots);
+  ReplayFile file;
+  ASSERT_TRUE(file.open(path));
+  ASSERT_EQ(file.size(), 25);
+  EXPECT_EQ(file.keyframeBefore(14), 10);
+  EXPECT_EQ(file.getFrame(14), 14);
+  ReplayPlayer player(file);
+  // Forward, back past a keyframe, jumps and stepping
+  for (int message : {0, 3, 24, 12, 9, 10, 11, 2, 20}) {
+    player.seek(message);
+    EXPECT_EQ(player.getPosition(), message);
+    EXPECT_EQ(player.getSnapshot().frame, snapshots[message].frame);
+    EXPECT_EQ(player.getSnapshot().grid, snapshots[message].grid);
+  }
+  player.step(100);
+  EXPECT_TRUE(player.atEnd());
+  EXPECT_EQ(player.getSnapshot().grid, snapshots.back().grid);
+  std::remove(path.c_str());
+}
+
+TEST(ReplayTest, SeekByFrame) {
+  std::vector<GameSnapshot> snapshots;
+  auto path = recordReplay(snapshots, {13, 14});
+  ReplayFile file;
+  ASSERT_TRUE(file.open(path));
+  ASSERT_EQ(file.size(), 23);
+  EXPECT_EQ(file.messageAt(12), 12);
+  EXPECT_EQ(file.messageAt(14), 12); // Dropped, the frame before shows
+  EXPECT_EQ(file.messageAt(15), 13);
+  EXPECT_EQ(file.messageAt(100), 22);
+  EXPECT_EQ(file.messageAt(-1), -1);
+  ReplayPlayer player(file);
+  player.seekFrame(10);
+  EXPECT_EQ(player.getFrame(), 10);
+  // Five frames, four messages
+  player.stepFrames(5);
+  EXPECT_EQ(player.getFrame(), 15);
+  EXPECT_EQ(player.getSnapshot().grid, snapshots[13].grid);
+  // Single steps cross the gap both ways
+  player.stepFrames(-1);
+  EXPECT_EQ(player.getFrame(), 12);
+  player.stepFrames(1);
+  EXPECT_EQ(player.getFrame(), 15);
+  player.stepFrames(100);
+  EXPECT_EQ(player.getFrame(), 24);
+  EXPECT_TRUE(player.atEnd());
+  std::remove(path.c_str());
+}
+
+TEST(ReplayTest, RejectsUnknownVersions) {
+  std::vector<GameSnapshot> snapshots;
+  auto path = recordReplay(snapshots);
+  ReplayFile file;
+  ASSERT_TRUE(file.open(path));
+  // The same messages under another version, then without a header
+  for (std::string header : {"CYCRPL99", "CYCRPLxx", ""}) {
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(replayHeaderSize);
+    std::string messages((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    auto other = std::string(std::tmpnam(nullptr));
+    std::ofstream(other, std::ios::binary) << header << messages;
+    ReplayFile rejected;
+    EXPECT_FALSE(rejected.open(other)) << header;
+    std::remove(other.c_str());
+  }
+  // Opening again replaces the mapping and the index
+  int messages = file.size();
+  ASSERT_TRUE(file.open(path));
+  EXPECT_EQ(file.size(), messages);
+  EXPECT_FALSE(file.open(path + ".missing"));
+  EXPECT_EQ(file.size(), 0);
+  EXPECT_EQ(readReplayVersion("CYCRPL01"), 1);
+  EXPECT_EQ(readReplayVersion("CYCCOL01"), -1);
+  std::remove(path.c_str());
+}
+
+TEST(ReplayTest, Analyze) {
+  std::vector<GameSnapshot> snapshots;
+  auto path = recordReplay(snapshots);
+  ReplayFile file;
+  ASSERT_TRUE(file.open(path));
+  MatchStats stats;
+  ASSERT_TRUE(analyzeReplay(file, {true, 5}, stats));
+  EXPECT_EQ(stats.frames, 25);
+  ASSERT_EQ(stats.players.size(), 4u);
+  for (const auto &[id, player] : stats.players) {
+    EXPECT_EQ(player.firstFrame, 0);
+    EXPECT_EQ(player.survived, snapshots.back().players.count(id) > 0);
+    EXPECT_EQ(player.survived, player.lastFrame == 24);
+    // One response per frame it was in the game
+    EXPECT_EQ(player.latencies.size(),
+              static_cast<std::size_t>(player.lastFrame + 1));
+    for (float latency : player.latencies) {
+      EXPECT_FLOAT_EQ(latency, id + 1);
+    }
+  }
+  for (const auto &sample : stats.territory) {
+    EXPECT_EQ(sample.frame % 5, 0);
+    EXPECT_EQ(sample.cells,
+              snapshots[sample.frame].players.at(sample.player).tail.size() +
+                  1);
+  }
+  std::remove(path.c_str());
+}
@@ -0,0 +1,122 @@
+//GTest tests for the self-play data generator
+#include"server/self_play.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+#include<cstdio>
+#include<fstream>
+using namespace cycles_server;
+
+Configuration selfPlayConfig() {
+  return Configuration(writeConfig("gridHeight: 40\ngridWidth: 40\n"));
+}
+
+SelfPlayOptions smallMatches() {
+  SelfPlayOptions options;
+  options.players = 3;
+  options.maxFrames = 300;
+  options.policies = {Policy::space, Policy::safe, Policy::random};
+  options.features.radius = 3;
+  return options;
+}
+
+TEST(SelfPlayTest, Policies) {
+  PaddedGrid grid(5, 5);
+  std::mt19937 rng(1);
+  // In the corner, only east and south are free
+  for (int i = 0; i < 20; i++) {
+    auto move = choose(Policy::safe, grid, {0, 0}, Direction::north, rng);
+    EXPECT_TRUE(move == Direction::east || move == Direction::south);
+    EXPECT_NE(choose(Policy::random, grid, {2, 2}, Direction::north, rng),
+              Direction::south);
+  }
+  // A wall across the board: east leads to one cell, south to the rest
+  for (int y = 0; y < 5; y++) {
+    grid.at({2, y}) = 1;
+  }
+  grid.at({1, 1}) = 1;
+  grid.at({1, 3}) = 1;
+  EXPECT_EQ(choose(Policy::space, grid, {1, 2}, Direction::east, rng),
+            Direction::west);
+  EXPECT_EQ(parsePolicy("space"), Policy::space);
+  EXPECT_FALSE(parsePolicy("clever"));
+}
+
+TEST(SelfPlayTest, Matches) {
+  auto conf = selfPlayConfig();
+  auto options = smallMatches();
+  auto samples = playMatch(conf, options, 0);
+  ASSERT_FALSE(samples.empty());
+  SampleLayout layout{options.features.radius, options.features.rotate,
+                      options.features.planes};
+  int winners = 0;
+  for (const auto &sample : samples) {
+    EXPECT_EQ(sample.planes.size(), layout.planeBytes());
+    EXPECT_EQ(sample.players, 3);
+    EXPECT_GE(sample.place, 1);
+    EXPECT_LE(sample.place, 3);
+    winners += sample.place == 1;
+    // Never straight back into its own trail
+    if (sample.frame > 0) {
+      EXPECT_NE((sample.move - sample.heading) & 3, 2);
+    }
+  }
+  EXPECT_GT(winners, 0);
+  // Seeded, the same match again gives the same samples
+  auto again = playMatch(conf, options, 0);
+  ASSERT_EQ(again.size(), samples.size());
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    EXPECT_EQ(again[i].move, samples[i].move);
+    EXPECT_EQ(again[i].planes, samples[i].planes);
+  }
+}
+
+TEST(SelfPlayTest, Files) {
+  auto conf = selfPlayConfig();
+  auto options = smallMatches();
+  SampleLayout layout{options.features.radius, options.features.rotate,
+                      options.features.planes};
+  auto samples = playMatch(conf, options, 4);
+  std::string path = std::tmpnam(nullptr);
+  {
+    SampleWriter writer(path, layout);
+    ASSERT_TRUE(writer.isOpen());
+    for (const auto &sample : samples) {
+      writer.write(sample);
+    }
+  }
+  SampleFile file;
+  ASSERT_TRUE(file.open(path));
+  ASSERT_EQ(file.size(), samples.size());
+  EXPECT_EQ(file.getLayout().radius, 3);
+  EXPECT_EQ(file.getLayout().planes, options.features.planes);
+  auto last = file.read(samples.size() - 1);
+  EXPECT_EQ(last.match, 4u);
+  EXPECT_EQ(last.frame, samples.back().frame);
+  EXPECT_EQ(last.remaining, samples.back().remaining);
+  EXPECT_EQ(last.planes, samples.back().planes);
+  // Unpacked, the planes are the ones of the encoder
+  std::vector<std::uint8_t> values(layout.planes.size() * layout.side() *
+                                   layout.side());
+  file.unpack(0, values.data());
+  int own = 0;
+  for (int i = 0; i < layout.side() * layout.side(); i++) {
+    own += values[2 * layout.side() * layout.side() + i];
+  }
+  EXPECT_EQ(own, 1); // The head, the trail is not there yet
+  // Opening again replaces the mapping
+  ASSERT_TRUE(file.open(path));
+  EXPECT_EQ(file.size(), samples.size());
+  EXPECT_FALSE(file.open(path + ".missing"));
+  EXPECT_EQ(file.size(), 0u);
+  std::remove(path.c_str());
+}
+
+TEST(SelfPlayTest, RejectsWallDistance) {
+  auto options = smallMatches();
+  options.features.planes.push_back(cycles::FeaturePlane::wallDistance);
+  EXPECT_TRUE(playMatch(selfPlayConfig(), options, 0).empty());
+  std::string path = std::tmpnam(nullptr);
+  SampleWriter writer(path, {3, true, options.features.planes});
+  EXPECT_FALSE(writer.isOpen());
+  std::remove(path.c_str());
+}
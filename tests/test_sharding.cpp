@@ -0,0 +1,106 @@
+//GTest tests for the sharded game against Game
+#include"server/sharding.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+using namespace cycles_server;
+
+// One tick with the shards in this process, every message goes through a
+// packet like over the sockets
+std::vector<GameEvent> tick(ShardFront &front, std::vector<Shard> &shards,
+                            int frame,
+                            const std::map<Id, Direction> &directions) {
+  auto inputs = front.prepareTick(frame, directions);
+  std::vector<std::array<std::optional<BorderMessage>, 2>> borders;
+  for (std::size_t i = 0; i < shards.size(); i++) {
+    sf::Packet packet;
+    write(packet, inputs[i]);
+    TickInput input;
+    EXPECT_TRUE(read(packet, input));
+    borders.push_back(shards[i].begin(input));
+  }
+  std::vector<TickOutput> outputs;
+  for (std::size_t i = 0; i < shards.size(); i++) {
+    std::array<std::optional<BorderMessage>, 2> received;
+    if (i > 0) {
+      received[0] = borders[i - 1][1];
+    }
+    if (i + 1 < shards.size()) {
+      received[1] = borders[i + 1][0];
+    }
+    sf::Packet packet;
+    write(packet, shards[i].finish(received));
+    outputs.emplace_back();
+    EXPECT_TRUE(read(packet, outputs.back()));
+  }
+  return front.merge(outputs);
+}
+
+void compare(bool vertical, int shardCount, unsigned seed) {
+  Configuration conf(writeConfig("gridWidth: 60\ngridHeight: 45\nseed: " +
+                                 std::to_string(seed) + "\n"));
+  Game game(conf);
+  auto gameEvents = game.subscribe();
+  ShardLayout layout{conf.gridWidth, conf.gridHeight, shardCount, vertical};
+  ASSERT_TRUE(layout.valid());
+  ShardFront front(layout, seed);
+  std::vector<Shard> shards;
+  for (int i = 0; i < shardCount; i++) {
+    shards.emplace_back(layout, i);
+  }
+  for (int i = 0; i < 100; i++) {
+    game.addPlayer("player" + std::to_string(i));
+    auto [shard, player] = front.addPlayer("player" + std::to_string(i));
+    shards[shard].addPlayer(player);
+  }
+  ASSERT_EQ(game.getGrid(), front.getGrid());
+  std::mt19937 rng(seed);
+  std::map<Id, Direction> directions;
+  for (int frame = 0; frame < 300 && !game.isGameOver(); frame++) {
+    game.setFrame(frame);
+    if (frame == 20) {
+      // Leaves between two ticks, like a client that disconnected
+      Id id = game.getPlayers().rbegin()->first;
+      game.removePlayer(id);
+      front.removePlayer(id);
+    }
+    for (const auto &[id, player] : game.getPlayers()) {
+      if (!directions.count(id) || rng() % 4 == 0) {
+        directions[id] = static_cast<Direction>(rng() % 4);
+      }
+    }
+    game.movePlayers(directions);
+    auto events = tick(front, shards, frame, directions);
+    ASSERT_EQ(game.getGrid(), front.getGrid()) << "frame " << frame;
+    auto players = game.getPlayers();
+    ASSERT_EQ(players.size(), front.getPlayers().size());
+    for (const auto &[id, player] : front.getPlayers()) {
+      EXPECT_EQ(players[id].position, player.position);
+    }
+    for (const auto &event : events) {
+      GameEvent expected;
+      ASSERT_TRUE(gameEvents->pop(expected));
+      EXPECT_EQ(expected.type, event.type);
+      EXPECT_EQ(expected.player, event.player);
+      EXPECT_EQ(expected.cause, event.cause);
+      EXPECT_EQ(expected.other, event.other);
+      EXPECT_EQ(expected.frame, event.frame);
+    }
+    GameEvent extra;
+    EXPECT_FALSE(gameEvents->pop(extra));
+  }
+}
+
+TEST(ShardingTest, Layout) {
+  ShardLayout layout{100, 10, 3, false};
+  EXPECT_TRUE(layout.valid());
+  EXPECT_EQ(layout.begin(1), 3);
+  EXPECT_EQ(layout.owner({99, 2}), 0);
+  EXPECT_EQ(layout.owner({0, 3}), 1);
+  EXPECT_EQ(layout.owner({50, 9}), 2);
+  ShardLayout columns{10, 100, 6, true};
+  EXPECT_FALSE(columns.valid());
+}
+
+TEST(ShardingTest, HorizontalStrips) { compare(false, 3, 7); }
+
+TEST(ShardingTest, VerticalStrips) { compare(true, 4, 11); }
@@ -0,0 +1,180 @@
+//GTest tests for the spectator stream encoding
+#include"server/spectator_stream.h"
+#include"gtest/gtest.h"
+#include<sstream>
+using namespace cycles_server;
+
+Configuration streamConfig(){
+  Configuration conf("");
+  conf.gridWidth = 40;
+  conf.gridHeight = 30;
+  return conf;
+}
+
+void expectSameGame(const GameSnapshot &expected, const GameSnapshot &actual) {
+  EXPECT_EQ(expected.frame, actual.frame);
+  EXPECT_EQ(expected.gameOver, actual.gameOver);
+  EXPECT_EQ(expected.grid, actual.grid);
+  ASSERT_EQ(expected.players.size(), actual.players.size());
+  for (const auto &[id, player] : expected.players) {
+    const auto &other = actual.players.at(id);
+    EXPECT_EQ(player.name, other.name);
+    EXPECT_EQ(player.color, other.color);
+    EXPECT_EQ(player.position, other.position);
+    EXPECT_EQ(player.tail, other.tail);
+  }
+}
+
+TEST(SpectatorStreamTest, KeyframeThenDeltas) {
+  auto conf = streamConfig();
+  Game game(conf);
+  auto events = game.subscribe();
+  for (int i = 0; i < 6; i++) {
+    game.addPlayer("player" + std::to_string(i));
+  }
+  StreamDecoder decoder;
+  std::vector<GameEvent> decodedEvents;
+  auto previous = game.getSnapshot();
+  sf::Packet packet;
+  encodeKeyframe(packet, previous, conf.gridWidth, conf.gridHeight, {});
+  ASSERT_TRUE(decoder.apply(packet, decodedEvents));
+  expectSameGame(previous, decoder.getSnapshot());
+  int sentEvents = 0;
+  // Straight lines, players die on the walls and on each other
+  for (int frame = 1; frame < 80 && !game.isGameOver(); frame++) {
+    std::map<Id, Direction> directions;
+    for (const auto &[id, player] : game.getPlayers()) {
+      directions[id] = static_cast<Direction>(id % 4);
+    }
+    game.movePlayers(directions);
+    game.setFrame(frame);
+    std::vector<GameEvent> newEvents;
+    GameEvent event;
+    while (events->pop(event)) {
+      newEvents.push_back(event);
+    }
+    sentEvents += newEvents.size();
+    auto current = game.getSnapshot();
+    packet.clear();
+    ASSERT_TRUE(encodeDelta(packet, previous, current, newEvents));
+    ASSERT_TRUE(decoder.apply(packet, decodedEvents));
+    expectSameGame(current, decoder.getSnapshot());
+    previous = current;
+  }
+  EXPECT_GT(sentEvents, 0);
+  EXPECT_EQ(static_cast<int>(decodedEvents.size()), sentEvents);
+}
+
+TEST(SpectatorStreamTest, DeltaNeedsKeyframe) {
+  auto conf = streamConfig();
+  Game game(conf);
+  game.addPlayer("player");
+  auto first = game.getSnapshot();
+  game.setFrame(1);
+  auto second = game.getSnapshot();
+  sf::Packet packet;
+  ASSERT_TRUE(encodeDelta(packet, first, second, {}));
+  StreamDecoder decoder;
+  std::vector<GameEvent> events;
+  EXPECT_FALSE(decoder.apply(packet, events));
+  EXPECT_FALSE(decoder.hasKeyframe());
+  // Frames that are not consecutive can not be a delta
+  packet.clear();
+  EXPECT_FALSE(encodeDelta(packet, second, first, {}));
+}
+
+FramedMessage fakeMessage(char tag) {
+  return std::make_shared<const std::vector<char>>(1, tag);
+}
+
+TEST(SpectatorStreamTest, LaggingSpectatorSkipsToKeyframe) {
+  StreamHistory history;
+  history.keyframe = fakeMessage('k');
+  SpectatorBacklog backlog;
+  backlog.catchUp(history);
+  // Keeping up: every delta is queued after the keyframe
+  for (char tag : {'a', 'b', 'c'}) {
+    history.deltas.push_back(fakeMessage(tag));
+    backlog.push(history.deltas.back(), history, 4);
+  }
+  ASSERT_EQ(backlog.queue.size(), 4u);
+  // The front message is on its way when a new keyframe comes
+  backlog.sent = 1;
+  history.keyframe = fakeMessage('K');
+  history.deltas.clear();
+  backlog.push(history.keyframe, history, 4);
+  history.deltas.push_back(fakeMessage('d'));
+  // Over the limit: the partial message is completed, then the keyframe
+  // and the deltas after it, the older deltas are skipped
+  backlog.push(history.deltas.back(), history, 4);
+  ASSERT_EQ(backlog.queue.size(), 3u);
+  EXPECT_EQ(backlog.queue[0]->front(), 'k');
+  EXPECT_EQ(backlog.queue[1], history.keyframe);
+  EXPECT_EQ(backlog.queue[2], history.deltas.back());
+  // Without a partial message nothing old is kept
+  backlog.sent = 0;
+  backlog.catchUp(history);
+  ASSERT_EQ(backlog.queue.size(), 2u);
+  EXPECT_EQ(backlog.queue[0], history.keyframe);
+}
+
+TEST(SpectatorStreamTest, RecordingReadsBack) {
+  auto conf = streamConfig();
+  conf.seed = 5;
+  Game game(conf);
+  auto events = game.subscribe();
+  for (int i = 0; i < 4; i++) {
+    game.addPlayer("player" + std::to_string(i));
+  }
+  StreamEncoder encoder(conf.gridWidth, conf.gridHeight, 5);
+  std::stringstream recording;
+  std::vector<GameSnapshot> recorded;
+  int sentEvents = 0;
+  std::vector<GameEvent> newEvents;
+  for (int frame = 0; frame < 12; frame++) {
+    game.setFrame(frame);
+    GameEvent event;
+    while (events->pop(event)) {
+      newEvents.push_back(event);
+    }
+    // A snapshot the broadcaster dropped, its events go with the next one
+    if (frame == 7) {
+      game.removePlayer(game.getPlayers().begin()->first);
+      continue;
+    }
+    sentEvents += newEvents.size();
+    auto snapshot = std::make_shared<GameSnapshot>(game.getSnapshot());
+    recorded.push_back(*snapshot);
+    auto message = encoder.encode(snapshot, newEvents);
+    newEvents.clear();
+    recording.write(message->data(), message->size());
+    std::map<Id, Direction> directions;
+    for (const auto &[id, player] : game.getPlayers()) {
+      directions[id] = static_cast<Direction>(id % 4);
+    }
+    game.movePlayers(directions);
+  }
+  // Cut off in the middle of a message, as a recording of a crashed server
+  recording.write("\0\0\0\x10kf", 6);
+
+  StreamDecoder decoder;
+  std::vector<GameEvent> decodedEvents;
+  std::vector<int> keyframes;
+  sf::Packet packet;
+  std::size_t read = 0;
+  while (readMessage(recording, packet)) {
+    ASSERT_LT(read, recorded.size());
+    auto kind = static_cast<const sf::Uint8 *>(packet.getData())[0];
+    if (kind == static_cast<sf::Uint8>(StreamMessage::keyframe)) {
+      keyframes.push_back(recorded[read].frame);
+    }
+    ASSERT_TRUE(decoder.apply(packet, decodedEvents));
+    expectSameGame(recorded[read], decoder.getSnapshot());
+    read++;
+  }
+  EXPECT_EQ(read, recorded.size());
+  // The first frame, one every 5 frames and the one after the gap
+  EXPECT_EQ(keyframes, (std::vector<int>{0, 5, 8}));
+  EXPECT_GT(sentEvents, 0);
+  EXPECT_EQ(static_cast<int>(decodedEvents.size()), sentEvents);
+}
@@ -0,0 +1,49 @@
+//GTest tests for the tick pipeline
+#include"server/tick_pipeline.h"
+#include"gtest/gtest.h"
+#include<atomic>
+#include<chrono>
+using namespace cycles_server;
+
+TEST(TickPipelineTest, InlineWithoutThreads) {
+  TickPipeline pipeline(0);
+  auto caller = std::this_thread::get_id();
+  std::thread::id ranOn;
+  pipeline.submit([&] { ranOn = std::this_thread::get_id(); });
+  // Done before submit returns
+  EXPECT_EQ(ranOn, caller);
+  pipeline.wait();
+}
+
+TEST(TickPipelineTest, WaitsForEveryJob) {
+  std::atomic<int> started = 0;
+  TickPipeline pipeline(3, [&] { started++; });
+  std::atomic<int> done = 0;
+  for (int tick = 0; tick < 20; tick++) {
+    for (int i = 0; i < 5; i++) {
+      pipeline.submit([&] {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        done++;
+      });
+    }
+    pipeline.wait();
+    ASSERT_EQ(done, (tick + 1) * 5);
+  }
+  EXPECT_EQ(started, 3);
+}
+
+TEST(TickPipelineTest, JobsOffTheCallerThread) {
+  TickPipeline pipeline(1);
+  std::atomic<bool> release = false;
+  std::atomic<bool> finished = false;
+  pipeline.submit([&] {
+    while (!release) {
+      std::this_thread::yield();
+    }
+    finished = true;
+  });
+  // submit did not run the job, it would never have returned
+  release = true;
+  pipeline.wait();
+  EXPECT_TRUE(finished);
+}
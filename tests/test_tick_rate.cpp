@@ -0,0 +1,74 @@
+//GTest tests for the tick rate controller
+#include"server/tick_rate.h"
+#include"gtest/gtest.h"
+using namespace cycles_server;
+
+Configuration adaptiveConfig(){
+  Configuration conf("");
+  conf.adaptiveTickRate = true;
+  conf.tickPeriod = 33;
+  conf.minTickPeriod = 4;
+  conf.maxTickPeriod = 50;
+  conf.tickLatencyHeadroom = 2;
+  return conf;
+}
+
+TEST(TickRateTest, FixedPeriod) {
+  Configuration conf("");
+  conf.tickPeriod = 20;
+  TickRateController tickRate(conf);
+  for (int i = 0; i < 100; i++) {
+    tickRate.addLatency(sf::milliseconds(1));
+    tickRate.endFrame();
+  }
+  EXPECT_EQ(tickRate.getPeriod(), sf::milliseconds(20));
+}
+
+TEST(TickRateTest, Percentile) {
+  TickRateController tickRate(adaptiveConfig());
+  for (int i = 1; i <= 100; i++) {
+    tickRate.addLatency(sf::milliseconds(i));
+  }
+  EXPECT_EQ(tickRate.getLatencyPercentile(0), sf::milliseconds(1));
+  EXPECT_EQ(tickRate.getLatencyPercentile(50), sf::milliseconds(50));
+  EXPECT_EQ(tickRate.getLatencyPercentile(100), sf::milliseconds(100));
+}
+
+TEST(TickRateTest, TightensWithFastClients) {
+  TickRateController tickRate(adaptiveConfig());
+  for (int i = 0; i < 1000; i++) {
+    tickRate.addLatency(sf::microseconds(1500));
+    tickRate.endFrame();
+  }
+  // p99 * headroom is 3 ms, below minTickPeriod
+  EXPECT_LT(tickRate.getPeriod(), sf::microseconds(4100));
+  EXPECT_GE(tickRate.getPeriod(), sf::milliseconds(4));
+}
+
+TEST(TickRateTest, RelaxesWithSlowClients) {
+  TickRateController tickRate(adaptiveConfig());
+  for (int i = 0; i < 1000; i++) {
+    tickRate.addLatency(sf::microseconds(1000));
+    tickRate.endFrame();
+  }
+  for (int i = 0; i < 1000; i++) {
+    tickRate.addLatency(sf::milliseconds(40));
+    tickRate.endFrame();
+  }
+  EXPECT_EQ(tickRate.getPeriod(), sf::milliseconds(50));
+}
+
+TEST(TickRateTest, TimeoutsCountAsTheDeadline) {
+  auto conf = adaptiveConfig();
+  conf.maxClientCommunicationTime = 30;
+  TickRateController tickRate(conf);
+  for (int i = 0; i < 100; i++) {
+    if (i % 10 == 0) {
+      tickRate.addTimeout();
+    } else {
+      tickRate.addLatency(sf::milliseconds(1));
+    }
+  }
+  EXPECT_EQ(tickRate.getLatencyPercentile(99), sf::milliseconds(30));
+  EXPECT_EQ(tickRate.getLatencyPercentile(50), sf::milliseconds(1));
+}
@@ -0,0 +1,106 @@
+//GTest tests for the tournament formats and match results
+#include"server/match_result.h"
+#include"server/tournament.h"
+#include"gtest/gtest.h"
+using namespace cycles_server;
+
+// Plays every match of a round, the lower roster index always wins
+void playRound(Tournament &tournament, const std::vector<Match> &matches) {
+  for (const auto &match : matches) {
+    std::vector<int> places;
+    for (int bot : match.bots) {
+      int place = 1;
+      for (int other : match.bots) {
+        place += other < bot;
+      }
+      places.push_back(place);
+    }
+    tournament.record(match, places);
+  }
+}
+
+TEST(TournamentTest, RoundRobin) {
+  Tournament tournament(TournamentFormat::roundRobin, 5, 2, 0);
+  auto matches = tournament.nextRound();
+  EXPECT_EQ(matches.size(), 10u);
+  playRound(tournament, matches);
+  EXPECT_TRUE(tournament.nextRound().empty());
+  auto standings = tournament.standings();
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(standings[i].bot, i);
+    EXPECT_EQ(standings[i].matches, 4);
+    EXPECT_FLOAT_EQ(standings[i].score, 4 - i);
+  }
+  Tournament groups(TournamentFormat::roundRobin, 6, 3, 0);
+  EXPECT_EQ(groups.nextRound().size(), 20u);
+}
+
+TEST(TournamentTest, Swiss) {
+  Tournament tournament(TournamentFormat::swiss, 8, 2, 0);
+  std::set<std::pair<int, int>> played;
+  int rounds = 0;
+  for (auto matches = tournament.nextRound(); !matches.empty();
+       matches = tournament.nextRound()) {
+    EXPECT_EQ(matches.size(), 4u);
+    for (const auto &match : matches) {
+      // No rematches with enough bots for three rounds
+      EXPECT_TRUE(
+          played.insert(std::minmax(match.bots[0], match.bots[1])).second);
+    }
+    playRound(tournament, matches);
+    rounds++;
+  }
+  EXPECT_EQ(rounds, 3);
+  EXPECT_EQ(tournament.standings()[0].bot, 0);
+  EXPECT_FLOAT_EQ(tournament.standings()[0].score, 3);
+}
+
+TEST(TournamentTest, Knockout) {
+  Tournament tournament(TournamentFormat::knockout, 6, 2, 0);
+  auto first = tournament.nextRound();
+  ASSERT_EQ(first.size(), 3u);
+  EXPECT_EQ(first[0].bots, (std::vector<int>{0, 5}));
+  EXPECT_EQ(first[2].bots, (std::vector<int>{2, 3}));
+  playRound(tournament, first);
+  // Three left, the best seed goes through without playing
+  auto second = tournament.nextRound();
+  ASSERT_EQ(second.size(), 1u);
+  EXPECT_EQ(second[0].bots, (std::vector<int>{1, 2}));
+  playRound(tournament, second);
+  int rounds = 2;
+  for (auto matches = tournament.nextRound(); !matches.empty();
+       matches = tournament.nextRound()) {
+    playRound(tournament, matches);
+    rounds++;
+  }
+  EXPECT_EQ(rounds, 3);
+  auto standings = tournament.standings();
+  EXPECT_EQ(standings[0].bot, 0);
+  EXPECT_EQ(standings[1].bot, 1);
+}
+
+TEST(MatchResultTest, Places) {
+  std::map<Id, Player> players;
+  for (Id id : {1, 2, 3, 4}) {
+    players[id].id = id;
+    players[id].name = "bot" + std::to_string(id);
+  }
+  MatchRecorder recorder;
+  recorder.addPlayers(players);
+  auto die = [&recorder](Id id, int frame, DeathCause cause) {
+    recorder.record({GameEvent::Type::playerDied, id, cause, 0, frame});
+    recorder.record({GameEvent::Type::playerRemoved, id, cause, 0, frame});
+  };
+  die(2, 10, DeathCause::wall);
+  die(3, 20, DeathCause::headOn);
+  die(4, 20, DeathCause::headOn);
+  auto result = recorder.finish(30);
+  ASSERT_EQ(result.players.size(), 4u);
+  EXPECT_EQ(result.players[0].name, "bot1");
+  EXPECT_EQ(result.players[0].outcome, "survived");
+  EXPECT_EQ(result.players[1].place, 2);
+  EXPECT_EQ(result.players[2].place, 2);
+  EXPECT_EQ(result.players[2].outcome, "headOn");
+  EXPECT_EQ(result.players[3].name, "bot2");
+  EXPECT_EQ(result.players[3].place, 4);
+}